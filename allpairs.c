@@ -0,0 +1,209 @@
+// allpairs.c
+//
+// The recoding is mont_powm's sliding window, written down once per key instead of being
+// re-derived from the bits for every pair. Like mont_powm, a modulus with an IFMA engine
+// (ifma.h) keeps its tables and runs its pairs in radix 2^52. Finished rows are plain limb
+// arrays that the writer wraps without copying.
+
+#include <stdlib.h>
+#include <string.h>
+#include "allpairs.h"
+#include "hugepage.h"
+#include "worksteal.h"
+
+#define TILE_MIN 8
+#define TILE_MAX 128 // rows held per block: TILE_MAX * N results at most
+
+// one window wider than mont_powm picks: the table is paid once per peer, not per pair
+static int window_bits(size_t ebits) {
+    if (ebits <= 24) return 3;
+    if (ebits <= 80) return 4;
+    if (ebits <= 240) return 5;
+    if (ebits <= 672) return 6;
+    return 7;
+}
+
+// bit i of e (0 past the top)
+static inline int bit(const mp_limb_t *e, size_t en, size_t i) {
+    size_t w = i / GMP_NUMB_BITS;
+    return w < en ? (int)(e[w] >> (i % GMP_NUMB_BITS)) & 1 : 0;
+}
+
+// sliding-window digits of e into d (NULL: only count them); returns the count
+static size_t recode(allpairs_digit *d, const mpz_t e, int w) {
+    const mp_limb_t *ep = mpz_limbs_read(e);
+    size_t en = mpz_size(e), len = 0;
+    uint32_t pending = 0;
+    int started = 0;
+    for (long i = (long)mpz_sizeinbase(e, 2) - 1; i >= 0;) {
+        if (!bit(ep, en, i)) { // never before the top bit, so always between windows
+            ++pending;
+            --i;
+            continue;
+        }
+        long j = i - w + 1 < 0 ? 0 : i - w + 1;
+        while (!bit(ep, en, j)) ++j;
+        uint32_t val = 0;
+        for (long k = i; k >= j; --k) val = (val << 1) | bit(ep, en, k);
+        if (d) d[len] = (allpairs_digit){ started ? pending + (uint32_t)(i - j + 1) : 0, val >> 1 };
+        ++len;
+        pending = 0;
+        started = 1;
+        i = j - 1;
+    }
+    if (pending) {
+        if (d) d[len] = (allpairs_digit){ pending, ALLPAIRS_NO_MUL };
+        ++len;
+    }
+    return len;
+}
+
+struct tables {
+    allpairs *ap;
+    const mpz_t *Y;
+};
+
+static void build_table(size_t j, void *arg) {
+    struct tables *t = arg;
+    const mont_ctx *ctx = t->ap->ctx;
+    const ifma_ctx *f = ctx->ifma;
+    size_t n = t->ap->words;
+    mp_limb_t *tab = t->ap->table + j * t->ap->tlimbs, b2[n];
+    if (f) {
+        ifma_to(tab, t->Y[j], f);
+        ifma_sqr(b2, tab, f);
+        for (size_t k = 1; k < t->ap->tlimbs / n; ++k) ifma_mul(tab + k * n, tab + (k - 1) * n, b2, f);
+        return;
+    }
+    mont_to(tab, t->Y[j], ctx);
+    mont_sqr(b2, tab, ctx);
+    for (size_t k = 1; k < t->ap->tlimbs / n; ++k) mont_mul(tab + k * n, tab + (k - 1) * n, b2, ctx);
+}
+
+int allpairs_init(allpairs *ap, const mpz_t X[], const mpz_t Y[], size_t n, size_t tile,
+                  const mont_ctx *ctx) {
+    size_t ebits = 1;
+    for (size_t i = 0; i < n; ++i)
+        if (mpz_sizeinbase(X[i], 2) > ebits) ebits = mpz_sizeinbase(X[i], 2);
+    ap->ctx = ctx;
+    ap->n = n;
+    ap->w = window_bits(ebits);
+    ap->words = ctx->ifma ? (size_t)ctx->ifma->k : (size_t)ctx->n;
+    ap->tlimbs = ((size_t)1 << (ap->w - 1)) * ap->words;
+    if (tile == 0) {
+        tile = ALLPAIRS_CACHE_BYTES / (ap->tlimbs * sizeof(mp_limb_t));
+        tile = tile < TILE_MIN ? TILE_MIN : tile > TILE_MAX ? TILE_MAX : tile;
+    }
+    ap->tile = tile;
+
+    size_t digits = 0;
+    for (size_t i = 0; i < n; ++i) digits += recode(NULL, X[i], ap->w);
+    ap->table = hugepage_alloc(n * ap->tlimbs * sizeof(mp_limb_t), NULL); // every pair reads it
+    ap->digit = malloc((digits ? digits : 1) * sizeof(allpairs_digit));
+    ap->first = malloc((n + 1) * sizeof(size_t));
+    if (!ap->table || !ap->digit || !ap->first) {
+        hugepage_free(ap->table); free(ap->digit); free(ap->first);
+        return -1;
+    }
+    ap->first[0] = 0;
+    for (size_t i = 0; i < n; ++i)
+        ap->first[i + 1] = ap->first[i] + recode(ap->digit + ap->first[i], X[i], ap->w);
+
+    struct tables t = { ap, Y };
+    ws_parallel_for(0, n, 16, build_table, &t);
+    return 0;
+}
+
+void allpairs_clear(allpairs *ap) {
+    hugepage_free(ap->table);
+    free(ap->digit);
+    free(ap->first);
+}
+
+// acc = Y_j^X_i in Montgomery form (ap->words words); 0 if X_i = 0 and there is nothing to do
+static int pair_mont(mp_limb_t *acc, const allpairs *ap, size_t i, size_t j) {
+    const mont_ctx *ctx = ap->ctx;
+    const ifma_ctx *f = ctx->ifma;
+    size_t n = ap->words;
+    const allpairs_digit *d = ap->digit + ap->first[i], *end = ap->digit + ap->first[i + 1];
+    const mp_limb_t *tab = ap->table + j * ap->tlimbs;
+    if (d == end) return 0;
+    memcpy(acc, tab + d->idx * n, n * sizeof(mp_limb_t));
+    for (++d; d < end; ++d) {
+        if (f) {
+            for (uint32_t k = 0; k < d->sqr; ++k) ifma_sqr(acc, acc, f);
+            if (d->idx != ALLPAIRS_NO_MUL) ifma_mul(acc, acc, tab + d->idx * n, f);
+        } else {
+            for (uint32_t k = 0; k < d->sqr; ++k) mont_sqr(acc, acc, ctx);
+            if (d->idx != ALLPAIRS_NO_MUL) mont_mul(acc, acc, tab + d->idx * n, ctx);
+        }
+    }
+    return 1;
+}
+
+// r = Y_j^X_i as ctx->n plain limbs; z is scratch for leaving the IFMA form
+static void pair_limbs(mp_limb_t *r, const allpairs *ap, size_t i, size_t j, mpz_t z) {
+    const mont_ctx *ctx = ap->ctx;
+    mp_limb_t acc[ap->words];
+    memset(r, 0, ctx->n * sizeof(mp_limb_t));
+    r[0] = 1;
+    if (!pair_mont(acc, ap, i, j)) return;
+    if (ctx->ifma) {
+        ifma_from(z, acc, ctx->ifma);
+        memcpy(r, mpz_limbs_read(z), mpz_size(z) * sizeof(mp_limb_t));
+    } else {
+        mont_mul(r, acc, r, ctx); // times a plain 1: out of Montgomery form
+    }
+}
+
+void allpairs_pair(mpz_t s, const allpairs *ap, size_t i, size_t j) {
+    mp_limb_t acc[ap->words];
+    if (!pair_mont(acc, ap, i, j)) mpz_set_ui(s, 1);
+    else if (ap->ctx->ifma) ifma_from(s, acc, ap->ctx->ifma);
+    else mont_from(s, acc, ap->ctx);
+}
+
+// one block of rows [r0, r0 + rows) against every column tile from the diagonal on
+struct block {
+    const allpairs *ap;
+    size_t r0, rows;
+    mp_limb_t *out; // row i, column j at ((i - r0) * N + j) * limbs
+};
+
+static void run_tile(size_t b, void *arg) {
+    struct block *blk = arg;
+    const allpairs *ap = blk->ap;
+    mp_size_t n = ap->ctx->n;
+    size_t c0 = b * ap->tile, c1 = c0 + ap->tile < ap->n ? c0 + ap->tile : ap->n;
+    ws_worker *w = ws_self(); // the worker's scratch keeps its allocation from tile to tile
+    mpz_t own;
+    mpz_ptr z = w ? w->scratch[0] : own;
+    if (!w) mpz_init2(own, n * GMP_NUMB_BITS);
+    // peer-major: one table at a time, every row of the tile through it
+    for (size_t j = c0; j < c1; ++j)
+        for (size_t i = blk->r0; i < blk->r0 + blk->rows && i < j; ++i)
+            pair_limbs(blk->out + ((i - blk->r0) * ap->n + j) * n, ap, i, j, z);
+    if (!w) mpz_clear(own);
+}
+
+int allpairs_write(const allpairs *ap, bigio_writer *out) {
+    mp_size_t n = ap->ctx->n;
+    size_t tiles = (ap->n + ap->tile - 1) / ap->tile;
+    mp_limb_t *buf = malloc(ap->tile * ap->n * n * sizeof(mp_limb_t));
+    if (!buf) return -1;
+    mpz_t s;
+    for (size_t b = 0; b < tiles; ++b) {
+        struct block blk = { ap, b * ap->tile, ap->tile, buf };
+        if (blk.r0 + blk.rows > ap->n) blk.rows = ap->n - blk.r0;
+        ws_parallel_for(b, tiles, 1, run_tile, &blk);
+        for (size_t i = blk.r0; i < blk.r0 + blk.rows && i + 1 < ap->n; ++i) {
+            for (size_t j = i + 1; j < ap->n; ++j) {
+                bigio_put_mpz(out, mpz_roinit_n(s, buf + ((i - blk.r0) * ap->n + j) * n, n));
+                if (out->fmt != BIGIO_BIN) bigio_puts(out, j + 1 < ap->n ? " " : "\n");
+            }
+        }
+        bigio_flush(out);
+    }
+    free(buf);
+    return out->error ? -1 : 0;
+}
@@ -0,0 +1,60 @@
+// allpairs.h
+// All-pairs Diffie-Hellman: S_ij = Y_j^X_i mod P for every pair i < j of N parties.
+//
+// Only the upper triangle is computed (S_ji = S_ij when Y_j = alpha^X_j). Everything that
+// depends on one party alone is done once: each public key Y_j gets its odd-power window
+// table in Montgomery form, each private key X_i its sliding-window recoding, and a pair is
+// then only the squarings and table multiplies of one exponentiation. Pairs are computed in
+// square tiles of rows (keys) by columns (peers), sized so the tables of one tile's peers fit
+// in ALLPAIRS_CACHE_BYTES: a tile walks its peers one at a time, that peer's table stays in
+// L1 while every row of the tile uses it, and the tile's recodings stay in L2. The tiles of
+// one block of rows run in parallel on the calling thread's scheduler (worksteal.h), and the
+// finished rows are streamed out before the next block starts, so memory stays at one block
+// of rows however large N is.
+
+#ifndef ALLPAIRS_H
+#define ALLPAIRS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <gmp.h>
+#include "bigint_io.h"
+#include "mont.h"
+
+#define ALLPAIRS_CACHE_BYTES (256u << 10) // peer tables per tile (a typical L2)
+
+// one step of a recoded exponent: sqr squarings, then a multiply by table entry idx
+// (ALLPAIRS_NO_MUL: none, only the trailing squarings)
+#define ALLPAIRS_NO_MUL UINT32_MAX
+typedef struct {
+    uint32_t sqr, idx;
+} allpairs_digit;
+
+typedef struct {
+    const mont_ctx *ctx;    // modulus engine (borrowed; must outlive the engine)
+    size_t n;               // parties
+    int w;                  // window bits
+    size_t tile;            // rows and columns per tile
+    size_t words;           // words per value: ctx->n limbs, or ctx->ifma->k 52-bit digits
+    size_t tlimbs;          // words per table: 2^(w-1) entries
+    mp_limb_t *table;       // party j's Y^1, Y^3, ..., Y^(2^w - 1) at table + j * tlimbs
+    allpairs_digit *digit;  // party i's recoded X is digit[first[i] .. first[i + 1])
+    size_t *first;
+} allpairs;
+
+// Tables and recodings for keys X[0..n) (>= 0) and public keys Y[0..n); tile = 0 picks it
+// from ALLPAIRS_CACHE_BYTES. 0 on success, -1 without memory.
+int allpairs_init(allpairs *ap, const mpz_t X[], const mpz_t Y[], size_t n, size_t tile,
+                  const mont_ctx *ctx);
+void allpairs_clear(allpairs *ap);
+
+// s = Y_j^X_i mod P for one pair (any i, j)
+void allpairs_pair(mpz_t s, const allpairs *ap, size_t i, size_t j);
+
+// Every S_ij with i < j, row by row: S_01 .. S_0(n-1), S_12, ... In dec and hex, row i is one
+// line of its n-1-i values separated by spaces (the last, empty row is left out); in bin,
+// the records follow each other in the same order. 0 on success, -1 without memory or if
+// a write failed.
+int allpairs_write(const allpairs *ap, bigio_writer *out);
+
+#endif
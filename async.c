@@ -0,0 +1,197 @@
+// async.c
+
+#include <stdlib.h>
+#include "async.h"
+#include "drbg.h"
+#include "mont.h"
+#include "primroot.h"
+#include "safeprime.h"
+
+#define FACTOR_WINDOW 512  // trial primes per slice
+#define GEN_WINDOW    16   // generator candidates per slice
+#define KEYGEN_WINDOW 16   // key pairs per slice
+
+// one slice on a worker, then either finish or go to the back of the queue
+static void run_slice(void *p) {
+    async_task *t = p;
+    if (atomic_load(&t->cancel)) {
+        t->finish(t, 0);
+        atomic_store(&t->status, ASYNC_CANCELLED);
+        return;
+    }
+    t->slices++;
+    if (t->step(t)) {
+        t->finish(t, 1);
+        atomic_store(&t->status, ASYNC_DONE);
+        return;
+    }
+    ws_submit(t->sched, &t->group, run_slice, t); // yield
+}
+
+static async_task *start(ws_sched *s, int (*step)(async_task *), void (*finish)(async_task *, int),
+                         void *state) {
+    async_task *t = malloc(sizeof(*t));
+    if (!t) { finish(&(async_task){ .state = state }, 0); return NULL; }
+    t->sched = s;
+    ws_group_init(&t->group);
+    atomic_init(&t->cancel, 0);
+    atomic_init(&t->status, ASYNC_RUNNING);
+    t->slices = 0;
+    t->step = step;
+    t->finish = finish;
+    t->state = state;
+    ws_submit(s, &t->group, run_slice, t);
+    return t;
+}
+
+void async_cancel(async_task *t) { atomic_store(&t->cancel, 1); }
+async_status async_poll(const async_task *t) { return atomic_load(&t->status); }
+
+async_status async_wait(async_task *t) {
+    ws_wait(&t->group);
+    return atomic_load(&t->status);
+}
+
+void async_free(async_task *t) { free(t); }
+
+// ---------------- safe prime ----------------
+
+struct safe_prime_state {
+    mpz_ptr P, r;
+    unsigned digits;
+    int started;
+    safeprime_search search;
+    mpz_t fP, fr;
+};
+
+static int safe_prime_step(async_task *t) {
+    struct safe_prime_state *st = t->state;
+    if (!st->started) { // keyed from the running thread's stream on the first slice
+        safeprime_init(&st->search, st->digits, 0);
+        safeprime_reseed(&st->search, drbg_thread());
+        st->started = 1;
+    }
+    return safeprime_step(&st->search, SAFEPRIME_WINDOW, st->fP, st->fr);
+}
+
+static void safe_prime_finish(async_task *t, int done) {
+    struct safe_prime_state *st = t->state;
+    if (done) { mpz_set(st->P, st->fP); mpz_set(st->r, st->fr); }
+    if (st->started) safeprime_clear(&st->search);
+    mpz_clears(st->fP, st->fr, NULL);
+    free(st);
+}
+
+async_task *async_safe_prime(ws_sched *s, mpz_t P, mpz_t r, unsigned digits) {
+    struct safe_prime_state *st = malloc(sizeof(*st));
+    if (!st) return NULL;
+    st->P = P; st->r = r; st->digits = digits; st->started = 0;
+    mpz_inits(st->fP, st->fr, NULL);
+    return start(s, safe_prime_step, safe_prime_finish, st);
+}
+
+// ---------------- factoring ----------------
+
+struct factor_task_state {
+    mpz_t *out;
+    size_t *outk;
+    factor_state f;
+    mpz_t factors[PRIMROOT_MAX_FACTORS];
+    size_t k;
+};
+
+static int factor_task_step(async_task *t) {
+    struct factor_task_state *st = t->state;
+    return factor_step(&st->f, st->factors, &st->k, FACTOR_WINDOW);
+}
+
+static void factor_task_finish(async_task *t, int done) {
+    struct factor_task_state *st = t->state;
+    for (size_t i = 0; i < st->k; ++i) {
+        if (done) mpz_init_set(st->out[i], st->factors[i]);
+        mpz_clear(st->factors[i]);
+    }
+    if (done) *st->outk = st->k;
+    factor_end(&st->f);
+    free(st);
+}
+
+async_task *async_factor(ws_sched *s, const mpz_t n, mpz_t factors[], size_t *k) {
+    struct factor_task_state *st = malloc(sizeof(*st));
+    if (!st) return NULL;
+    st->out = factors; st->outk = k;
+    factor_begin(&st->f, n, st->factors, &st->k);
+    return start(s, factor_task_step, factor_task_finish, st);
+}
+
+// ---------------- generator search ----------------
+
+struct gen_state {
+    unsigned long *out;
+    unsigned long cand;
+    primroot_ctx ctx;
+};
+
+static int gen_step(async_task *t) {
+    struct gen_state *st = t->state;
+    for (int i = 0; i < GEN_WINDOW; ++i, ++st->cand)
+        if (primroot_test(&st->ctx, st->cand)) return 1;
+    return 0;
+}
+
+static void gen_finish(async_task *t, int done) {
+    struct gen_state *st = t->state;
+    if (done) *st->out = st->cand;
+    primroot_clear(&st->ctx);
+    free(st);
+}
+
+async_task *async_generator(ws_sched *s, const mpz_t p, mpz_t factors[], size_t k,
+                            unsigned long start_at, unsigned long *g) {
+    struct gen_state *st = malloc(sizeof(*st));
+    if (!st) return NULL;
+    if (primroot_init(&st->ctx, p, factors, k) != 0) { free(st); return NULL; }
+    st->out = g;
+    st->cand = start_at;
+    return start(s, gen_step, gen_finish, st);
+}
+
+// ---------------- key generation ----------------
+
+struct keygen_state {
+    mpz_t *x, *y;
+    size_t count, next;
+    mpz_t alpha, range; // range = P-3: x = 2 + uniform[0, P-3)
+    mont_ctx ctx;
+};
+
+static int keygen_step(async_task *t) {
+    struct keygen_state *st = t->state;
+    drbg *rng = drbg_thread();
+    for (int i = 0; i < KEYGEN_WINDOW && st->next < st->count; ++i, ++st->next) {
+        drbg_urandomm(st->x[st->next], rng, st->range);
+        mpz_add_ui(st->x[st->next], st->x[st->next], 2);
+        mont_powm(st->y[st->next], st->alpha, st->x[st->next], &st->ctx);
+    }
+    return st->next == st->count;
+}
+
+static void keygen_finish(async_task *t, int done) {
+    struct keygen_state *st = t->state;
+    (void)done; // x and y are the caller's either way; a cancelled batch is partly filled
+    mont_clear(&st->ctx);
+    mpz_clears(st->alpha, st->range, NULL);
+    free(st);
+}
+
+async_task *async_keygen(ws_sched *s, const mpz_t P, const mpz_t alpha, size_t count,
+                         mpz_t *x, mpz_t *y) {
+    struct keygen_state *st = malloc(sizeof(*st));
+    if (!st) return NULL;
+    if (mpz_cmp_ui(P, 5) < 0 || mont_init(&st->ctx, P) != 0) { free(st); return NULL; }
+    st->x = x; st->y = y; st->count = count; st->next = 0;
+    mpz_init_set(st->alpha, alpha);
+    mpz_init(st->range);
+    mpz_sub_ui(st->range, P, 3);
+    return start(s, keygen_step, keygen_finish, st);
+}
@@ -0,0 +1,60 @@
+// async.h
+// Asynchronous prime generation, factoring, generator search and key generation.
+//
+// Each request is an async_task driven by the work-stealing scheduler: one scheduler task runs
+// one slice of the work (a sieve window, a block of trial divisions, a block of generator
+// candidates or keys) and then resubmits itself to the back of the scheduler's queue, so many
+// outstanding requests share the workers round-robin instead of needing a thread each.
+// Between slices a task can be cancelled; its outputs are then left untouched (key generation
+// keeps the pairs finished so far).
+//
+// Outputs are written into the caller's variables when the task completes; they must stay
+// valid until async_wait returns. Tasks are started from any thread with a scheduler.
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <gmp.h>
+#include "worksteal.h"
+
+typedef enum {
+    ASYNC_RUNNING,
+    ASYNC_DONE,
+    ASYNC_CANCELLED,
+} async_status;
+
+typedef struct async_task async_task;
+
+struct async_task {
+    ws_sched *sched;
+    ws_group group;          // pending while a slice is queued or running
+    atomic_int cancel;
+    atomic_int status;       // async_status
+    unsigned long slices;    // slices run so far
+    int (*step)(async_task *t);               // one slice; 1 when the result is complete
+    void (*finish)(async_task *t, int done);  // publish (done) or drop the result, free state
+    void *state;
+};
+
+// safe prime P = 2r+1 with at least digits decimal digits (P must fit in FIXINT_LIMBS)
+async_task *async_safe_prime(ws_sched *s, mpz_t P, mpz_t r, unsigned digits);
+// distinct prime factors of n into factors[0..*k) (initialized on completion)
+async_task *async_factor(ws_sched *s, const mpz_t n, mpz_t factors[], size_t *k);
+// smallest primitive root >= start mod prime p, given the distinct primes of p-1
+async_task *async_generator(ws_sched *s, const mpz_t p, mpz_t factors[], size_t k,
+                            unsigned long start, unsigned long *g);
+// count DH key pairs: x[i] random in [2, P-2], y[i] = alpha^x[i] mod P (x, y initialized)
+async_task *async_keygen(ws_sched *s, const mpz_t P, const mpz_t alpha, size_t count,
+                         mpz_t *x, mpz_t *y);
+
+// request cancellation; takes effect before the task's next slice
+void async_cancel(async_task *t);
+async_status async_poll(const async_task *t);
+// block (helping the scheduler when called from a worker) until the task has finished
+async_status async_wait(async_task *t);
+// release a task once async_wait has returned for it
+void async_free(async_task *t);
+
+#endif
@@ -0,0 +1,1308 @@
+// bench.c
+// Build: make bench   (see Makefile)
+// Run  : ./bench <name> [args]   (./bench with no arguments lists the benchmarks)
+//
+// Micro-benchmarks for the shared kernels; every benchmark also checks its results against
+// plain GMP before timing anything.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "allpairs.h"
+#include "async.h"
+#include "bigint_io.h"
+#include "drbg.h"
+#include "ecpp.h"
+#include "fixedbase.h"
+#include "hugepage.h"
+#include "ifma.h"
+#include "mpmc.h"
+#include "mont.h"
+#include "perfctr.h"
+#include "mr64.h"
+#include "pipeline.h"
+#include "primroot.h"
+#include "provable.h"
+#include "safeprime.h"
+#include "smooth.h"
+#include "soa_batch.h"
+#include "worksteal.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// random odd prime modulus of the given size
+static void random_prime(mpz_t p, gmp_randstate_t st, unsigned bits) {
+    mpz_urandomb(p, st, bits);
+    mpz_setbit(p, bits - 1);
+    mpz_nextprime(p, p);
+}
+
+// g1^a * g2^b mod P: two single exponentiations vs. one Straus/Shamir JSF pass
+static int bench_multiexp(int argc, char **argv) {
+    unsigned bits = argc >= 1 ? (unsigned)atoi(argv[0]) : 2048;
+    int iters = bits >= 4096 ? 50 : 400;
+
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t P, g1, g2, a, b, r1, r2, t;
+    mpz_inits(P, g1, g2, a, b, r1, r2, t, NULL);
+    random_prime(P, st, bits);
+    mont_ctx ctx; mont_init(&ctx, P);
+
+    for (int i = 0; i < 20; ++i) { // correctness against mpz_powm
+        mpz_urandomm(g1, st, P); mpz_urandomm(g2, st, P);
+        mpz_urandomb(a, st, bits); mpz_urandomb(b, st, bits - (unsigned)i);
+        mpz_powm(r1, g1, a, P); mpz_powm(t, g2, b, P); mpz_mul(r1, r1, t); mpz_mod(r1, r1, P);
+        mont_powm2(r2, g1, a, g2, b, &ctx);
+        if (mpz_cmp(r1, r2) != 0) { fprintf(stderr, "multiexp: mont_powm2 mismatch\n"); return 1; }
+        mont_powm(r2, g1, a, &ctx);
+        mpz_powm(r1, g1, a, P);
+        if (mpz_cmp(r1, r2) != 0) { fprintf(stderr, "multiexp: mont_powm mismatch\n"); return 1; }
+    }
+
+    double t0 = now_seconds();
+    for (int i = 0; i < iters; ++i) mpz_powm(r1, g1, a, P);
+    double gmp_single = (now_seconds() - t0) / iters;
+
+    t0 = now_seconds();
+    for (int i = 0; i < iters; ++i) mont_powm(r1, g1, a, &ctx);
+    double single = (now_seconds() - t0) / iters;
+
+    t0 = now_seconds();
+    for (int i = 0; i < iters; ++i) {
+        mont_powm(r1, g1, a, &ctx); mont_powm(t, g2, b, &ctx);
+        mpz_mul(r1, r1, t); mpz_mod(r1, r1, P);
+    }
+    double twice = (now_seconds() - t0) / iters;
+
+    t0 = now_seconds();
+    for (int i = 0; i < iters; ++i) mont_powm2(r2, g1, a, g2, b, &ctx);
+    double joint = (now_seconds() - t0) / iters;
+
+    printf("%u-bit modulus, %u-bit exponents\n", bits, bits);
+    printf("mpz_powm            : %10.1f us\n", gmp_single * 1e6);
+    printf("mont_powm           : %10.1f us (1.00x)\n", single * 1e6);
+    printf("2x mont_powm + mul  : %10.1f us (%.2fx)\n", twice * 1e6, twice / single);
+    printf("mont_powm2          : %10.1f us (%.2fx)\n", joint * 1e6, joint / single);
+
+    mont_clear(&ctx);
+    mpz_clears(P, g1, g2, a, b, r1, r2, t, NULL);
+    gmp_randclear(st);
+    return 0;
+}
+
+// limb-count specialised Montgomery kernels vs. the size-generic mpn path, per width (the
+// kernels stop at 4 limbs: from 8 up GMP's mpn loops were faster)
+static int bench_montfixed(int argc, char **argv) {
+    (void)argc; (void)argv;
+    static const int widths[] = { 1, 2, 3, 4 };
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t m, x, y;
+    mpz_inits(m, x, y, NULL);
+
+    printf("%6s %14s %14s %8s\n", "limbs", "generic (ns)", "fixed (ns)", "speedup");
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        int n = widths[w];
+        mpz_urandomb(m, st, n * GMP_NUMB_BITS);
+        mpz_setbit(m, n * GMP_NUMB_BITS - 1);
+        mpz_setbit(m, 0);
+        mont_ctx ctx; mont_init(&ctx, m);
+        mont_kernel fixed = mont_fixed_kernel(n);
+
+        mp_limb_t a[n], b[n], c1[n], c2[n];
+        mpz_urandomm(x, st, m); mpz_urandomm(y, st, m);
+        mont_to(a, x, &ctx); mont_to(b, y, &ctx);
+        ctx.kernel = NULL;  mont_mul(c1, a, b, &ctx);
+        ctx.kernel = fixed; mont_mul(c2, a, b, &ctx);
+        if (memcmp(c1, c2, sizeof(c1)) != 0) { fprintf(stderr, "montfixed: %d-limb mismatch\n", n); return 1; }
+
+        // best of several alternating runs: single runs of a few ns per call are noisy
+        long iters = 4000000 / (n * n) + 1000;
+        double generic = 1e9, fast = 1e9;
+        for (int rep = 0; rep < 10; ++rep) {
+            double t0 = now_seconds();
+            ctx.kernel = NULL;
+            for (long i = 0; i < iters; ++i) mont_mul(a, a, b, &ctx);
+            double t = (now_seconds() - t0) / iters;
+            if (t < generic) generic = t;
+            t0 = now_seconds();
+            ctx.kernel = fixed;
+            for (long i = 0; i < iters; ++i) mont_mul(a, a, b, &ctx);
+            t = (now_seconds() - t0) / iters;
+            if (t < fast) fast = t;
+        }
+
+        printf("%6d %14.1f %14.1f %7.2fx\n", n, generic * 1e9, fast * 1e9, generic / fast);
+        mont_clear(&ctx);
+    }
+    mpz_clears(m, x, y, NULL);
+    gmp_randclear(st);
+    return 0;
+}
+
+// word-sized primality: mpz_probab_prime_p one at a time vs. deterministic MR, scalar and batched
+static int bench_mr64(int argc, char **argv) {
+    size_t count = argc >= 1 ? strtoul(argv[0], NULL, 10) : 1000000;
+    uint64_t *n = malloc(count * sizeof(*n));
+    unsigned char *ref = malloc(count), *got = malloc(count);
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t z; mpz_init(z);
+
+    // strong pseudoprimes to many small bases must still come out composite
+    static const uint64_t hard[] = { 3215031751ULL, 2152302898747ULL, 3474749660383ULL,
+                                     341550071728321ULL, 3825123056546413051ULL,
+                                     18446744073709551557ULL /* prime */ };
+    for (size_t i = 0; i < sizeof(hard) / sizeof(hard[0]); ++i) {
+        mpz_set_ui(z, hard[i]);
+        if (mr64_is_prime(hard[i]) != (mpz_probab_prime_p(z, 30) != 0)) {
+            fprintf(stderr, "mr64: wrong verdict for %llu\n", (unsigned long long)hard[i]);
+            return 1;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        n[i] = ((uint64_t)gmp_urandomb_ui(st, 32) << 32 | gmp_urandomb_ui(st, 32)) | 1;
+        if (i % 4 == 0) { // make a good share of them prime so the full test runs
+            mpz_set_ui(z, n[i] >> 1);
+            mpz_nextprime(z, z);
+            n[i] = mpz_get_ui(z);
+        }
+    }
+
+    double t0 = now_seconds();
+    for (size_t i = 0; i < count; ++i) { mpz_set_ui(z, n[i]); ref[i] = mpz_probab_prime_p(z, 25) != 0; }
+    double gmp = now_seconds() - t0;
+
+    t0 = now_seconds();
+    for (size_t i = 0; i < count; ++i) got[i] = (unsigned char)mr64_is_prime(n[i]);
+    double scalar = now_seconds() - t0;
+    if (memcmp(ref, got, count) != 0) { fprintf(stderr, "mr64: scalar mismatch\n"); return 1; }
+
+    soa_batch nb;
+    if (soa_init(&nb, 1, count) != 0) { fprintf(stderr, "mr64: out of memory\n"); return 1; }
+    for (size_t i = 0; i < count; ++i) soa_set_ui(&nb, i, n[i]);
+    t0 = now_seconds();
+    mr64_batch(&nb, got);
+    double batch = now_seconds() - t0;
+    if (memcmp(ref, got, count) != 0) { fprintf(stderr, "mr64: batch mismatch\n"); return 1; }
+
+    printf("%zu candidates below 2^64\n", count);
+    printf("mpz_probab_prime_p : %8.1f ns/candidate\n", gmp / count * 1e9);
+    printf("mr64_is_prime      : %8.1f ns/candidate (%.1fx)\n", scalar / count * 1e9, gmp / scalar);
+    printf("mr64_batch (%d)     : %8.1f ns/candidate (%.1fx)\n", MR64_LANES, batch / count * 1e9, gmp / batch);
+
+    mpz_clear(z); gmp_randclear(st);
+    soa_clear(&nb);
+    free(n); free(ref); free(got);
+    return 0;
+}
+
+// lane-wise Montgomery exponentiation over a structure-of-arrays batch vs. one mont_powm per
+// element, same exponent for every element (the generator-test shape)
+static int bench_soa(int argc, char **argv) {
+    size_t count = argc >= 1 ? strtoul(argv[0], NULL, 10) : 256;
+    static const int widths[] = { 1, 2, 3, 4, 8, 16 };
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t m, e, *x = malloc(count * sizeof(mpz_t)), *y = malloc(count * sizeof(mpz_t));
+    mpz_inits(m, e, NULL);
+    for (size_t j = 0; j < count; ++j) mpz_inits(x[j], y[j], NULL);
+
+    printf("%zu elements, shared exponent\n", count);
+    printf("%6s %16s %16s %8s\n", "limbs", "mont_powm (us)", "soa (us/elem)", "speedup");
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        int n = widths[w];
+        mpz_urandomb(m, st, n * GMP_NUMB_BITS);
+        mpz_setbit(m, n * GMP_NUMB_BITS - 1);
+        mpz_setbit(m, 0);
+        mpz_urandomb(e, st, n * GMP_NUMB_BITS);
+        mont_ctx ctx; mont_init(&ctx, m);
+        for (size_t j = 0; j < count; ++j) mpz_urandomm(x[j], st, m);
+
+        soa_batch b;
+        if (soa_init(&b, n, count) != 0 || soa_from_mpz(&b, (const mpz_t *)x, count) != 0) {
+            fprintf(stderr, "soa: transpose failed\n");
+            return 1;
+        }
+        int reps = 20000 / (n * n) + 1;
+        double t0 = now_seconds();
+        for (int r = 0; r < reps; ++r)
+            for (size_t j = 0; j < count; ++j) mont_powm(y[j], x[j], e, &ctx);
+        double scalar = (now_seconds() - t0) / (reps * (double)count);
+        t0 = now_seconds();
+        soa_batch out;
+        soa_init(&out, n, count);
+        for (int r = 0; r < reps; ++r) mont_powm_soa(&out, &b, e, &ctx);
+        double lanes = (now_seconds() - t0) / (reps * (double)count);
+
+        soa_to_mpz(x, &out);
+        for (size_t j = 0; j < count; ++j)
+            if (mpz_cmp(x[j], y[j]) != 0) { fprintf(stderr, "soa: %d-limb mismatch at %zu\n", n, j); return 1; }
+        printf("%6d %16.2f %16.2f %7.2fx\n", n, scalar * 1e6, lanes * 1e6, scalar / lanes);
+        soa_clear(&b); soa_clear(&out);
+        mont_clear(&ctx);
+    }
+
+    // primroot_test_soa must agree with primroot_test on the DH program's P
+    mpz_t P, Pm1, factors[PRIMROOT_MAX_FACTORS];
+    size_t k;
+    mpz_init_set_str(P, "982451653173961852241334935997", 10);
+    mpz_init(Pm1);
+    mpz_sub_ui(Pm1, P, 1);
+    factor_distinct(Pm1, factors, &k);
+    primroot_ctx gen;
+    primroot_init(&gen, P, factors, k);
+    soa_batch g;
+    unsigned char got[1000];
+    soa_init(&g, gen.mod_p.n, 1000);
+    for (size_t j = 0; j < 1000; ++j) soa_set_ui(&g, j, j);
+    primroot_test_soa(&gen, &g, got);
+    for (size_t j = 0; j < 1000; ++j)
+        if (got[j] != primroot_test(&gen, j)) { fprintf(stderr, "soa: generator verdict differs for %zu\n", j); return 1; }
+    printf("primroot_test_soa agrees with primroot_test on g < 1000\n");
+    soa_clear(&g);
+    primroot_clear(&gen);
+    for (size_t i = 0; i < k; ++i) mpz_clear(factors[i]);
+    mpz_clears(P, Pm1, NULL);
+
+    for (size_t j = 0; j < count; ++j) mpz_clears(x[j], y[j], NULL);
+    free(x); free(y);
+    mpz_clears(m, e, NULL);
+    gmp_randclear(st);
+    return 0;
+}
+
+// dependent random lookups (one 64-byte line per step, the access pattern of a large
+// precomputed table) on 4 KB pages vs. transparent / reserved 2 MB pages
+static int bench_hugepage(int argc, char **argv) {
+    size_t mb = argc >= 1 ? strtoul(argv[0], NULL, 10) : 256;
+    size_t lines = (mb << 20) / 64, steps = 20000000;
+    gmp_randstate_t st; gmp_randinit_default(st);
+    perfctr tlb;
+    int have_tlb = perfctr_open(&tlb, PERFCTR_DTLB_LOAD_MISSES) == 0;
+
+    printf("%zu MB table, %zu dependent lookups\n", mb, steps);
+    printf("%8s %14s %20s\n", "pages", "ns/lookup", "dTLB misses/lookup");
+    static const hugepage_kind kinds[] = { HUGEPAGE_NONE, HUGEPAGE_THP, HUGEPAGE_HUGETLB };
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); ++k) {
+        uint64_t *t = hugepage_alloc_as(lines * 64, kinds[k]);
+        if (!t) { printf("%8s %14s %20s\n", hugepage_kind_name(kinds[k]), "unavailable", "-"); continue; }
+
+        // one random cycle through every line (Sattolo), so each step misses the caches
+        size_t *perm = malloc(lines * sizeof(*perm));
+        for (size_t i = 0; i < lines; ++i) perm[i] = i;
+        for (size_t i = lines - 1; i > 0; --i) {
+            size_t j = gmp_urandomm_ui(st, i);
+            size_t x = perm[i]; perm[i] = perm[j]; perm[j] = x;
+        }
+        for (size_t i = 0; i < lines; ++i) t[perm[i] * 8] = perm[(i + 1) % lines];
+        free(perm);
+
+        size_t at = 0;
+        perfctr_start(&tlb);
+        double t0 = now_seconds();
+        for (size_t s = 0; s < steps; ++s) at = t[at * 8];
+        double dt = now_seconds() - t0;
+        uint64_t misses = perfctr_stop(&tlb);
+        char per[32] = "n/a";
+        if (have_tlb) snprintf(per, sizeof(per), "%.3f", (double)misses / steps);
+        printf("%8s %14.1f %20s%s\n", hugepage_kind_name(kinds[k]), dt / steps * 1e9, per,
+               at == (size_t)-1 ? "!" : "");
+        hugepage_free(t);
+    }
+    if (!have_tlb) printf("(perf counters unavailable here: TLB misses not measured)\n");
+    perfctr_close(&tlb);
+    gmp_randclear(st);
+    return 0;
+}
+
+// many outstanding asynchronous requests on one scheduler: safe primes (every other one
+// cancelled right after it starts), factorisations and generator searches of the factored
+// numbers, and a key-generation batch; every completed result is checked
+static int bench_async(int argc, char **argv) {
+    size_t n = argc >= 1 ? strtoul(argv[0], NULL, 10) : 16;
+    ws_sched *s = ws_create(0);
+    if (!s) { fprintf(stderr, "async: cannot start the scheduler\n"); return 1; }
+    mpz_t *P = malloc(n * sizeof(mpz_t)), *r = malloc(n * sizeof(mpz_t));
+    async_task **sp = malloc(n * sizeof(*sp)), **ft = malloc(n * sizeof(*ft));
+    mpz_t (*factors)[PRIMROOT_MAX_FACTORS] = malloc(n * sizeof(*factors));
+    size_t *k = malloc(n * sizeof(*k));
+    mpz_t Q, Qm1;
+    mpz_init_set_str(Q, "982451653173961852241334935997", 10);
+    mpz_init(Qm1);
+    mpz_sub_ui(Qm1, Q, 1);
+
+    double t0 = now_seconds();
+    for (size_t i = 0; i < n; ++i) {
+        mpz_inits(P[i], r[i], NULL);
+        sp[i] = async_safe_prime(s, P[i], r[i], 45);
+        if (i % 2) async_cancel(sp[i]);
+        ft[i] = async_factor(s, Qm1, factors[i], &k[i]);
+    }
+    size_t nkeys = 256;
+    mpz_t *x = malloc(nkeys * sizeof(mpz_t)), *y = malloc(nkeys * sizeof(mpz_t)), alpha;
+    for (size_t i = 0; i < nkeys; ++i) mpz_inits(x[i], y[i], NULL);
+    mpz_init_set_ui(alpha, 16);
+    async_task *kg = async_keygen(s, Q, alpha, nkeys, x, y);
+
+    size_t done = 0, cancelled = 0;
+    unsigned long slices = 0;
+    for (size_t i = 0; i < n; ++i) {
+        async_status st = async_wait(sp[i]);
+        slices += sp[i]->slices;
+        if (st == ASYNC_CANCELLED) { ++cancelled; async_free(sp[i]); continue; }
+        ++done;
+        mpz_t t; mpz_init(t);
+        mpz_mul_2exp(t, r[i], 1);
+        mpz_add_ui(t, t, 1);
+        if (mpz_cmp(t, P[i]) != 0 || !mpz_probab_prime_p(P[i], 30) || !mpz_probab_prime_p(r[i], 30)) {
+            fprintf(stderr, "async: request %zu returned a bad safe prime\n", i);
+            return 1;
+        }
+        mpz_clear(t);
+        async_free(sp[i]);
+    }
+    // a generator search per factorisation, chained on its result
+    async_task **gt = malloc(n * sizeof(*gt));
+    unsigned long *g = malloc(n * sizeof(*g));
+    for (size_t i = 0; i < n; ++i) {
+        async_wait(ft[i]);
+        slices += ft[i]->slices;
+        async_free(ft[i]);
+        gt[i] = async_generator(s, Q, factors[i], k[i], 16, &g[i]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        async_wait(gt[i]);
+        slices += gt[i]->slices;
+        async_free(gt[i]);
+        if (g[i] != 16) { fprintf(stderr, "async: generator search %zu found %lu\n", i, g[i]); return 1; }
+    }
+    async_wait(kg);
+    slices += kg->slices;
+    async_free(kg);
+    double dt = now_seconds() - t0;
+
+    mpz_t t; mpz_init(t);
+    for (size_t i = 0; i < nkeys; ++i) {
+        mpz_powm(t, alpha, x[i], Q);
+        if (mpz_cmp(t, y[i]) != 0) { fprintf(stderr, "async: key %zu is wrong\n", i); return 1; }
+    }
+    printf("%zu safe primes (%zu cancelled), %zu factorisations + generator searches, %zu keys\n",
+           done, cancelled, n, nkeys);
+    printf("%.3f s on %zu workers, %lu slices (one per sieve window / trial block / key block)\n",
+           dt, ws_nworkers(s), slices);
+
+    mpz_clear(t);
+    for (size_t i = 0; i < n; ++i) {
+        mpz_clears(P[i], r[i], NULL);
+        for (size_t j = 0; j < k[i]; ++j) mpz_clear(factors[i][j]);
+    }
+    for (size_t i = 0; i < nkeys; ++i) mpz_clears(x[i], y[i], NULL);
+    mpz_clears(Q, Qm1, alpha, NULL);
+    free(P); free(r); free(sp); free(ft); free(gt); free(g); free(factors); free(k); free(x); free(y);
+    ws_destroy(s);
+    return 0;
+}
+
+// writing and reading back many big integers: gmp_fprintf / mpz_get_str / mpz_set_str one at a
+// time vs. the buffered bigint_io writer in decimal, hex and binary; every format round-trips
+static int bench_io(int argc, char **argv) {
+    unsigned bits = argc >= 1 ? strtoul(argv[0], NULL, 10) : 4096;
+    size_t count = argc >= 2 ? strtoul(argv[1], NULL, 10) : 256;
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t *x = malloc(count * sizeof(mpz_t)), y;
+    for (size_t j = 0; j < count; ++j) { mpz_init(x[j]); mpz_urandomb(x[j], st, bits); }
+    mpz_init(y);
+    char *line = NULL; size_t cap = 0;
+
+    printf("%zu values of %u bits\n", count, bits);
+    printf("%-20s %12s %12s\n", "method", "write (us)", "read (us)");
+    for (int method = 0; method < 5; ++method) {
+        static const char *names[] = { "gmp_fprintf", "mpz_get_str", "bigio dec", "bigio hex", "bigio bin" };
+        bigio_format fmt = method == 3 ? BIGIO_HEX : method == 4 ? BIGIO_BIN : BIGIO_DEC;
+        FILE *f = tmpfile();
+        if (!f) { perror("io: tmpfile"); return 1; }
+
+        double t0 = now_seconds();
+        if (method == 0) {
+            for (size_t j = 0; j < count; ++j) gmp_fprintf(f, "%Zd\n", x[j]);
+        } else if (method == 1) {
+            for (size_t j = 0; j < count; ++j) {
+                char *str = mpz_get_str(NULL, 10, x[j]);
+                fputs(str, f); fputc('\n', f);
+                free(str);
+            }
+        } else {
+            bigio_writer w;
+            bigio_writer_init(&w, f, fmt, 0);
+            for (size_t j = 0; j < count; ++j) {
+                bigio_put_mpz(&w, x[j]);
+                if (fmt != BIGIO_BIN) bigio_puts(&w, "\n");
+            }
+            bigio_writer_close(&w);
+        }
+        fflush(f);
+        double wt = (now_seconds() - t0) / count;
+
+        rewind(f);
+        t0 = now_seconds();
+        for (size_t j = 0; j < count; ++j) {
+            int ok;
+            if (fmt == BIGIO_BIN) ok = bigio_read_bin(y, f) == 1;
+            else if (getline(&line, &cap, f) < 0) ok = 0;
+            else if (method < 2) { line[strcspn(line, "\n")] = '\0'; ok = mpz_set_str(y, line, 10) == 0; }
+            else ok = bigio_set_str(y, line, fmt) == 0;
+            if (!ok || mpz_cmp(y, x[j]) != 0) { fprintf(stderr, "io: %s round trip failed at %zu\n", names[method], j); return 1; }
+        }
+        double rt = (now_seconds() - t0) / count;
+        fclose(f);
+        printf("%-20s %12.2f %12.2f\n", names[method], wt * 1e6, rt * 1e6);
+    }
+
+    free(line);
+    for (size_t j = 0; j < count; ++j) mpz_clear(x[j]);
+    free(x);
+    mpz_clear(y);
+    gmp_randclear(st);
+    return 0;
+}
+
+// MPMC ring: producers push the numbers 1..n (split between them) and consumers sum what they
+// pop, one item at a time vs. PIPE_BATCH at a time; the sum checks nothing was lost or doubled
+struct ring_run {
+    mpmc_ring *q;
+    uint64_t lo, hi, sum; // producer range / consumer sum
+    size_t batch;
+    atomic_ullong *left;  // items not yet consumed
+};
+
+static void *ring_producer(void *arg) {
+    struct ring_run *r = arg;
+    uint64_t buf[PIPE_BATCH];
+    for (uint64_t v = r->lo; v < r->hi;) {
+        size_t n = 0;
+        while (n < r->batch && v + n < r->hi) { buf[n] = v + n; ++n; }
+        size_t k = mpmc_push_n(r->q, buf, n);
+        if (k == 0) sched_yield();
+        v += k;
+    }
+    return NULL;
+}
+
+static void *ring_consumer(void *arg) {
+    struct ring_run *r = arg;
+    uint64_t buf[PIPE_BATCH];
+    while (atomic_load_explicit(r->left, memory_order_relaxed) > 0) {
+        size_t k = mpmc_pop_n(r->q, buf, r->batch);
+        if (k == 0) { sched_yield(); continue; }
+        for (size_t i = 0; i < k; ++i) r->sum += buf[i];
+        atomic_fetch_sub_explicit(r->left, k, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+static int bench_ring(int argc, char **argv) {
+    uint64_t n = argc >= 1 ? strtoull(argv[0], NULL, 10) : 4000000;
+    unsigned threads = argc >= 2 ? (unsigned)strtoul(argv[1], NULL, 10) : 2;
+    printf("%llu items, %u producers, %u consumers, ring of 1024\n", (unsigned long long)n, threads, threads);
+    printf("%8s %14s\n", "batch", "Mitems/s");
+    static const size_t batches[] = { 1, 8, PIPE_BATCH };
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); ++b) {
+        mpmc_ring q;
+        mpmc_init(&q, 1024);
+        atomic_ullong left = n;
+        struct ring_run *runs = calloc(2 * threads, sizeof(*runs));
+        pthread_t *tid = malloc(2 * threads * sizeof(pthread_t));
+        double t0 = now_seconds();
+        for (unsigned t = 0; t < 2 * threads; ++t) {
+            runs[t] = (struct ring_run){ &q, 1 + n * (t % threads) / threads, 1 + n * (t % threads + 1) / threads,
+                                         0, batches[b], &left };
+            pthread_create(&tid[t], NULL, t < threads ? ring_producer : ring_consumer, &runs[t]);
+        }
+        uint64_t sum = 0;
+        for (unsigned t = 0; t < 2 * threads; ++t) {
+            pthread_join(tid[t], NULL);
+            if (t >= threads) sum += runs[t].sum;
+        }
+        double dt = now_seconds() - t0;
+        if (sum != n * (n + 1) / 2) { fprintf(stderr, "ring: lost or duplicated items (batch %zu)\n", batches[b]); return 1; }
+        printf("%8zu %14.2f\n", batches[b], n / dt / 1e6);
+        free(runs); free(tid);
+        mpmc_destroy(&q);
+    }
+    return 0;
+}
+
+// safe-prime generation and the generator search: the sequential loops vs. the staged
+// pipelines, same seed and start, so both must give the same P and the same generator
+static int bench_pipeline(int argc, char **argv) {
+    unsigned digits = argc >= 1 ? (unsigned)strtoul(argv[0], NULL, 10) : 70; // wider than FIXINT_LIMBS: mpz candidates, no generator search
+    unsigned threads = argc >= 2 ? (unsigned)strtoul(argv[1], NULL, 10) : 0;
+    unsigned long seed = argc >= 3 ? strtoul(argv[2], NULL, 10) : 426;
+    mpz_t P, r, Q, q;
+    mpz_inits(P, r, Q, q, NULL);
+
+    double t0 = now_seconds();
+    safeprime_search s;
+    safeprime_init(&s, digits, seed);
+    while (!safeprime_step(&s, SAFEPRIME_WINDOW, P, r)) {}
+    safeprime_clear(&s);
+    double seq = now_seconds() - t0;
+    t0 = now_seconds();
+    safeprime_pipeline(Q, q, digits, seed, 0, threads, stdout);
+    double piped = now_seconds() - t0;
+    if (mpz_cmp(P, Q) != 0) { fprintf(stderr, "pipeline: different safe prime\n"); return 1; }
+    printf("safe prime, %u digits: sequential %.3f s, pipeline %.3f s\n\n", digits, seq, piped);
+
+    fixint Pf, rf;
+    fixint_mont Pmod;
+    if (fixint_set_mpz(&Pf, P) != 0 || fixint_set_mpz(&rf, r) != 0 || fixint_mont_init(&Pmod, &Pf) != 0) {
+        printf("(P is wider than FIXINT_LIMBS: generator search skipped)\n");
+        mpz_clears(P, r, Q, q, NULL);
+        return 0;
+    }
+    // start far enough out that the search takes a measurable time: a run of non-generators
+    unsigned long start = 100, g;
+    t0 = now_seconds();
+    for (int rep = 0; rep < 100; ++rep)
+        for (g = start; !is_generator_safe_prime(g, &Pmod, &rf); ++g) {}
+    seq = (now_seconds() - t0) / 100;
+    t0 = now_seconds();
+    unsigned long h = safeprime_generator(start, &Pmod, &rf, threads, stdout);
+    piped = now_seconds() - t0;
+    if (g != h) { fprintf(stderr, "pipeline: generator %lu vs %lu\n", h, g); return 1; }
+    printf("generator %lu: sequential %.1f us, pipeline %.1f us\n", g, seq * 1e6, piped * 1e6);
+    mpz_clears(P, r, Q, q, NULL);
+    return 0;
+}
+
+// safe-prime generator test: Legendre symbol vs. the two exponentiations, on safe primes of
+// several sizes; every g in the range must get the same verdict from both
+static int bench_legendre(int argc, char **argv) {
+    unsigned long count = argc >= 1 ? strtoul(argv[0], NULL, 10) : 2000;
+    static const unsigned sizes[] = { 40, 51, 60, 75 }; // digits (safeprime_init uses >= 130 bits), up to FIXINT_LIMBS
+    mpz_t P, r;
+    mpz_inits(P, r, NULL);
+    printf("%6s %16s %16s %8s %10s\n", "digits", "powm (us/test)", "legendre (us)", "speedup", "generators");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        safeprime_pipeline(P, r, sizes[i], 426 + i, 0, 1, NULL);
+        fixint Pf, rf;
+        fixint_mont Pmod;
+        fixint_set_mpz(&Pf, P);
+        fixint_set_mpz(&rf, r);
+        fixint_mont_init(&Pmod, &Pf);
+
+        unsigned long gens = 0;
+        for (unsigned long g = 0; g < count; ++g) {
+            int a = is_generator_safe_prime(g, &Pmod, &rf), b = is_generator_safe_prime_powm(g, &Pmod, &rf);
+            if (a != b) { fprintf(stderr, "legendre: verdicts differ for g = %lu, %u digits\n", g, sizes[i]); return 1; }
+            gens += a;
+        }
+        volatile int sink = 0;
+        double t0 = now_seconds();
+        for (unsigned long g = 0; g < count; ++g) sink += is_generator_safe_prime_powm(g, &Pmod, &rf);
+        double powm = (now_seconds() - t0) / count;
+        t0 = now_seconds();
+        for (unsigned long g = 0; g < count; ++g) sink += is_generator_safe_prime(g, &Pmod, &rf);
+        double leg = (now_seconds() - t0) / count;
+        printf("%6u %16.3f %16.3f %7.1fx %10lu\n", sizes[i], powm * 1e6, leg * 1e6, powm / leg, gens);
+    }
+    mpz_clears(P, r, NULL);
+    return 0;
+}
+
+// pseudo-Mersenne safe primes P = 2^(64n) - c: folding reduction vs. Montgomery REDC on the
+// same P, per multiply (fixed-width kernels and the mpn fallback) and per full exponentiation
+// (where mont_powm on the REDC context is mpz_powm)
+static int bench_special(int argc, char **argv) {
+    (void)argc; (void)argv;
+    static const int widths[] = { 3, 4, 6, 8 };
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t P, r, x, y, e, r1, r2, r3;
+    mpz_inits(P, r, x, y, e, r1, r2, r3, NULL);
+
+    printf("%6s %10s %11s %11s %11s %8s %12s %12s %8s\n", "limbs", "c", "redc (ns)", "fold (ns)",
+           "fold mpn", "speedup", "mpz powm", "fold powm", "speedup");
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        int n = widths[w];
+        unsigned long c;
+        if (safeprime_special(P, r, (unsigned)((64 * n - 2) / 3.3219280948873626), &c) != 0
+            || mpz_size(P) != (size_t)n) {
+            fprintf(stderr, "special: no %d-limb safe prime\n", n);
+            return 1;
+        }
+        mont_ctx fold, redc;
+        mont_init(&fold, P);
+        mont_init_redc(&redc, P);
+        if (!fold.pmc) { fprintf(stderr, "special: mont_init missed the special form\n"); return 1; }
+
+        // the same product through each path, compared as plain residues
+        mp_limb_t a[n], b[n], fa[n], fb[n], t[n];
+        mpz_urandomm(x, st, P); mpz_urandomm(y, st, P);
+        mont_to(a, x, &redc); mont_to(b, y, &redc);
+        mont_to(fa, x, &fold); mont_to(fb, y, &fold);
+        mont_mul(t, a, b, &redc); mont_from(r1, t, &redc);
+        mont_mul(t, fa, fb, &fold); mont_from(r2, t, &fold);
+        mont_kernel kernel = fold.kernel;
+        fold.kernel = NULL;
+        mont_mul(t, fa, fb, &fold); mont_from(r3, t, &fold);
+        mpz_mul(e, x, y); mpz_mod(e, e, P);
+        if (mpz_cmp(r1, e) || mpz_cmp(r2, e) || mpz_cmp(r3, e)) { fprintf(stderr, "special: %d-limb product mismatch\n", n); return 1; }
+
+        long iters = 20000000 / (n * n) + 1000;
+        double t0 = now_seconds();
+        for (long i = 0; i < iters; ++i) mont_mul(a, a, b, &redc);
+        double tr = (now_seconds() - t0) / iters;
+        t0 = now_seconds();
+        for (long i = 0; i < iters; ++i) mont_mul(fa, fa, fb, &fold);
+        double tm = (now_seconds() - t0) / iters;
+        fold.kernel = kernel;
+        t0 = now_seconds();
+        for (long i = 0; i < iters; ++i) mont_mul(fa, fa, fb, &fold);
+        double tf = (now_seconds() - t0) / iters;
+
+        mpz_urandomb(e, st, n * GMP_NUMB_BITS);
+        int piters = 200000 / (n * n) + 5;
+        t0 = now_seconds();
+        for (int i = 0; i < piters; ++i) mont_powm(r1, x, e, &redc);
+        double pr = (now_seconds() - t0) / piters;
+        t0 = now_seconds();
+        for (int i = 0; i < piters; ++i) mont_powm(r2, x, e, &fold);
+        double pf = (now_seconds() - t0) / piters;
+        mpz_powm(r3, x, e, P);
+        if (mpz_cmp(r1, r3) || mpz_cmp(r2, r3)) { fprintf(stderr, "special: %d-limb powm mismatch\n", n); return 1; }
+
+        printf("%6d %10lu %11.1f %11.1f %11.1f %7.2fx %10.2fus %10.2fus %7.2fx\n", n, c, tr * 1e9,
+               tf * 1e9, tm * 1e9, tr / tf, pr * 1e6, pf * 1e6, pr / pf);
+        mont_clear(&fold);
+        mont_clear(&redc);
+    }
+    mpz_clears(P, r, x, y, e, r1, r2, r3, NULL);
+    gmp_randclear(st);
+    return 0;
+}
+
+// GMP allocation counters, installed with mp_set_memory_functions
+static unsigned long n_alloc, n_realloc;
+
+static void *count_alloc(size_t size) { ++n_alloc; return malloc(size); }
+static void *count_realloc(void *p, size_t old, size_t size) { (void)old; ++n_realloc; return realloc(p, size); }
+static void count_free(void *p, size_t size) { (void)size; free(p); }
+
+// generator tests and DH exponentiations: one-shot temporaries vs. set-up-once contexts, then
+// the generator tests' time on a prime where p-1 has many factors
+static int bench_alloc(int argc, char **argv) {
+    long tests = argc >= 1 ? strtol(argv[0], NULL, 10) : 20000;
+    mpz_t P, Pm1, g, X, Y, factors[PRIMROOT_MAX_FACTORS];
+    size_t k = 0;
+    mpz_inits(P, Pm1, g, X, Y, NULL);
+    mpz_set_str(P, "982451653173961852241334935997", 10); // diffie-hellman.c's P
+    mpz_sub_ui(Pm1, P, 1);
+    factor_distinct(Pm1, factors, &k);
+    primroot_ctx gen; primroot_init(&gen, P, factors, k);
+    mont_ctx ctx; mont_init(&ctx, P);
+    mpz_set_ui(X, 51015);
+
+    for (unsigned long c = 2; c < 2000; ++c) { // the two tests must agree
+        mpz_set_ui(g, c);
+        if (is_generator(g, P, factors, k) != primroot_test(&gen, c)) {
+            fprintf(stderr, "alloc: generator tests disagree at %lu\n", c);
+            return 1;
+        }
+    }
+
+    mp_set_memory_functions(count_alloc, count_realloc, count_free);
+    printf("%-34s %12s %12s %10s\n", "", "allocs/op", "reallocs/op", "us/op");
+
+    n_alloc = n_realloc = 0;
+    double t0 = now_seconds();
+    for (long i = 0; i < tests; ++i) { mpz_set_ui(g, 16 + i % 1000); is_generator(g, P, factors, k); }
+    double t = (now_seconds() - t0) / tests;
+    printf("%-34s %12.2f %12.2f %10.2f\n", "is_generator (fresh temporaries)",
+           (double)n_alloc / tests, (double)n_realloc / tests, t * 1e6);
+
+    n_alloc = n_realloc = 0;
+    t0 = now_seconds();
+    for (long i = 0; i < tests; ++i) primroot_test(&gen, 16 + i % 1000);
+    t = (now_seconds() - t0) / tests;
+    printf("%-34s %12.2f %12.2f %10.2f\n", "primroot_test (context reuse)",
+           (double)n_alloc / tests, (double)n_realloc / tests, t * 1e6);
+
+    n_alloc = n_realloc = 0;
+    t0 = now_seconds();
+    for (long i = 0; i < tests; ++i) { mpz_t y; mpz_init(y); mpz_powm(y, g, X, P); mpz_clear(y); }
+    t = (now_seconds() - t0) / tests;
+    printf("%-34s %12.2f %12.2f %10.2f\n", "DH: mpz_powm into a new mpz",
+           (double)n_alloc / tests, (double)n_realloc / tests, t * 1e6);
+
+    n_alloc = n_realloc = 0;
+    t0 = now_seconds();
+    for (long i = 0; i < tests; ++i) mont_powm(Y, g, X, &ctx);
+    t = (now_seconds() - t0) / tests;
+    printf("%-34s %12.2f %12.2f %10.2f\n", "DH: mont_powm into a reused mpz",
+           (double)n_alloc / tests, (double)n_realloc / tests, t * 1e6);
+
+    mp_set_memory_functions(NULL, NULL, NULL);
+    primroot_clear(&gen);
+    mont_clear(&ctx);
+    for (size_t i = 0; i < k; ++i) mpz_clear(factors[i]);
+
+    // A prime of about 512 bits with p-1 = 2*3*...*47 * (prime): 16 factors, where
+    // is_generator runs 16 full exponentiations per generator and the product tree about five.
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_primorial_ui(Pm1, 47);
+    do {
+        mpz_urandomb(Y, st, 512 - mpz_sizeinbase(Pm1, 2));
+        mpz_nextprime(Y, Y);
+        mpz_mul(P, Pm1, Y);
+        mpz_add_ui(P, P, 1);
+    } while (!mpz_probab_prime_p(P, 25));
+    mpz_sub_ui(Y, P, 1);
+    factor_distinct(Y, factors, &k);
+    primroot_init(&gen, P, factors, k);
+    printf("\n%zu-bit prime, %zu factors of p-1, candidates 2..1001:\n", mpz_sizeinbase(P, 2), k);
+    int found = 0;
+    for (unsigned long c = 2; c < 1002; ++c) {
+        mpz_set_ui(g, c);
+        if (is_generator(g, P, factors, k) != primroot_test(&gen, c)) {
+            fprintf(stderr, "alloc: generator tests disagree at %lu\n", c);
+            return 1;
+        }
+        found += primroot_test(&gen, c);
+    }
+    t0 = now_seconds();
+    for (unsigned long c = 2; c < 1002; ++c) { mpz_set_ui(g, c); is_generator(g, P, factors, k); }
+    double one_shot = (now_seconds() - t0) / 1000;
+    t0 = now_seconds();
+    for (unsigned long c = 2; c < 1002; ++c) primroot_test(&gen, c);
+    double tree = (now_seconds() - t0) / 1000;
+    printf("%-34s %10.2f us/op\n", "is_generator", one_shot * 1e6);
+    printf("%-34s %10.2f us/op (%.2fx, %d generators)\n", "primroot_test (product tree)", tree * 1e6,
+           one_shot / tree, found);
+
+    primroot_clear(&gen);
+    for (size_t i = 0; i < k; ++i) mpz_clear(factors[i]);
+    gmp_randclear(st);
+    mpz_clears(P, Pm1, g, X, Y, NULL);
+    return 0;
+}
+
+struct bench {
+    const char *name;
+    const char *usage;
+    int (*run)(int argc, char **argv);
+};
+
+// The minv = 1 kernels (mont_use_friendly) against the ordinary ones on the same friendly
+// modulus (low limb all ones), 1-4 limbs; then the friendly safe-prime walk against the
+// ordinary one. mont_init leaves the choice off unless this shows a gain beyond noise.
+static int bench_friendly(int argc, char **argv) {
+    (void)argc; (void)argv;
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t m, x, y, e, r1;
+    mpz_inits(m, x, y, e, r1, NULL);
+
+    printf("%6s %12s %12s %8s %12s %12s %8s\n", "limbs", "mul (ns)", "friendly", "speedup",
+           "sqr (ns)", "friendly", "speedup");
+    for (int n = 1; mont_fixed1_kernel(n); ++n) {
+        mpz_urandomb(m, st, n * GMP_NUMB_BITS);
+        mpz_setbit(m, n * GMP_NUMB_BITS - 1);
+        mpz_tdiv_q_2exp(m, m, GMP_NUMB_BITS);
+        mpz_mul_2exp(m, m, GMP_NUMB_BITS);
+        mpz_add_ui(m, m, GMP_NUMB_MAX); // low limb all ones: minv = 1
+
+        double tm[2], ts[2];
+        for (int f = 0; f < 2; ++f) {
+            mont_ctx ctx;
+            mont_init_redc(&ctx, m); // REDC even for the 1-limb m = 2^64 - 1
+            if (f && mont_use_friendly(&ctx) != 0) {
+                fprintf(stderr, "friendly: %d-limb modulus not accepted\n", n);
+                return 1;
+            }
+            mp_limb_t a[n], b[n], p[n];
+            mpz_urandomm(x, st, m); mpz_urandomm(y, st, m);
+            mont_to(a, x, &ctx); mont_to(b, y, &ctx);
+            mont_mul(p, a, b, &ctx); mont_from(r1, p, &ctx);
+            mpz_mul(e, x, y); mpz_mod(e, e, m);
+            if (mpz_cmp(r1, e)) { fprintf(stderr, "friendly: %d-limb product mismatch\n", n); return 1; }
+
+            // best of three: the difference is one multiply per limb, below run-to-run noise
+            long iters = 20000000 / (n * n) + 1000;
+            tm[f] = ts[f] = 1e9;
+            for (int rep = 0; rep < 3; ++rep) {
+                double t0 = now_seconds();
+                for (long i = 0; i < iters; ++i) mont_mul(a, a, b, &ctx);
+                double t = (now_seconds() - t0) / iters;
+                if (t < tm[f]) tm[f] = t;
+                t0 = now_seconds();
+                for (long i = 0; i < iters; ++i) mont_sqr(p, p, &ctx);
+                t = (now_seconds() - t0) / iters;
+                if (t < ts[f]) ts[f] = t;
+            }
+            mont_clear(&ctx);
+        }
+        printf("%6d %12.2f %12.2f %7.2fx %12.2f %12.2f %7.2fx\n", n, tm[0] * 1e9, tm[1] * 1e9,
+               tm[0] / tm[1], ts[0] * 1e9, ts[1] * 1e9, ts[0] / ts[1]);
+    }
+
+    // safe primes: the friendly walk steps r by 2^63, so its candidates are as dense in safe
+    // primes as the ordinary walk's
+    for (int f = 0; f < 2; ++f) {
+        double t0 = now_seconds();
+        safeprime_pipeline(m, e, 70, 426, f, 1, NULL);
+        double t = now_seconds() - t0;
+        if (!mpz_probab_prime_p(m, 30) || !mpz_probab_prime_p(e, 30)
+            || (f && mpz_getlimbn(m, 0) != GMP_NUMB_MAX)) {
+            fprintf(stderr, "friendly: bad %s safe prime\n", f ? "friendly" : "ordinary");
+            return 1;
+        }
+        printf("%s 70-digit safe prime: %.3f s, low limb %016lx\n", f ? "friendly" : "ordinary", t,
+               (unsigned long)mpz_getlimbn(m, 0));
+    }
+    mpz_clears(m, x, y, e, r1, NULL);
+    gmp_randclear(st);
+    return 0;
+}
+
+// mont_powm on the radix-2^52 IFMA engine against the same context with it switched off and
+// against mpz_powm, full-size exponents; the crossover sets IFMA_MIN_BITS
+static int bench_ifma(int argc, char **argv) {
+    int reps = argc >= 1 ? atoi(argv[0]) : 20;
+    static const unsigned sizes[] = { 512, 1024, 1536, 2048, 3072, 4096 };
+    if (!ifma_available()) { printf("no AVX-512 IFMA on this CPU\n"); return 0; }
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t m, x, e, r1, r2, r3;
+    mpz_inits(m, x, e, r1, r2, r3, NULL);
+
+    printf("%6s %12s %12s %12s %8s\n", "bits", "mpz (us)", "mont (us)", "ifma (us)", "speedup");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        unsigned bits = sizes[i];
+        mpz_urandomb(m, st, bits);
+        mpz_setbit(m, bits - 1);
+        mpz_setbit(m, 0);
+        mont_ctx ctx;
+        mont_init(&ctx, m);
+        ifma_ctx *own = NULL, *ifma = ctx.ifma;
+        if (!ifma) { // below IFMA_MIN_BITS mont_init keeps the limbs; time the engine anyway
+            own = ifma = aligned_alloc(64, sizeof(ifma_ctx));
+            if (!own || ifma_init(own, m) != 0) { fprintf(stderr, "ifma: init failed\n"); return 1; }
+        }
+
+        mpz_urandomm(x, st, m);
+        mpz_urandomb(e, st, bits);
+        double t0 = now_seconds();
+        for (int r = 0; r < reps; ++r) mpz_powm(r1, x, e, m);
+        double tz = (now_seconds() - t0) / reps;
+        ctx.ifma = NULL;
+        t0 = now_seconds();
+        for (int r = 0; r < reps; ++r) mont_powm(r2, x, e, &ctx);
+        double tm = (now_seconds() - t0) / reps;
+        ctx.ifma = ifma;
+        t0 = now_seconds();
+        for (int r = 0; r < reps; ++r) mont_powm(r3, x, e, &ctx);
+        double ti = (now_seconds() - t0) / reps;
+        if (mpz_cmp(r1, r2) || mpz_cmp(r1, r3)) { fprintf(stderr, "ifma: %u-bit powm mismatch\n", bits); return 1; }
+
+        printf("%6u %12.1f %12.1f %12.1f %7.2fx%s\n", bits, tz * 1e6, tm * 1e6, ti * 1e6, tm / ti,
+               own ? "  (not used by mont_init)" : "");
+        if (own) { ctx.ifma = NULL; ifma_clear(own); free(own); }
+        mont_clear(&ctx);
+    }
+    mpz_clears(m, x, e, r1, r2, r3, NULL);
+    gmp_randclear(st);
+    return 0;
+}
+
+// one fixed-base exponentiation (random base, full-size exponent) split over 1, 2, 4, ...
+// workers against a single mont_powm; the split bases are precomputed once per worker count
+static int bench_fixedbase(int argc, char **argv) {
+    unsigned bits = argc >= 1 ? (unsigned)strtoul(argv[0], NULL, 10) : 8192;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t maxw = argc >= 2 ? strtoul(argv[1], NULL, 10) : (size_t)(cpus > 0 ? cpus : 1);
+    int reps = 3;
+    gmp_randstate_t st; gmp_randinit_default(st);
+    mpz_t m, g, e, r1, r2;
+    mpz_inits(m, g, e, r1, r2, NULL);
+    mpz_urandomb(m, st, bits);
+    mpz_setbit(m, bits - 1);
+    mpz_setbit(m, 0);
+    mpz_urandomm(g, st, m);
+    mpz_urandomb(e, st, bits);
+    mont_ctx ctx;
+    mont_init(&ctx, m);
+
+    double t0 = now_seconds();
+    for (int r = 0; r < reps; ++r) mont_powm(r1, g, e, &ctx);
+    double single = (now_seconds() - t0) / reps;
+    printf("%u-bit modulus%s: mont_powm %.2f ms\n", bits, ctx.ifma ? " (IFMA)" : "", single * 1e3);
+    printf("%8s %8s %14s %12s %8s\n", "workers", "pieces", "precompute ms", "powm ms", "speedup");
+    for (size_t w = 1; w <= maxw; w = w * 2 > maxw && w < maxw ? maxw : w * 2) {
+        ws_sched *s = ws_create(w);
+        if (!s) { fprintf(stderr, "fixedbase: cannot start %zu workers\n", w); return 1; }
+        fixed_base fb;
+        t0 = now_seconds();
+        if (fixed_base_init(&fb, g, bits, 0, &ctx) != 0) { fprintf(stderr, "fixedbase: out of memory\n"); return 1; }
+        double pre = now_seconds() - t0;
+        t0 = now_seconds();
+        for (int r = 0; r < reps; ++r) fixed_base_powm(r2, &fb, e);
+        double split = (now_seconds() - t0) / reps;
+        if (mpz_cmp(r1, r2)) { fprintf(stderr, "fixedbase: %zu workers give a different power\n", w); return 1; }
+        printf("%8zu %8zu %14.2f %12.2f %7.2fx\n", w, fb.t, pre * 1e3, split * 1e3, single / split);
+        fixed_base_clear(&fb);
+        ws_destroy(s);
+    }
+    mont_clear(&ctx);
+    mpz_clears(m, g, e, r1, r2, NULL);
+    gmp_randclear(st);
+    return 0;
+}
+
+// ChaCha20 DRBG against GMP's Mersenne Twister: bytes per second, and limbs for 2048-bit
+// private exponents; first checks the zero-key stream against the published ChaCha20 block
+static int bench_drbg(int argc, char **argv) {
+    size_t mb = argc >= 1 ? strtoul(argv[0], NULL, 10) : 256;
+    static const unsigned char kat[32] = { // block 0 of key 0, stream 0, bytes 32..63
+        0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+        0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86 };
+    drbg d;
+    unsigned char first[32];
+    drbg_seed_ui(&d, 0); // the first 32 bytes of a refill are the next key, never output
+    drbg_bytes(&d, first, sizeof(first));
+    if (memcmp(first, kat, sizeof(kat)) != 0) { fprintf(stderr, "drbg: ChaCha20 known answer mismatch\n"); return 1; }
+
+    size_t len = 1 << 20;
+    unsigned char *buf = malloc(len);
+    gmp_randstate_t mt; gmp_randinit_default(mt); gmp_randseed_ui(mt, 426);
+    mpz_t x, n; mpz_inits(x, n, NULL);
+    double t0 = now_seconds();
+    for (size_t i = 0; i < mb; ++i) drbg_bytes(drbg_thread(), buf, len);
+    double tc = now_seconds() - t0;
+    t0 = now_seconds();
+    for (size_t i = 0; i < mb; ++i) mpz_urandomb(x, mt, 8 * len);
+    double tm = now_seconds() - t0;
+    printf("bulk:     chacha20 %8.0f MB/s   mt19937 %8.0f MB/s\n", mb / tc, mb / tm);
+
+    if (drbg_urandomm(x, drbg_thread(), n) != -1) { fprintf(stderr, "drbg: empty range accepted\n"); return 1; }
+    mpz_setbit(n, 2048);
+    mpz_sub_ui(n, n, 1);
+    long count = 200000;
+    t0 = now_seconds();
+    for (long i = 0; i < count; ++i) drbg_urandomm(x, drbg_thread(), n);
+    tc = (now_seconds() - t0) / count;
+    t0 = now_seconds();
+    for (long i = 0; i < count; ++i) mpz_urandomm(x, mt, n);
+    tm = (now_seconds() - t0) / count;
+    printf("2048-bit: chacha20 %8.1f ns      mt19937 %8.1f ns per exponent\n", tc * 1e9, tm * 1e9);
+    mpz_clears(x, n, NULL);
+    gmp_randclear(mt);
+    free(buf);
+    return 0;
+}
+
+// Maurer and Shawe-Taylor against a probable prime of the same size (random start, then
+// mpz_nextprime), and a proven safe prime against gen_safe_prime; every chain is verified,
+// and a chain with one link altered must fail
+static int bench_provable(int argc, char **argv) {
+    unsigned bits = argc >= 1 ? (unsigned)strtoul(argv[0], NULL, 10) : 1024;
+    unsigned safe_digits = argc >= 2 ? (unsigned)strtoul(argv[1], NULL, 10) : 70; // gen_safe_prime: <= 256 bits
+    int reps = 5;
+    prime_cert cert;
+    prime_cert_init(&cert);
+    mpz_t p, r;
+    mpz_inits(p, r, NULL);
+    unsigned char seed[32] = { 0 };
+    seed[31] = 1;
+
+    double t0 = now_seconds();
+    for (int i = 0; i < reps; ++i) {
+        drbg_urandomb(p, drbg_thread(), bits);
+        mpz_setbit(p, bits - 1);
+        mpz_nextprime(p, p);
+    }
+    double tprob = (now_seconds() - t0) / reps, tmaurer = 0, tst = 0, tcheck = 0;
+    size_t steps = 0;
+    for (int i = 0; i < reps; ++i) {
+        t0 = now_seconds();
+        if (provable_prime_maurer(p, bits, drbg_thread(), &cert) != 0) { fprintf(stderr, "provable: maurer failed\n"); return 1; }
+        tmaurer += now_seconds() - t0;
+        t0 = now_seconds();
+        int ok = prime_cert_verify(&cert);
+        tcheck += now_seconds() - t0;
+        if (!ok || mpz_sizeinbase(p, 2) != bits || mpz_cmp(p, cert.n[cert.len - 1]) || !mpz_probab_prime_p(p, 30)) {
+            fprintf(stderr, "provable: bad maurer prime\n");
+            return 1;
+        }
+        steps += cert.len;
+        t0 = now_seconds();
+        seed[0] = (unsigned char)i;
+        if (provable_prime_shawe_taylor(p, bits, seed, sizeof(seed), &cert, NULL, NULL) != 0) { fprintf(stderr, "provable: shawe-taylor failed\n"); return 1; }
+        tst += now_seconds() - t0;
+        if (!prime_cert_verify(&cert) || mpz_sizeinbase(p, 2) != bits || !mpz_probab_prime_p(p, 30)) {
+            fprintf(stderr, "provable: bad shawe-taylor prime\n");
+            return 1;
+        }
+    }
+    mpz_add_ui(cert.n[cert.len - 1], cert.n[cert.len - 1], 2);
+    if (prime_cert_verify(&cert)) { fprintf(stderr, "provable: altered chain verified\n"); return 1; }
+    printf("%u-bit prime: nextprime %8.2f ms   maurer %8.2f ms   shawe-taylor %8.2f ms   (chain %.1f steps, check %.2f ms)\n",
+           bits, tprob * 1e3, tmaurer / reps * 1e3, tst / reps * 1e3, (double)steps / reps, tcheck / reps * 1e3);
+
+    t0 = now_seconds();
+    gen_safe_prime(p, r, safe_digits);
+    double tsafe = now_seconds() - t0;
+    unsigned sbits = (unsigned)mpz_sizeinbase(p, 2);
+    t0 = now_seconds();
+    if (provable_safe_prime(p, r, sbits, drbg_thread(), &cert) != 0) { fprintf(stderr, "provable: safe prime failed\n"); return 1; }
+    double tproven = now_seconds() - t0;
+    if (!prime_cert_verify(&cert) || mpz_cmp(p, cert.n[cert.len - 1]) || mpz_cmp(r, cert.n[cert.len - 2])
+        || !mpz_probab_prime_p(p, 30) || !mpz_probab_prime_p(r, 30)) {
+        fprintf(stderr, "provable: bad proven safe prime\n");
+        return 1;
+    }
+    printf("%u-bit safe prime: gen_safe_prime %8.3f s   proven %8.3f s\n", sbits, tsafe, tproven);
+    mpz_clears(p, r, NULL);
+    prime_cert_clear(&cert);
+    return 0;
+}
+
+// ECPP on a random prime of the given size with the scheduler's workers trying the
+// discriminants of each step, then the certificate on its own: verified directly, after a
+// round trip through its text form, and with one coordinate of one point altered (must fail)
+static int bench_ecpp(int argc, char **argv) {
+    unsigned digits = argc >= 1 ? (unsigned)strtoul(argv[0], NULL, 10) : 200;
+    size_t workers = argc >= 2 ? strtoul(argv[1], NULL, 10) : 0;
+    ws_sched *s = ws_create(workers);
+    if (!s) { fprintf(stderr, "ecpp: cannot start the worker threads\n"); return 1; }
+    mpz_t n, r;
+    mpz_inits(n, r, NULL);
+    mpz_ui_pow_ui(n, 10, digits - 1);
+    drbg_urandomm(r, drbg_thread(), n);
+    mpz_mul_ui(n, n, 9);
+    mpz_add(n, n, r);
+    mpz_nextprime(n, n);
+
+    ecpp_cert c, back;
+    ecpp_cert_init(&c);
+    ecpp_cert_init(&back);
+    double t0 = now_seconds();
+    int rc = ecpp_prove(&c, n);
+    double tp = now_seconds() - t0;
+    size_t nw = ws_nworkers(s);
+    ws_destroy(s);
+    if (rc != 0) { fprintf(stderr, "ecpp: no chain found for the %u-digit prime\n", digits); return 1; }
+    t0 = now_seconds();
+    int ok = ecpp_cert_verify(&c, n);
+    double tv = now_seconds() - t0;
+    FILE *f = tmpfile();
+    if (!ok || !f) { fprintf(stderr, "ecpp: certificate does not verify\n"); return 1; }
+    ecpp_cert_print(f, &c);
+    rewind(f);
+    if (ecpp_cert_read(f, &back) != 0 || back.len != c.len || !ecpp_cert_verify(&back, n)) {
+        fprintf(stderr, "ecpp: certificate does not survive its text form\n");
+        return 1;
+    }
+    fclose(f);
+    ecpp_step *mid = &back.step[back.len / 2];
+    mpz_add_ui(mid->x, mid->x, 1);
+    if (ecpp_cert_verify(&back, n)) { fprintf(stderr, "ecpp: altered certificate verified\n"); return 1; }
+    mpz_set_str(r, "982451653173961852241334935997", 10); // diffie-hellman's P
+    if (ecpp_prove(&back, r) == 0) { fprintf(stderr, "ecpp: proved diffie-hellman's P, which is 0 mod 3\n"); return 1; }
+
+    printf("%u-digit prime: %zu steps, proof %.2f s (%zu workers), check %.3f s\n", digits, c.len, tp, nw, tv);
+    ecpp_cert_clear(&c);
+    ecpp_cert_clear(&back);
+    mpz_clears(n, r, NULL);
+    return 0;
+}
+
+// smooth parts over the primes below a bound for a batch of numbers, half of them built
+// smooth, by the product/remainder trees against trial division by every prime in the base
+// (on a sample: trial division costs a pass over the whole table per number)
+static int bench_smooth(int argc, char **argv) {
+    unsigned long bound = argc >= 1 ? strtoul(argv[0], NULL, 10) : 1ul << 20;
+    unsigned bits = argc >= 2 ? (unsigned)strtoul(argv[1], NULL, 10) : 512;
+    size_t count = argc >= 3 ? strtoul(argv[2], NULL, 10) : 4096;
+    size_t workers = argc >= 4 ? strtoul(argv[3], NULL, 10) : 0;
+    size_t sample = count < 64 ? count : 64;
+    ws_sched *s = ws_create(workers);
+    if (!s) { fprintf(stderr, "smooth: cannot start the worker threads\n"); return 1; }
+    drbg *rng = drbg_thread();
+    mpz_t *x = malloc(count * sizeof(mpz_t)), *part = malloc(count * sizeof(mpz_t));
+    unsigned char *smooth = malloc(count);
+    mpz_t p, r;
+    mpz_inits(p, r, NULL);
+    for (size_t i = 0; i < count; ++i) {
+        mpz_inits(x[i], part[i], NULL);
+        if (i % 2) { drbg_urandomb(x[i], rng, bits); mpz_setbit(x[i], bits - 1); continue; }
+        mpz_set_ui(x[i], 1);
+        while (mpz_sizeinbase(x[i], 2) < bits) {
+            mpz_set_ui(p, drbg_u64(rng) % bound);
+            mpz_nextprime(p, p);
+            if (mpz_cmp_ui(p, bound) < 0) mpz_mul(x[i], x[i], p);
+        }
+    }
+
+    double t0 = now_seconds();
+    smooth_base fb;
+    if (smooth_base_init(&fb, bound) != 0) { fprintf(stderr, "smooth: no memory for the base\n"); return 1; }
+    double tbase = now_seconds() - t0;
+    t0 = now_seconds();
+    if (smooth_batch(&fb, (const mpz_t *)x, count, part, smooth) != 0) { fprintf(stderr, "smooth: no memory for the trees\n"); return 1; }
+    double tbatch = (now_seconds() - t0) / count;
+    size_t nworkers = ws_nworkers(s);
+    ws_destroy(s);
+
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        found += smooth[i];
+        if (i % 2 == 0 && !smooth[i]) { fprintf(stderr, "smooth: built-smooth number %zu missed\n", i); return 1; }
+    }
+    unsigned char *composite = calloc(bound, 1);
+    for (unsigned long q = 2; q < bound; ++q)
+        if (!composite[q])
+            for (unsigned long m = 2 * q; m < bound; m += q) composite[m] = 1;
+    t0 = now_seconds();
+    for (size_t i = 0; i < sample; ++i) {
+        mpz_set(r, x[i]);
+        mpz_set_ui(p, 1);
+        for (unsigned long q = 2; q < bound; ++q) {
+            if (composite[q]) continue;
+            while (mpz_divisible_ui_p(r, q)) { mpz_divexact_ui(r, r, q); mpz_mul_ui(p, p, q); }
+        }
+        if (mpz_cmp(p, part[i]) != 0) { fprintf(stderr, "smooth: part of number %zu differs\n", i); return 1; }
+    }
+    double ttrial = (now_seconds() - t0) / sample;
+    free(composite);
+
+    printf("%zu primes below %lu (base %.3f s), %zu %u-bit numbers, %zu smooth, %zu workers\n",
+           fb.count, bound, tbase, count, bits, found, nworkers);
+    printf("trial division %10.2f us/number   batch %10.2f us/number   %.1fx\n",
+           ttrial * 1e6, tbatch * 1e6, ttrial / tbatch);
+    smooth_base_clear(&fb);
+    for (size_t i = 0; i < count; ++i) mpz_clears(x[i], part[i], NULL);
+    free(x); free(part); free(smooth);
+    mpz_clears(p, r, NULL);
+    return 0;
+}
+
+// every S_ij = Y_j^X_i (i < j) for N parties through the tiled engine, streamed to /dev/null,
+// against one mont_powm per pair (timed on a sample); a small run is read back and checked
+static int bench_allpairs(int argc, char **argv) {
+    size_t parties = argc >= 1 ? strtoul(argv[0], NULL, 10) : 2000;
+    unsigned bits = argc >= 2 ? (unsigned)strtoul(argv[1], NULL, 10) : 1024;
+    size_t workers = argc >= 3 ? strtoul(argv[2], NULL, 10) : 0;
+    ws_sched *s = ws_create(workers);
+    if (!s) { fprintf(stderr, "allpairs: cannot start the worker threads\n"); return 1; }
+    drbg *rng = drbg_thread();
+    mpz_t m, t;
+    mpz_inits(m, t, NULL);
+    drbg_urandomb(m, rng, bits);
+    mpz_setbit(m, bits - 1);
+    mpz_setbit(m, 0);
+    mont_ctx ctx;
+    mont_init(&ctx, m);
+    mpz_t *X = malloc(parties * sizeof(mpz_t)), *Y = malloc(parties * sizeof(mpz_t));
+    for (size_t i = 0; i < parties; ++i) {
+        mpz_inits(X[i], Y[i], NULL);
+        drbg_urandomb(X[i], rng, bits);
+        drbg_urandomm(Y[i], rng, m);
+    }
+
+    // read back a small matrix in binary and compare every entry with mont_powm
+    size_t small = parties < 40 ? parties : 40;
+    allpairs ap;
+    FILE *f = tmpfile();
+    bigio_writer out;
+    if (!f || allpairs_init(&ap, (const mpz_t *)X, (const mpz_t *)Y, small, 7, &ctx) != 0) {
+        fprintf(stderr, "allpairs: no memory\n");
+        return 1;
+    }
+    bigio_writer_init(&out, f, BIGIO_BIN, 0);
+    if (allpairs_write(&ap, &out) != 0) { fprintf(stderr, "allpairs: write failed\n"); return 1; }
+    bigio_flush(&out);
+    rewind(f);
+    for (size_t i = 0; i < small; ++i)
+        for (size_t j = i + 1; j < small; ++j) {
+            mont_powm(m, Y[j], X[i], &ctx);
+            if (bigio_read_bin(t, f) != 1 || mpz_cmp(t, m) != 0) {
+                fprintf(stderr, "allpairs: S_%zu,%zu differs\n", i, j);
+                return 1;
+            }
+        }
+    bigio_writer_close(&out);
+    fclose(f);
+    allpairs_clear(&ap);
+
+    size_t pairs = parties * (parties - 1) / 2, sample = 200;
+    double t0 = now_seconds();
+    for (size_t k = 0; k < sample; ++k) mont_powm(t, Y[(k + 1) % parties], X[k % parties], &ctx);
+    double naive = (now_seconds() - t0) / sample;
+
+    t0 = now_seconds();
+    if (allpairs_init(&ap, (const mpz_t *)X, (const mpz_t *)Y, parties, 0, &ctx) != 0) {
+        fprintf(stderr, "allpairs: no memory\n");
+        return 1;
+    }
+    double tinit = now_seconds() - t0;
+    f = fopen("/dev/null", "wb");
+    bigio_writer_init(&out, f, BIGIO_BIN, 0);
+    t0 = now_seconds();
+    int rc = allpairs_write(&ap, &out);
+    double tall = now_seconds() - t0;
+    bigio_writer_close(&out);
+    fclose(f);
+    if (rc != 0) { fprintf(stderr, "allpairs: write failed\n"); return 1; }
+
+    printf("%zu parties, %u-bit modulus: %zu pairs, window %d, %zu x %zu tiles, %zu workers\n",
+           parties, bits, pairs, ap.w, ap.tile, ap.tile, ws_nworkers(s));
+    printf("mont_powm per pair %8.2f us   tiled %8.2f us/pair (tables %.3f s, total %.2f s)   %.2fx\n",
+           naive * 1e6, tall / pairs * 1e6, tinit, tinit + tall, naive * pairs / (tinit + tall));
+    allpairs_clear(&ap);
+    ws_destroy(s);
+    mont_clear(&ctx);
+    for (size_t i = 0; i < parties; ++i) mpz_clears(X[i], Y[i], NULL);
+    free(X); free(Y);
+    mpz_clears(m, t, NULL);
+    return 0;
+}
+
+static const struct bench benches[] = {
+    { "multiexp", "[bits]", bench_multiexp },
+    { "mr64", "[count]", bench_mr64 },
+    { "montfixed", "", bench_montfixed },
+    { "alloc", "[tests]", bench_alloc },
+    { "soa", "[count]", bench_soa },
+    { "hugepage", "[MB]", bench_hugepage },
+    { "async", "[requests]", bench_async },
+    { "io", "[bits] [count]", bench_io },
+    { "ring", "[items] [threads]", bench_ring },
+    { "pipeline", "[digits] [threads] [seed]", bench_pipeline },
+    { "legendre", "[count]", bench_legendre },
+    { "special", "", bench_special },
+    { "friendly", "", bench_friendly },
+    { "ifma", "[reps]", bench_ifma },
+    { "fixedbase", "[bits] [workers]", bench_fixedbase },
+    { "drbg", "[MB]", bench_drbg },
+    { "provable", "[bits] [safe digits]", bench_provable },
+    { "ecpp", "[digits] [workers]", bench_ecpp },
+    { "smooth", "[bound] [bits] [count] [workers]", bench_smooth },
+    { "allpairs", "[parties] [bits] [workers]", bench_allpairs },
+};
+
+int main(int argc, char **argv) {
+    size_t nbench = sizeof(benches) / sizeof(benches[0]);
+    if (argc >= 2)
+        for (size_t i = 0; i < nbench; ++i)
+            if (strcmp(argv[1], benches[i].name) == 0) return benches[i].run(argc - 2, argv + 2);
+
+    fprintf(stderr, "usage: %s <benchmark> [args]\n", argv[0]);
+    for (size_t i = 0; i < nbench; ++i) fprintf(stderr, "  %s %s\n", benches[i].name, benches[i].usage);
+    return 1;
+}
@@ -0,0 +1,133 @@
+// bigint_io.c
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bigint_io.h"
+
+int bigio_parse_format(const char *name) {
+    if (strcmp(name, "dec") == 0) return BIGIO_DEC;
+    if (strcmp(name, "hex") == 0) return BIGIO_HEX;
+    if (strcmp(name, "bin") == 0) return BIGIO_BIN;
+    return -1;
+}
+
+// ---------------- writer ----------------
+
+int bigio_writer_init(bigio_writer *w, FILE *f, bigio_format fmt, size_t cap) {
+    w->f = f;
+    w->cap = cap ? cap : 1 << 20;
+    w->len = 0;
+    w->fmt = fmt;
+    w->error = 0;
+    w->buf = malloc(w->cap);
+    if (!w->buf) return -1;
+    return 0;
+}
+
+void bigio_flush(bigio_writer *w) {
+    if (w->len && fwrite(w->buf, 1, w->len, w->f) != w->len) w->error = 1;
+    w->len = 0;
+}
+
+int bigio_writer_close(bigio_writer *w) {
+    bigio_flush(w);
+    if (fflush(w->f) != 0) w->error = 1;
+    free(w->buf);
+    return w->error ? -1 : 0;
+}
+
+// room for n more bytes (a value larger than the buffer gets a buffer of its own size)
+static char *reserve(bigio_writer *w, size_t n) {
+    if (w->len + n > w->cap) bigio_flush(w);
+    if (n > w->cap) {
+        char *b = realloc(w->buf, n);
+        if (!b) { w->error = 1; return NULL; }
+        w->buf = b;
+        w->cap = n;
+    }
+    return w->buf + w->len;
+}
+
+void bigio_puts(bigio_writer *w, const char *s) {
+    size_t n = strlen(s);
+    char *p = reserve(w, n);
+    if (!p) return;
+    memcpy(p, s, n);
+    w->len += n;
+}
+
+void bigio_printf(bigio_writer *w, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0) { w->error = 1; return; }
+    char *p = reserve(w, (size_t)n + 1);
+    if (!p) return;
+    va_start(ap, fmt);
+    vsnprintf(p, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    w->len += (size_t)n;
+}
+
+void bigio_put_mpz(bigio_writer *w, const mpz_t z) {
+    if (w->fmt == BIGIO_BIN) {
+        size_t n = mpz_size(z);
+        unsigned char *p = (unsigned char *)reserve(w, 4 + 8 * n);
+        if (!p) return;
+        for (int i = 0; i < 4; ++i) p[i] = (unsigned char)(n >> (24 - 8 * i));
+        p += 4;
+        const mp_limb_t *l = mpz_limbs_read(z);
+        for (size_t j = n; j-- > 0;)
+            for (int i = 0; i < 8; ++i) *p++ = (unsigned char)(l[j] >> (56 - 8 * i));
+        w->len += 4 + 8 * n;
+        return;
+    }
+    int base = w->fmt == BIGIO_HEX ? 16 : 10;
+    char *p = reserve(w, mpz_sizeinbase(z, base) + 2);
+    if (!p) return;
+    w->len += strlen(mpz_get_str(p, base, z));
+}
+
+// ---------------- input ----------------
+
+int bigio_set_str(mpz_t z, const char *s, bigio_format fmt) {
+    size_t len = strcspn(s, " \t\r\n");
+    if (len == 0 || fmt == BIGIO_BIN) return -1;
+    if (s[len] == '\0') return mpz_set_str(z, s, fmt == BIGIO_HEX ? 16 : 10);
+    char small[256], *tmp = len < sizeof(small) ? small : malloc(len + 1);
+    if (!tmp) return -1;
+    memcpy(tmp, s, len);
+    tmp[len] = '\0';
+    int rc = mpz_set_str(z, tmp, fmt == BIGIO_HEX ? 16 : 10);
+    if (tmp != small) free(tmp);
+    return rc;
+}
+
+// limb stored as 8 big-endian bytes -> value
+static mp_limb_t from_be(mp_limb_t raw) {
+    const unsigned char *b = (const unsigned char *)&raw;
+    mp_limb_t v = 0;
+    for (int i = 0; i < 8; ++i) v = v << 8 | b[i];
+    return v;
+}
+
+int bigio_read_bin(mpz_t z, FILE *f) {
+    unsigned char hdr[4];
+    size_t got = fread(hdr, 1, 4, f);
+    if (got == 0) return 0;
+    if (got != 4) return -1;
+    size_t n = (size_t)hdr[0] << 24 | (size_t)hdr[1] << 16 | (size_t)hdr[2] << 8 | hdr[3];
+    // read the whole record into the limbs, then reverse it in place into little-endian limbs
+    mp_limb_t *l = mpz_limbs_write(z, n ? n : 1);
+    if (fread(l, 8, n, f) != n) { mpz_limbs_finish(z, 0); return -1; }
+    for (size_t i = 0; i < n / 2; ++i) {
+        mp_limb_t t = from_be(l[i]);
+        l[i] = from_be(l[n - 1 - i]);
+        l[n - 1 - i] = t;
+    }
+    if (n & 1) l[n / 2] = from_be(l[n / 2]);
+    mpz_limbs_finish(z, n);
+    return 1;
+}
@@ -0,0 +1,49 @@
+// bigint_io.h
+// Big-integer input and output in decimal, hex or binary, through one large output buffer.
+//
+// Binary records are a 4-byte big-endian limb count followed by the limbs, most significant
+// limb first, each as 8 big-endian bytes (zero is a count of 0). Hex is "0x"-less lower case.
+// Decimal is GMP's own conversion (divide-and-conquer above a few thousand digits, so already
+// subquadratic) written straight into the output buffer: no per-value string allocation and
+// no stdio formatting. Hex and binary are linear and much cheaper again for bulk data.
+
+#ifndef BIGINT_IO_H
+#define BIGINT_IO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <gmp.h>
+
+typedef enum {
+    BIGIO_DEC,
+    BIGIO_HEX,
+    BIGIO_BIN,
+} bigio_format;
+
+// "dec", "hex" or "bin"; -1 if unknown
+int bigio_parse_format(const char *name);
+
+typedef struct {
+    FILE *f;
+    char *buf;
+    size_t len, cap;
+    bigio_format fmt;
+    int error;
+} bigio_writer;
+
+// cap = buffer size (0 for 1 MB); values are written in fmt
+int bigio_writer_init(bigio_writer *w, FILE *f, bigio_format fmt, size_t cap);
+// flushes; returns -1 if any write failed
+int bigio_writer_close(bigio_writer *w);
+void bigio_flush(bigio_writer *w);
+
+void bigio_puts(bigio_writer *w, const char *s);                 // text only
+void bigio_printf(bigio_writer *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void bigio_put_mpz(bigio_writer *w, const mpz_t z);              // one value in w->fmt, z >= 0
+
+// one value from text s (decimal, or hex for BIGIO_HEX; whitespace ends it); 0 on success
+int bigio_set_str(mpz_t z, const char *s, bigio_format fmt);
+// one binary record from f; 1 on success, 0 at end of file, -1 on a short record
+int bigio_read_bin(mpz_t z, FILE *f);
+
+#endif
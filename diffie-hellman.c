@@ -1,54 +1,246 @@
+// Build: make diffie-hellman   (see Makefile)
+// Run  : ./diffie-hellman [--format F] [--latency T] [--prove CERT] [--allpairs N OUT] (single P)
+//        ./diffie-hellman [--format F] --batch primes.txt [T] (one prime per line, "-" for stdin)
+//        options in any order; --batch combines with --format only
+//        F = dec (default), hex, or bin (big-endian limb records in and out, see bigint_io.h)
+//        --latency T splits each public-key exponentiation over T workers (0: one per CPU)
+//        --prove CERT proves P prime by ECPP first and writes the certificate to CERT (ecpp.h)
+//        --allpairs N OUT also draws N parties and writes every pairwise secret to OUT (allpairs.h)
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <gmp.h>
+#include "allpairs.h"
+#include "bigint_io.h"
+#include "drbg.h"
+#include "ecpp.h"
+#include "fixedbase.h"
+#include "mont.h"
+#include "primroot.h"
+#include "smooth.h"
+#include "worksteal.h"
+
+// primes handed to the worker pool at once in batch mode (results are flushed per chunk)
+#define BATCH_CHUNK 4096
+
+// ---------------- batch mode ----------------
+
+struct batch_job {
+    mpz_t P;             // prime as read (reused from chunk to chunk)
+    char *bad;           // the input line if it did not parse, else NULL
+    unsigned long alpha; // minimal generator > threshold, 0 if P is not prime
+};
+
+struct batch_chunk {
+    struct batch_job *jobs;
+    mpz_t *Pm1, *smooth; // P-1 of every job (1 for unusable lines) and its smooth part
+    unsigned long threshold;
+};
 
-// trial division to factor n into distinct prime factors (sufficient for primitive-root test)
-void factor_distinct(mpz_t n, mpz_t factors[], size_t *k) {
-    mpz_t d, tmp;
-    mpz_inits(d, tmp, NULL);
-    *k = 0;
+// one prime, on whichever worker the scheduler handed it to; the smooth part of P-1 was
+// found for the whole chunk at once, so only the rest of P-1 is left to split
+static void run_job(size_t i, void *p) {
+    struct batch_chunk *chunk = p;
+    struct batch_job *job = &chunk->jobs[i];
+    mpz_srcptr P = job->P;
+    mpz_t factors[PRIMROOT_MAX_FACTORS];
+    size_t k = 0;
+    job->alpha = 0;
 
-    // factor out 2
-    if (mpz_divisible_ui_p(n, 2)) {
-        mpz_init_set_ui(factors[(*k)++], 2);
-        while (mpz_divisible_ui_p(n, 2)) mpz_divexact_ui(n, n, 2);
+    if (!job->bad && mpz_cmp_ui(P, 2) > 0 && mpz_probab_prime_p(P, 30)) {
+        factor_distinct_smooth(chunk->Pm1[i], chunk->smooth[i], factors, &k);
+        primroot_ctx gen;
+        primroot_init(&gen, P, factors, k);
+        unsigned long cand = chunk->threshold + 1;
+        while (!primroot_test(&gen, cand)) ++cand;
+        job->alpha = cand;
+        primroot_clear(&gen);
+        for (size_t f = 0; f < k; ++f) mpz_clear(factors[f]);
     }
-    // odd trial division
-    for (unsigned long i = 3; mpz_cmp_ui(n, 1) > 0; i += 2) {
-        if (mpz_divisible_ui_p(n, i)) {
-            mpz_init_set_ui(factors[(*k)++], i);
-            while (mpz_divisible_ui_p(n, i)) mpz_divexact_ui(n, n, i);
-        }
-        // stop when i*i > n
-        mpz_set_ui(tmp, i);
-        mpz_mul(tmp, tmp, tmp);
-        if (mpz_cmp(tmp, n) > 0) break;
+}
+
+// next prime from the input into job; 0 at end of input
+static int read_job(struct batch_job *job, FILE *in, bigio_format fmt, char **line, size_t *cap) {
+    job->bad = NULL;
+    if (fmt == BIGIO_BIN) {
+        int rc = bigio_read_bin(job->P, in);
+        if (rc < 0) fprintf(stderr, "truncated binary record; stopping\n");
+        return rc > 0;
     }
-    if (mpz_cmp_ui(n, 1) > 0) { // leftover prime
-        mpz_init_set(factors[(*k)++], n);
+    for (;;) {
+        if (getline(line, cap, in) < 0) return 0;
+        (*line)[strcspn(*line, " \t\r\n")] = '\0';
+        if ((*line)[0] == '\0') continue;
+        if (bigio_set_str(job->P, *line, fmt) != 0) job->bad = strdup(*line);
+        return 1;
     }
-    mpz_clears(d, tmp, NULL);
 }
 
-// return 1 if g is a primitive root mod p (p prime) given factors of p-1
-int is_generator(const mpz_t g, const mpz_t p, mpz_t factors[], size_t k) {
-    mpz_t p_minus_1, exp, t;
-    mpz_inits(p_minus_1, exp, t, NULL);
-    mpz_sub_ui(p_minus_1, p, 1);
-
-    for (size_t i = 0; i < k; ++i) {
-        mpz_divexact(exp, p_minus_1, factors[i]);
-        mpz_powm(t, g, exp, p);
-        if (mpz_cmp_ui(t, 1) == 0) { // not a generator
-            mpz_clears(p_minus_1, exp, t, NULL);
-            return 0;
+// Stream primes from path (one per line, or binary records), write "P alpha" for each in
+// input order through one output buffer, and report throughput on stderr.
+int run_batch(const char *path, unsigned long threshold, size_t nworkers, bigio_format fmt) {
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, fmt == BIGIO_BIN ? "rb" : "r");
+    if (!in) { perror(path); return 1; }
+    int rc = 1, have_base = 0;
+    ws_sched *sched = ws_create(nworkers);
+    struct batch_job *jobs = calloc(BATCH_CHUNK, sizeof(*jobs));
+    mpz_t *Pm1 = malloc(BATCH_CHUNK * sizeof(mpz_t)), *smooth = malloc(BATCH_CHUNK * sizeof(mpz_t));
+    int have_mpz = jobs && Pm1 && smooth;
+    smooth_base fb;
+    bigio_writer out;
+    bigio_writer_init(&out, stdout, fmt, 0);
+    mpz_t alpha; mpz_init(alpha);
+    char *line = NULL; size_t cap = 0;
+    size_t total = 0, n = 0;
+    if (have_mpz)
+        for (size_t i = 0; i < BATCH_CHUNK; ++i) mpz_inits(jobs[i].P, Pm1[i], smooth[i], NULL);
+    if (!sched) { fprintf(stderr, "cannot start the worker threads\n"); goto done; }
+    if (!have_mpz || smooth_base_init(&fb, PRIMROOT_TRIAL_LIMIT) != 0) goto oom;
+    have_base = 1;
+    nworkers = ws_nworkers(sched);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (int eof = 0; !eof;) {
+        if (read_job(&jobs[n], in, fmt, &line, &cap)) ++n;
+        else eof = 1;
+        if (n == BATCH_CHUNK || (eof && n > 0)) {
+            for (size_t i = 0; i < n; ++i) {
+                if (jobs[i].bad || mpz_cmp_ui(jobs[i].P, 2) <= 0) mpz_set_ui(Pm1[i], 1);
+                else mpz_sub_ui(Pm1[i], jobs[i].P, 1);
+            }
+            if (smooth_batch(&fb, (const mpz_t *)Pm1, n, smooth, NULL) != 0) goto oom;
+            struct batch_chunk chunk = { jobs, Pm1, smooth, threshold };
+            ws_parallel_for(0, n, 1, run_job, &chunk);
+            for (size_t i = 0; i < n; ++i) {
+                if (fmt == BIGIO_BIN) { // two records: P, alpha (0 if not prime)
+                    mpz_set_ui(alpha, jobs[i].alpha);
+                    bigio_put_mpz(&out, jobs[i].P);
+                    bigio_put_mpz(&out, alpha);
+                    continue;
+                }
+                if (jobs[i].bad) bigio_puts(&out, jobs[i].bad);
+                else bigio_put_mpz(&out, jobs[i].P);
+                if (jobs[i].alpha) bigio_printf(&out, fmt == BIGIO_HEX ? " %lx\n" : " %lu\n", jobs[i].alpha);
+                else bigio_puts(&out, " not-prime\n");
+                free(jobs[i].bad);
+            }
+            bigio_flush(&out);
+            total += n; n = 0;
         }
     }
-    mpz_clears(p_minus_1, exp, t, NULL);
-    return 1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "Batch: %zu primes in %.3f s (%.1f primes/s, %zu threads)\n",
+            total, seconds, seconds > 0 ? total / seconds : 0.0, nworkers);
+    rc = 0;
+    goto done;
+
+oom:
+    fprintf(stderr, "out of memory\n");
+done:
+    bigio_writer_close(&out);
+    for (size_t i = 0; i < n; ++i) free(jobs[i].bad); // a chunk read but not written
+    if (have_mpz)
+        for (size_t i = 0; i < BATCH_CHUNK; ++i) mpz_clears(jobs[i].P, Pm1[i], smooth[i], NULL);
+    if (have_base) smooth_base_clear(&fb);
+    mpz_clear(alpha);
+    free(line); free(jobs); free(Pm1); free(smooth);
+    if (sched) ws_destroy(sched);
+    if (in != stdin) fclose(in);
+    return rc;
 }
 
-int main(void) {
+// ---------------- all-pairs mode ----------------
+
+// N parties with random private keys in [2, P-2] and Y_i = alpha^X_i; every S_ij with i < j
+// goes to path in fmt, one row per line (allpairs_write), and the timing to stderr
+static int run_allpairs(const char *path, size_t parties, const mpz_t P, const mpz_t alpha,
+                        const mont_ctx *ctx, bigio_format fmt) {
+    FILE *f = fopen(path, fmt == BIGIO_BIN ? "wb" : "w");
+    if (!f) { perror(path); return 1; }
+    ws_sched *own = ws_self() ? NULL : ws_create(0); // --latency's scheduler if there is one
+    if (!ws_self()) { fprintf(stderr, "cannot start the worker threads\n"); fclose(f); return 1; }
+    mpz_t *X = malloc(parties * sizeof(mpz_t)), *Y = malloc(parties * sizeof(mpz_t));
+    mpz_t range, s01, s10;
+    mpz_inits(range, s01, s10, NULL);
+    mpz_sub_ui(range, P, 3);
+    for (size_t i = 0; i < parties; ++i) {
+        mpz_inits(X[i], Y[i], NULL);
+        drbg_urandomm(X[i], drbg_thread(), range);
+        mpz_add_ui(X[i], X[i], 2);
+        mont_powm(Y[i], alpha, X[i], ctx);
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    allpairs ap;
+    int rc = allpairs_init(&ap, (const mpz_t *)X, (const mpz_t *)Y, parties, 0, ctx);
+    if (rc != 0) {
+        fprintf(stderr, "all pairs: out of memory\n");
+    } else {
+        bigio_writer out;
+        bigio_writer_init(&out, f, fmt, 0);
+        rc = allpairs_write(&ap, &out);
+        if (bigio_writer_close(&out) != 0) rc = -1;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        size_t pairs = parties * (parties - 1) / 2;
+        allpairs_pair(s01, &ap, 0, 1);
+        allpairs_pair(s10, &ap, 1, 0);
+        if (rc != 0) fprintf(stderr, "%s: cannot write the secrets\n", path);
+        else fprintf(stderr, "All pairs: %zu parties, %zu secrets in %.3f s (%.1f pairs/s, %zu threads); "
+                             "S_01 = S_10? %s\n", parties, pairs, seconds, seconds > 0 ? pairs / seconds : 0.0,
+                     ws_nworkers(ws_self()->owner), mpz_cmp(s01, s10) == 0 ? "YES" : "NO");
+        allpairs_clear(&ap);
+    }
+
+    if (fclose(f) != 0) rc = -1;
+    for (size_t i = 0; i < parties; ++i) mpz_clears(X[i], Y[i], NULL);
+    free(X); free(Y);
+    mpz_clears(range, s01, s10, NULL);
+    if (own) ws_destroy(own);
+    return rc == 0 ? 0 : 1;
+}
+
+// digits only: the optional worker count after --batch primes.txt
+static int is_count(const char *s) {
+    return s[0] != '\0' && s[strspn(s, "0123456789")] == '\0';
+}
+
+int main(int argc, char **argv) {
+    bigio_format fmt = BIGIO_DEC;
+    const char *latency = NULL, *cert_path = NULL, *allpairs_path = NULL, *batch_path = NULL;
+    size_t parties = 0, batch_workers = 0; // 0: one per CPU
+    for (int i = 1; i < argc; ++i) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "--format") == 0 && i + 1 < argc) {
+            int f = bigio_parse_format(argv[++i]);
+            if (f < 0) { fprintf(stderr, "unknown format %s (dec, hex, bin)\n", argv[i]); return 1; }
+            fmt = (bigio_format)f;
+        } else if (strcmp(opt, "--latency") == 0 && i + 1 < argc) {
+            latency = argv[++i];
+        } else if (strcmp(opt, "--prove") == 0 && i + 1 < argc) {
+            cert_path = argv[++i];
+        } else if (strcmp(opt, "--allpairs") == 0 && i + 2 < argc) {
+            parties = strtoul(argv[++i], NULL, 10);
+            allpairs_path = argv[++i];
+            if (parties < 2) { fprintf(stderr, "--allpairs needs at least 2 parties\n"); return 1; }
+        } else if (strcmp(opt, "--batch") == 0 && i + 1 < argc) {
+            batch_path = argv[++i];
+            if (i + 1 < argc && is_count(argv[i + 1])) batch_workers = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "unknown option or missing argument: %s\n", opt);
+            return 1;
+        }
+    }
+    if (batch_path && (latency || cert_path || allpairs_path)) {
+        fprintf(stderr, "--batch takes only --format (its worker count follows the file)\n");
+        return 1;
+    }
+
     // i) Choose a ≥30-digit prime q = P
     mpz_t P; mpz_init(P);
     // Example 30-digit prime (replace with your chosen prime if needed)
@@ -57,51 +249,118 @@ int main(void) {
     // ii) Find primitive root α immediately greater than last 2 digits of your UMBC ID.
     // Put your two-digit threshold here:
     unsigned long threshold = 15; // e.g., if your last two digits are 15
+
+    if (batch_path) {
+        mpz_clear(P);
+        return run_batch(batch_path, threshold, batch_workers, fmt);
+    }
+    ws_sched *sched = NULL; // latency mode: YA and YB are split over its workers
+    if (latency) {
+        sched = ws_create(strtoul(latency, NULL, 10));
+        if (!sched) { fprintf(stderr, "cannot start the worker threads\n"); mpz_clear(P); return 1; }
+    }
+    if (cert_path) { // ECPP certificate for P, the candidate curves of each step spread over the workers
+        ws_sched *ps = sched ? sched : ws_create(0);
+        ecpp_cert cert;
+        ecpp_cert_init(&cert);
+        int proven = ps && ecpp_prove(&cert, P) == 0 && ecpp_cert_verify(&cert, P);
+        FILE *f = proven ? fopen(cert_path, "w") : NULL;
+        if (f) { ecpp_cert_print(f, &cert); fclose(f); }
+        if (ps && ps != sched) ws_destroy(ps);
+        if (!proven || !f) {
+            if (proven) perror(cert_path);
+            else fprintf(stderr, "P is %s; no certificate written\n",
+                         mpz_probab_prime_p(P, 25) ? "probably prime but no ECPP chain was found" : "composite");
+            ecpp_cert_clear(&cert);
+            mpz_clear(P);
+            if (sched) ws_destroy(sched);
+            return 1;
+        }
+        fprintf(stderr, "P proven prime: %zu-step ECPP certificate in %s\n", cert.len, cert_path);
+        ecpp_cert_clear(&cert);
+    }
     mpz_t Pm1; mpz_init(Pm1); mpz_sub_ui(Pm1, P, 1);
 
     // factor P-1
     mpz_t tmp; mpz_init_set(tmp, Pm1);
-    mpz_t factors[256]; size_t k = 0;
+    mpz_t factors[PRIMROOT_MAX_FACTORS]; size_t k = 0;
     factor_distinct(tmp, factors, &k);
 
-    // search for generator α >= threshold+1
+    // search for generator α >= threshold+1 (exponents (P-1)/q and the engine for P set up once)
+    primroot_ctx gen; primroot_init(&gen, P, factors, k);
     mpz_t alpha; mpz_init(alpha);
     clock_t t0 = clock();
-    for (unsigned long cand = threshold + 1;; ++cand) {
-        mpz_set_ui(alpha, cand);
-        if (is_generator(alpha, P, factors, k)) break;
-    }
+    unsigned long cand = threshold + 1;
+    while (!primroot_test(&gen, cand)) ++cand;
+    mpz_set_ui(alpha, cand);
     clock_t t1 = clock();
     double seconds = (double)(t1 - t0) / CLOCKS_PER_SEC;
 
+    // ii-b) Same search in the cyclic groups mod P^k and 2P^k, reusing the factors of P-1;
+    // those groups are only cyclic for a prime P, so a composite P skips it
+    unsigned long k_pow = 2; // any k >= 2 gives the same answer (lifting lemma)
+    int p_prime = mpz_probab_prime_p(P, 25) != 0;
+    mpz_t alpha_pk, alpha_2pk; mpz_inits(alpha_pk, alpha_2pk, NULL);
+    if (p_prime) {
+        for (cand = threshold + 1; !primroot_test_prime_power(&gen, cand, k_pow, 0); ++cand) {}
+        mpz_set_ui(alpha_pk, cand);
+        for (cand = threshold + 1; !primroot_test_prime_power(&gen, cand, k_pow, 1); ++cand) {}
+        mpz_set_ui(alpha_2pk, cand);
+    }
+
     // iii) Choose private keys XA, XB (> last 5 digits of your UMBC ID)
     mpz_t XA, XB; mpz_inits(XA, XB, NULL);
     mpz_set_ui(XA, 51015); // replace with your values
     mpz_set_ui(XB, 51016);
 
     // iv) Compute YA = α^XA mod P, YB = α^XB mod P
+    mont_ctx ctx; mont_init(&ctx, P); // fixed-modulus engine, set up once for P
     mpz_t YA, YB; mpz_inits(YA, YB, NULL);
-    mpz_powm(YA, alpha, XA, P);
-    mpz_powm(YB, alpha, XB, P);
+    fixed_base fb; // alpha is the fixed base of both: its split powers serve both keys
+    if (sched && fixed_base_init(&fb, alpha, mpz_sizeinbase(P, 2), 0, &ctx) == 0) {
+        fixed_base_powm(YA, &fb, XA);
+        fixed_base_powm(YB, &fb, XB);
+        fixed_base_clear(&fb);
+    } else { // no --latency, or no memory for the split powers
+        mont_powm(YA, alpha, XA, &ctx);
+        mont_powm(YB, alpha, XB, &ctx);
+    }
 
     // v) Shared key SAB
     mpz_t SA, SB; mpz_inits(SA, SB, NULL);
-    mpz_powm(SA, YB, XA, P);
-    mpz_powm(SB, YA, XB, P);
-
-    gmp_printf("P (prime)  = %Zd\n", P);
-    gmp_printf("alpha (g)  = %Zd\n", alpha);
-    printf("Primitive root search time: %.6f s\n", seconds);
-    gmp_printf("XA         = %Zd\n", XA);
-    gmp_printf("XB         = %Zd\n", XB);
-    gmp_printf("YA         = %Zd\n", YA);
-    gmp_printf("YB         = %Zd\n", YB);
-    gmp_printf("S_A        = %Zd\n", SA);
-    gmp_printf("S_B        = %Zd\n", SB);
-    printf("Keys match? %s\n", mpz_cmp(SA, SB) == 0 ? "YES" : "NO");
+    mont_powm(SA, YB, XA, &ctx);
+    mont_powm(SB, YA, XB, &ctx);
+
+    // output: labelled lines in dec/hex, or just the records in order in bin (without the
+    // two P^k generators when P is composite)
+    bigio_writer out;
+    bigio_writer_init(&out, stdout, fmt, 0);
+    const char *label[] = { "P (prime)  = ", "alpha (g)  = ", NULL, NULL, "XA         = ",
+                            "XB         = ", "YA         = ", "YB         = ", "S_A        = ",
+                            "S_B        = " };
+    mpz_srcptr value[] = { P, alpha, alpha_pk, alpha_2pk, XA, XB, YA, YB, SA, SB };
+    for (size_t i = 0; i < sizeof(value) / sizeof(value[0]); ++i) {
+        if (i == 2 && fmt != BIGIO_BIN) bigio_printf(&out, "Primitive root search time: %.6f s\n", seconds);
+        if ((i == 2 || i == 3) && !p_prime) continue;
+        if (fmt != BIGIO_BIN) {
+            if (i == 2) bigio_printf(&out, "alpha mod P^%lu   = ", k_pow);
+            else if (i == 3) bigio_printf(&out, "alpha mod 2P^%lu  = ", k_pow);
+            else bigio_puts(&out, label[i]);
+        }
+        bigio_put_mpz(&out, value[i]);
+        if (fmt != BIGIO_BIN) bigio_puts(&out, "\n");
+    }
+    if (fmt != BIGIO_BIN) bigio_printf(&out, "Keys match? %s\n", mpz_cmp(SA, SB) == 0 ? "YES" : "NO");
+    bigio_writer_close(&out);
+
+    // N parties instead of two: every pairwise secret in the same group
+    int rc = allpairs_path ? run_allpairs(allpairs_path, parties, P, alpha, &ctx, fmt) : 0;
 
     // cleanup
+    mont_clear(&ctx);
+    if (sched) ws_destroy(sched);
+    primroot_clear(&gen);
     for (size_t i = 0; i < k; ++i) mpz_clear(factors[i]);
-    mpz_clears(P, Pm1, tmp, alpha, XA, XB, YA, YB, SA, SB, NULL);
-    return 0;
+    mpz_clears(P, Pm1, tmp, alpha, alpha_pk, alpha_2pk, XA, XB, YA, YB, SA, SB, NULL);
+    return rc;
 }
@@ -0,0 +1,173 @@
+// drbg.c
+//
+// The refill runs the ChaCha20 double rounds on 16-lane vectors of 32-bit words (GCC vector
+// extensions): lane j holds block j's state, so every instruction advances all sixteen
+// blocks. target_clones compiles it for AVX-512, AVX2 and plain SSE2 and picks one at load
+// time; the words are transposed into byte order once at the end.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include "drbg.h"
+
+typedef uint32_t u32x16 __attribute__((vector_size(64)));
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define QR(a, b, c, d)                                                                    \
+    do {                                                                                  \
+        a += b; d ^= a; d = ROTL(d, 16);                                                  \
+        c += d; b ^= c; b = ROTL(b, 12);                                                  \
+        a += b; d ^= a; d = ROTL(d, 8);                                                   \
+        c += d; b ^= c; b = ROTL(b, 7);                                                   \
+    } while (0)
+
+// DRBG_BLOCKS ChaCha20 blocks for counters 0 .. DRBG_BLOCKS-1 of (key, stream) into out
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static void chacha_blocks(unsigned char *out, const uint32_t key[8], uint64_t stream) {
+    static const uint32_t sigma[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+    u32x16 x[16], s[16];
+    for (int i = 0; i < 4; ++i) s[i] = (u32x16){ 0 } + sigma[i];
+    for (int i = 0; i < 8; ++i) s[4 + i] = (u32x16){ 0 } + key[i];
+    s[12] = (u32x16){ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+    s[13] = (u32x16){ 0 };
+    s[14] = (u32x16){ 0 } + (uint32_t)stream;
+    s[15] = (u32x16){ 0 } + (uint32_t)(stream >> 32);
+    for (int i = 0; i < 16; ++i) x[i] = s[i];
+
+    for (int r = 0; r < 10; ++r) {
+        QR(x[0], x[4], x[8], x[12]);
+        QR(x[1], x[5], x[9], x[13]);
+        QR(x[2], x[6], x[10], x[14]);
+        QR(x[3], x[7], x[11], x[15]);
+        QR(x[0], x[5], x[10], x[15]);
+        QR(x[1], x[6], x[11], x[12]);
+        QR(x[2], x[7], x[8], x[13]);
+        QR(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) x[i] += s[i];
+
+    // word i of block j is lane j of x[i]; little-endian bytes as in RFC 8439
+    uint32_t *w = (uint32_t *)out;
+    for (int j = 0; j < DRBG_BLOCKS; ++j)
+        for (int i = 0; i < 16; ++i) w[16 * j + i] = x[i][j];
+}
+
+// new buffer; its first 32 bytes replace the key
+static void refill(drbg *d) {
+    chacha_blocks(d->buf, d->key, d->stream);
+    memcpy(d->key, d->buf, sizeof(d->key));
+    memset(d->buf, 0, sizeof(d->key));
+    d->pos = sizeof(d->key);
+}
+
+// n bytes of entropy from the kernel: getrandom, or /dev/urandom where it is missing
+static int entropy(void *out, size_t n) {
+    unsigned char *p = out;
+    while (n) {
+        ssize_t got = getrandom(p, n, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) break;
+        p += got; n -= (size_t)got;
+    }
+    if (n == 0) return 0;
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    while (n) {
+        ssize_t got = read(fd, p, n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        p += got; n -= (size_t)got;
+    }
+    close(fd);
+    return n ? -1 : 0;
+}
+
+int drbg_init(drbg *d) {
+    if (entropy(d->key, sizeof(d->key)) != 0) return -1;
+    d->stream = 0;
+    refill(d);
+    return 0;
+}
+
+void drbg_seed_ui(drbg *d, unsigned long seed) {
+    memset(d->key, 0, sizeof(d->key));
+    d->key[0] = (uint32_t)seed;
+    d->key[1] = (uint32_t)((uint64_t)seed >> 32);
+    d->stream = 0;
+    refill(d);
+}
+
+void drbg_fork(drbg *child, drbg *parent) {
+    drbg_bytes(parent, child->key, sizeof(child->key));
+    child->stream = 0;
+    refill(child);
+}
+
+drbg *drbg_thread(void) {
+    static _Thread_local drbg d;
+    static _Thread_local int seeded;
+    if (!seeded) {
+        if (drbg_init(&d) != 0) {
+            fprintf(stderr, "drbg: no entropy source (getrandom, /dev/urandom)\n");
+            abort(); // never hand out keys from a predictable state
+        }
+        seeded = 1;
+    }
+    return &d;
+}
+
+void drbg_wipe(drbg *d) {
+    volatile unsigned char *p = (volatile unsigned char *)d;
+    for (size_t i = 0; i < sizeof(*d); ++i) p[i] = 0;
+}
+
+void drbg_bytes(drbg *d, void *out, size_t n) {
+    unsigned char *p = out;
+    while (n) {
+        if (d->pos == sizeof(d->buf)) refill(d);
+        size_t k = sizeof(d->buf) - d->pos;
+        if (k > n) k = n;
+        memcpy(p, d->buf + d->pos, k);
+        memset(d->buf + d->pos, 0, k); // handed-out bytes do not stay behind in the state
+        d->pos += k; p += k; n -= k;
+    }
+}
+
+void drbg_limbs(drbg *d, mp_limb_t *out, size_t n) {
+    drbg_bytes(d, out, n * sizeof(mp_limb_t));
+}
+
+uint64_t drbg_u64(drbg *d) {
+    uint64_t v;
+    drbg_bytes(d, &v, sizeof(v));
+    return v;
+}
+
+void drbg_urandomb(mpz_t r, drbg *d, mp_bitcnt_t bits) {
+    size_t n = (bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    if (n == 0) { mpz_set_ui(r, 0); return; }
+    mp_limb_t *l = mpz_limbs_write(r, n);
+    drbg_limbs(d, l, n);
+    if (bits % GMP_NUMB_BITS) l[n - 1] &= ((mp_limb_t)1 << (bits % GMP_NUMB_BITS)) - 1;
+    while (n > 0 && l[n - 1] == 0) --n;
+    mpz_limbs_finish(r, n);
+}
+
+int drbg_urandomm(mpz_t r, drbg *d, const mpz_t n) {
+    if (mpz_sgn(n) <= 0) return -1; // empty range: no draw would ever be accepted
+    mp_bitcnt_t bits = mpz_sizeinbase(n, 2);
+    if (r == n) { // keep the bound while r is overwritten
+        mpz_t bound;
+        mpz_init_set(bound, n);
+        drbg_urandomm(r, d, bound);
+        mpz_clear(bound);
+        return 0;
+    }
+    do drbg_urandomb(r, d, bits);
+    while (mpz_cmp(r, n) >= 0);
+    return 0;
+}
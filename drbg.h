@@ -0,0 +1,49 @@
+// drbg.h
+// ChaCha20 random bit generator for candidates and private exponents.
+//
+// A drbg is one ChaCha20 stream (Bernstein's original layout: 64-bit block counter, 64-bit
+// stream id) that refills a buffer DRBG_BLOCKS blocks at a time, all blocks of a refill
+// computed side by side in SIMD lanes. The first 32 bytes of every refill become the next key
+// and are never handed out ("fast key erasure"), so a state captured later cannot reproduce
+// earlier output. drbg_thread gives each thread its own generator, seeded from getrandom() on
+// first use, so threads never share or lock a state.
+//
+// drbg_seed_ui gives a reproducible stream for tests and benchmarks only.
+
+#ifndef DRBG_H
+#define DRBG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <gmp.h>
+
+#define DRBG_BLOCKS 16 // 64-byte blocks per refill (one per 32-bit lane of a 512-bit vector)
+
+typedef struct {
+    uint32_t key[8];
+    uint64_t stream;
+    size_t pos;                              // next unread byte of buf
+    _Alignas(64) unsigned char buf[64 * DRBG_BLOCKS];
+} drbg;
+
+// fresh key from getrandom(); 0 on success, -1 if the kernel has no randomness to give
+int drbg_init(drbg *d);
+// deterministic stream for seed (not for keys)
+void drbg_seed_ui(drbg *d, unsigned long seed);
+// independent child: its key is drawn from parent
+void drbg_fork(drbg *child, drbg *parent);
+// this thread's generator (getrandom-seeded on first use; aborts if no entropy source works)
+drbg *drbg_thread(void);
+void drbg_wipe(drbg *d);
+
+void drbg_bytes(drbg *d, void *out, size_t n);
+void drbg_limbs(drbg *d, mp_limb_t *out, size_t n);
+uint64_t drbg_u64(drbg *d);
+
+// r uniform in [0, 2^bits), limbs written in place
+void drbg_urandomb(mpz_t r, drbg *d, mp_bitcnt_t bits);
+// r uniform in [0, n) (rejection on the bit length of n: fewer than 2 draws on average);
+// 0, or -1 with r untouched if n <= 0
+int drbg_urandomm(mpz_t r, drbg *d, const mpz_t n);
+
+#endif
@@ -0,0 +1,926 @@
+// ecpp.c
+//
+// A. O. L. Atkin and F. Morain, "Elliptic curves and primality proving" (Math. Comp. 1993);
+// H. Cohen, "A Course in Computational Algebraic Number Theory", 1.5.3 (Cornacchia) and 7.6
+// (class polynomials). j(tau) is evaluated as (256f + 1)^3 / f with f = Delta(2 tau) / Delta(tau),
+// both from the pentagonal series of the eta function, and H_D is the product of x - j over the
+// reduced forms, rounded to integers. Curve arithmetic is affine with every inverse taken
+// mod N: a denominator that is zero mod N is the point at infinity mod every prime of N, and
+// one that is neither zero nor invertible stops the computation, so what is computed mod N is
+// what would be computed mod each of its primes.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ecpp.h"
+#include "drbg.h"
+#include "mr64.h"
+#include "worksteal.h"
+
+#define WORD_BITS 64    // chains end below 2^64, where mr64 is exact
+#define BATCH_MIN 16    // discriminants tried at once per step (more with more workers)
+#define ROOT_TRIES 200  // random splittings of H_D mod N before giving up on it
+#define POINT_TRIES 4   // random points per twist
+
+// ---------------- certificate ----------------
+
+void ecpp_cert_init(ecpp_cert *c) {
+    c->len = c->cap = 0;
+    c->step = NULL;
+}
+
+void ecpp_cert_clear(ecpp_cert *c) {
+    for (size_t i = 0; i < c->cap; ++i) {
+        ecpp_step *s = &c->step[i];
+        mpz_clears(s->N, s->a, s->b, s->m, s->q, s->x, s->y, NULL);
+    }
+    free(c->step);
+    ecpp_cert_init(c);
+}
+
+static ecpp_step *cert_push(ecpp_cert *c) {
+    if (c->len == c->cap) {
+        size_t cap = c->cap ? 2 * c->cap : 32;
+        ecpp_step *s = realloc(c->step, cap * sizeof(*s));
+        if (!s) return NULL;
+        for (size_t i = c->cap; i < cap; ++i)
+            mpz_inits(s[i].N, s[i].a, s[i].b, s[i].m, s[i].q, s[i].x, s[i].y, NULL);
+        c->step = s;
+        c->cap = cap;
+    }
+    return &c->step[c->len++];
+}
+
+void ecpp_cert_print(FILE *f, const ecpp_cert *c) {
+    for (size_t i = 0; i < c->len; ++i) {
+        const ecpp_step *s = &c->step[i];
+        gmp_fprintf(f, "%Zx %Zx %Zx %Zx %Zx %Zx %Zx\n", s->N, s->a, s->b, s->m, s->q, s->x, s->y);
+    }
+}
+
+int ecpp_cert_read(FILE *f, ecpp_cert *c) {
+    c->len = 0;
+    for (;;) {
+        ecpp_step *s = cert_push(c);
+        if (!s) return -1;
+        if (mpz_inp_str(s->N, f, 16) == 0) { c->len--; return feof(f) ? 0 : -1; }
+        mpz_ptr rest[] = { s->a, s->b, s->m, s->q, s->x, s->y };
+        for (size_t i = 0; i < 6; ++i)
+            if (mpz_inp_str(rest[i], f, 16) == 0) return -1;
+    }
+}
+
+// ---------------- curve arithmetic ----------------
+
+typedef struct {
+    mpz_t x, y;
+    int inf;
+} ec_point;
+
+typedef struct {
+    mpz_srcptr a, N;
+    mpz_t l, t, u;
+} ec_curve;
+
+static void ec_point_init(ec_point *p) { mpz_inits(p->x, p->y, NULL); p->inf = 1; }
+static void ec_point_clear(ec_point *p) { mpz_clears(p->x, p->y, NULL); }
+static void ec_point_set(ec_point *r, const ec_point *p) {
+    mpz_set(r->x, p->x); mpz_set(r->y, p->y); r->inf = p->inf;
+}
+
+// e->t = 1/d mod N; 1 if d = 0 mod N (the point at infinity), -1 if d shares a proper factor
+// with N, 0 otherwise
+static int ec_invert(ec_curve *e, const mpz_t d) {
+    mpz_mod(e->t, d, e->N);
+    if (mpz_sgn(e->t) == 0) return 1;
+    return mpz_invert(e->t, e->t, e->N) ? 0 : -1;
+}
+
+// r = x - l^2 - x1 - x2, y3 = l (x1 - x3) - y1, from l in e->l
+static void ec_finish(ec_curve *e, ec_point *r, const ec_point *p, const mpz_t x2) {
+    mpz_mul(e->u, e->l, e->l);
+    mpz_sub(e->u, e->u, p->x);
+    mpz_sub(e->u, e->u, x2);
+    mpz_mod(e->u, e->u, e->N);   // x3
+    mpz_sub(e->t, p->x, e->u);
+    mpz_mul(e->t, e->t, e->l);
+    mpz_sub(e->t, e->t, p->y);
+    mpz_mod(r->y, e->t, e->N);
+    mpz_set(r->x, e->u);
+    r->inf = 0;
+}
+
+static int ec_dbl(ec_curve *e, ec_point *r, const ec_point *p) {
+    if (p->inf) { r->inf = 1; return 0; }
+    mpz_mul_2exp(e->u, p->y, 1);
+    int s = ec_invert(e, e->u);
+    if (s) { r->inf = 1; return s < 0 ? -1 : 0; }
+    mpz_mul(e->l, p->x, p->x);
+    mpz_mul_ui(e->l, e->l, 3);
+    mpz_add(e->l, e->l, e->a);
+    mpz_mul(e->l, e->l, e->t);
+    mpz_mod(e->l, e->l, e->N);
+    ec_finish(e, r, p, p->x);
+    return 0;
+}
+
+// r = p + q; r may be p but not q
+static int ec_add(ec_curve *e, ec_point *r, const ec_point *p, const ec_point *q) {
+    if (q->inf) { ec_point_set(r, p); return 0; }
+    if (p->inf) { ec_point_set(r, q); return 0; }
+    if (mpz_cmp(p->x, q->x) == 0) {
+        if (mpz_cmp(p->y, q->y) == 0) return ec_dbl(e, r, p);
+        mpz_add(e->u, p->y, q->y);
+        if (mpz_cmp(e->u, e->N) == 0) { r->inf = 1; return 0; }
+        return -1; // y1^2 = y2^2 with y1 != +-y2: N is composite
+    }
+    mpz_sub(e->u, q->x, p->x);
+    if (ec_invert(e, e->u) != 0) return -1;
+    mpz_sub(e->l, q->y, p->y);
+    mpz_mul(e->l, e->l, e->t);
+    mpz_mod(e->l, e->l, e->N);
+    ec_finish(e, r, p, q->x);
+    return 0;
+}
+
+// r = [k]p, k >= 1, left to right; r must not be p
+static int ec_mul(ec_curve *e, ec_point *r, const ec_point *p, const mpz_t k) {
+    ec_point_set(r, p);
+    for (mp_bitcnt_t i = mpz_sizeinbase(k, 2) - 1; i-- > 0; ) {
+        if (ec_dbl(e, r, r) != 0) return -1;
+        if (mpz_tstbit(k, i) && ec_add(e, r, r, p) != 0) return -1;
+    }
+    return 0;
+}
+
+// the Goldwasser-Kilian condition for P = (x, y): 1 if [m/q]P != O and [m]P = O, 0 if
+// [m]P != O, 2 if [m/q]P = O already, -1 if N showed a proper factor
+static int gk_check(const mpz_t N, const mpz_t a, const mpz_t m, const mpz_t q, const mpz_t x,
+                    const mpz_t y) {
+    ec_curve e = { .a = a, .N = N };
+    ec_point p, r, s;
+    mpz_t k;
+    mpz_inits(e.l, e.t, e.u, k, NULL);
+    ec_point_init(&p); ec_point_init(&r); ec_point_init(&s);
+    mpz_set(p.x, x); mpz_set(p.y, y); p.inf = 0;
+    mpz_divexact(k, m, q);
+    int ok = ec_mul(&e, &r, &p, k);
+    if (ok == 0) ok = r.inf ? 2 : ec_mul(&e, &s, &r, q) != 0 ? -1 : s.inf;
+    ec_point_clear(&p); ec_point_clear(&r); ec_point_clear(&s);
+    mpz_clears(e.l, e.t, e.u, k, NULL);
+    return ok;
+}
+
+// q > (N^(1/4) + 1)^2, through (floor(sqrt q) - 1)^4 > N
+static int q_large_enough(const mpz_t q, const mpz_t N) {
+    mpz_t s;
+    mpz_init(s);
+    mpz_sqrt(s, q);
+    mpz_sub_ui(s, s, 1);
+    mpz_pow_ui(s, s, 4);
+    int ok = mpz_cmp(s, N) > 0;
+    mpz_clear(s);
+    return ok;
+}
+
+int ecpp_cert_verify(const ecpp_cert *c, const mpz_t n) {
+    if (c->len == 0)
+        return mpz_sgn(n) > 0 && mpz_sizeinbase(n, 2) <= WORD_BITS && mr64_is_prime(mpz_get_ui(n));
+    if (mpz_cmp(c->step[0].N, n) != 0) return 0;
+    mpz_t t, u;
+    mpz_inits(t, u, NULL);
+    int ok = 1;
+    for (size_t i = 0; i < c->len && ok; ++i) {
+        const ecpp_step *s = &c->step[i];
+        mpz_srcptr next = i + 1 < c->len ? c->step[i + 1].N : NULL;
+        ok = mpz_cmp_ui(s->N, 3) > 0 && mpz_gcd_ui(NULL, s->N, 6) == 1
+             && (next ? mpz_cmp(s->q, next) == 0
+                      : mpz_sizeinbase(s->q, 2) <= WORD_BITS && mr64_is_prime(mpz_get_ui(s->q)))
+             && mpz_sgn(s->m) > 0 && mpz_divisible_p(s->m, s->q) && q_large_enough(s->q, s->N);
+        mpz_srcptr reduced[] = { s->a, s->b, s->x, s->y };
+        for (size_t j = 0; j < 4 && ok; ++j) ok = mpz_sgn(reduced[j]) >= 0 && mpz_cmp(reduced[j], s->N) < 0;
+        if (!ok) break;
+        mpz_powm_ui(t, s->a, 3, s->N); // 4a^3 + 27b^2 prime to N
+        mpz_mul_ui(t, t, 4);
+        mpz_mul(u, s->b, s->b);
+        mpz_addmul_ui(t, u, 27);
+        mpz_gcd(t, t, s->N);
+        ok = mpz_cmp_ui(t, 1) == 0;
+        if (!ok) break;
+        mpz_powm_ui(t, s->x, 3, s->N); // P on the curve
+        mpz_addmul(t, s->a, s->x);
+        mpz_add(t, t, s->b);
+        mpz_submul(t, s->y, s->y);
+        ok = mpz_divisible_p(t, s->N) && gk_check(s->N, s->a, s->m, s->q, s->x, s->y) == 1;
+    }
+    mpz_clears(t, u, NULL);
+    return ok;
+}
+
+// ---------------- discriminants and class polynomials ----------------
+
+typedef struct {
+    long D;
+    int h;
+    int fa[ECPP_MAX_CLASS], fb[ECPP_MAX_CLASS]; // reduced forms (a, b, .)
+    mpz_t *H;                                   // H_D, h+1 coefficients; NULL until built
+} disc;
+
+static disc *discs;
+static size_t ndiscs;
+static mpz_t primorial; // product of the primes below ECPP_SMOOTH_BOUND
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t H_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int squarefree(long n) {
+    for (long p = 2; p * p <= n; ++p)
+        if (n % (p * p) == 0) return 0;
+    return 1;
+}
+
+static int fundamental(long d) { // for D = -d
+    if (d % 4 == 3) return squarefree(d);
+    if (d % 4 == 0) return (d / 4 % 4 == 1 || d / 4 % 4 == 2) && squarefree(d / 4);
+    return 0;
+}
+
+static long gcd3(long a, long b, long c) {
+    long g = labs(b);
+    for (long x = a; x; ) { long t = g % x; g = x; x = t; }
+    for (long x = c; x; ) { long t = g % x; g = x; x = t; }
+    return g;
+}
+
+// reduced forms of discriminant -d; 0 if there are more than ECPP_MAX_CLASS
+static int reduced_forms(disc *s, long d) {
+    int h = 0;
+    for (long a = 1; 3 * a * a <= d; ++a)
+        for (long b = -a + 1; b <= a; ++b) {
+            if ((b * b + d) % (4 * a) != 0) continue;
+            long c = (b * b + d) / (4 * a);
+            if (c < a || (b < 0 && a == c) || gcd3(a, b, c) != 1) continue;
+            if (h == ECPP_MAX_CLASS) return 0;
+            s->fa[h] = (int)a;
+            s->fb[h] = (int)b;
+            h++;
+        }
+    return h;
+}
+
+static int by_class(const void *x, const void *y) {
+    const disc *p = x, *q = y;
+    if (p->h != q->h) return p->h - q->h;
+    return (p->D < q->D) - (p->D > q->D);
+}
+
+static void tables_init(void) {
+    discs = malloc(ECPP_MAX_DISC / 2 * sizeof(*discs));
+    for (long d = 3; d <= ECPP_MAX_DISC && discs; ++d) {
+        if (!fundamental(d)) continue;
+        disc *s = &discs[ndiscs];
+        if ((s->h = reduced_forms(s, d)) == 0) continue;
+        s->D = -d;
+        s->H = NULL;
+        ndiscs++;
+    }
+    if (discs) qsort(discs, ndiscs, sizeof(*discs), by_class);
+    mpz_init(primorial);
+    mpz_primorial_ui(primorial, ECPP_SMOOTH_BOUND);
+}
+
+// complex numbers in multiprecision floating point, for the j-values
+typedef struct { mpf_t re, im; } cpx;
+
+static void cpx_init(cpx *z, mp_bitcnt_t prec) { mpf_init2(z->re, prec); mpf_init2(z->im, prec); }
+static void cpx_clear(cpx *z) { mpf_clear(z->re); mpf_clear(z->im); }
+static void cpx_set(cpx *r, const cpx *z) { mpf_set(r->re, z->re); mpf_set(r->im, z->im); }
+
+// r = x * y; t is scratch of two numbers at the same precision, r may alias x or y
+static void cpx_mul(cpx *r, const cpx *x, const cpx *y, mpf_t t[2]) {
+    mpf_mul(t[0], x->re, y->re);
+    mpf_mul(t[1], x->im, y->im);
+    mpf_sub(t[0], t[0], t[1]);        // real part
+    mpf_mul(t[1], x->re, y->im);
+    mpf_mul(r->im, x->im, y->re);
+    mpf_add(r->im, r->im, t[1]);
+    mpf_set(r->re, t[0]);
+}
+
+static void cpx_div(cpx *r, const cpx *x, const cpx *y, mpf_t t[2]) {
+    cpx c;
+    cpx_init(&c, mpf_get_prec(t[0]));
+    mpf_set(c.re, y->re);
+    mpf_neg(c.im, y->im);
+    cpx_mul(r, x, &c, t);             // x * conj(y) / |y|^2
+    mpf_mul(t[0], y->re, y->re);
+    mpf_mul(t[1], y->im, y->im);
+    mpf_add(t[0], t[0], t[1]);
+    mpf_div(r->re, r->re, t[0]);
+    mpf_div(r->im, r->im, t[0]);
+    cpx_clear(&c);
+}
+
+static void mpf_inits_prec(mp_bitcnt_t prec, ...) { // mpf_inits at a given precision
+    va_list ap;
+    va_start(ap, prec);
+    for (mpf_ptr x; (x = va_arg(ap, mpf_ptr)) != NULL; ) mpf_init2(x, prec);
+    va_end(ap);
+}
+
+static int below(const mpf_t t, long bits) { // |t| < 2^-bits
+    long e;
+    return mpf_sgn(t) == 0 || (mpf_get_d_2exp(&e, t), e < -bits);
+}
+
+// pi by Machin's formula, 16 atan(1/5) - 4 atan(1/239)
+static void mpf_pi(mpf_t pi, mp_bitcnt_t prec) {
+    mpf_t s, t, u;
+    mpf_inits_prec(prec, s, t, u, NULL);
+    mpf_set_ui(pi, 0);
+    static const unsigned long x[2] = { 5, 239 }, w[2] = { 16, 4 };
+    for (int i = 0; i < 2; ++i) {
+        mpf_set_ui(s, 0);
+        mpf_set_ui(t, 1);
+        mpf_div_ui(t, t, x[i]);       // x^-(2k+1)
+        for (unsigned long k = 0; !below(t, (long)prec); ++k) {
+            mpf_div_ui(u, t, 2 * k + 1);
+            if (k & 1) mpf_sub(s, s, u); else mpf_add(s, s, u);
+            mpf_div_ui(t, t, x[i] * x[i]);
+        }
+        mpf_mul_ui(s, s, w[i]);
+        if (i == 0) mpf_add(pi, pi, s); else mpf_sub(pi, pi, s);
+    }
+    mpf_clears(s, t, u, NULL);
+}
+
+// r = e^-y, y >= 0: Taylor series for y / 2^k < 1/2, then k squarings
+static void mpf_exp_neg(mpf_t r, const mpf_t y, mp_bitcnt_t prec) {
+    unsigned long k = 0;
+    mpf_t z, s, t;
+    mpf_inits_prec(prec + 64, z, s, t, NULL);
+    mpf_set(z, y);
+    while (mpf_cmp_d(z, 0.5) > 0) { mpf_div_2exp(z, z, 1); ++k; }
+    mpf_set_prec(s, prec + 64 + k);
+    mpf_set_prec(t, prec + 64 + k);
+    mpf_set_ui(s, 1);
+    mpf_set_ui(t, 1);
+    for (unsigned long n = 1; !below(t, (long)(prec + 64 + k)); ++n) {
+        mpf_mul(t, t, z);
+        mpf_div_ui(t, t, n);
+        mpf_add(s, s, t);
+    }
+    for (unsigned long i = 0; i < k; ++i) mpf_mul(s, s, s);
+    mpf_ui_div(r, 1, s);
+    mpf_clears(z, s, t, NULL);
+}
+
+// c = cos x, s = sin x for |x| <= pi
+static void mpf_cos_sin(mpf_t c, mpf_t s, const mpf_t x, mp_bitcnt_t prec) {
+    mpf_t t, x2;
+    mpf_inits_prec(prec + 16, t, x2, NULL);
+    mpf_mul(x2, x, x);
+    mpf_set_ui(c, 1);
+    mpf_set_ui(t, 1);
+    for (unsigned long n = 2; !below(t, (long)prec + 16); n += 2) { // t = x^n / n!
+        mpf_mul(t, t, x2);
+        mpf_div_ui(t, t, (n - 1) * n);
+        if (n % 4) mpf_sub(c, c, t); else mpf_add(c, c, t);
+    }
+    mpf_set(s, x);
+    mpf_set(t, x);
+    for (unsigned long n = 3; !below(t, (long)prec + 16); n += 2) {
+        mpf_mul(t, t, x2);
+        mpf_div_ui(t, t, (n - 1) * n);
+        if (n % 4 == 3) mpf_sub(s, s, t); else mpf_add(s, s, t);
+    }
+    mpf_clears(t, x2, NULL);
+}
+
+// r = prod (1 - q^n) = 1 + sum (-1)^k (q^(k(3k-1)/2) + q^(k(3k+1)/2)), |q| = 2^-L
+static void pentagonal(cpx *r, const cpx *q, double L, mp_bitcnt_t prec, mpf_t t[2]) {
+    cpx qk, ta, tb;
+    cpx_init(&qk, prec); cpx_init(&ta, prec); cpx_init(&tb, prec);
+    mpf_set_ui(r->re, 1);
+    mpf_set_ui(r->im, 0);
+    cpx_set(&qk, q);
+    cpx_set(&ta, q);
+    for (unsigned long k = 1;; ++k) {
+        cpx_mul(&tb, &ta, &qk, t);    // q^(k(3k+1)/2)
+        mpf_add(t[0], ta.re, tb.re);
+        mpf_add(t[1], ta.im, tb.im);
+        if (k & 1) { mpf_sub(r->re, r->re, t[0]); mpf_sub(r->im, r->im, t[1]); }
+        else       { mpf_add(r->re, r->re, t[0]); mpf_add(r->im, r->im, t[1]); }
+        if (L * (double)((k + 1) * (3 * k + 2) / 2) > (double)prec + 16) break;
+        cpx_mul(&ta, &tb, &qk, t);    // q^((k+1)(3k+2)/2) = q^(k(3k+1)/2) q^(2k+1)
+        cpx_mul(&ta, &ta, &qk, t);
+        cpx_mul(&ta, &ta, q, t);
+        cpx_mul(&qk, &qk, q, t);
+    }
+    cpx_clear(&qk); cpx_clear(&ta); cpx_clear(&tb);
+}
+
+// j((-b + sqrt(-d)) / 2a)
+static void j_value(cpx *j, long d, long a, long b, const mpf_t pi, mp_bitcnt_t prec, mpf_t t[2]) {
+    cpx q, q2, p1, p2, f;
+    cpx_init(&q, prec); cpx_init(&q2, prec); cpx_init(&p1, prec); cpx_init(&p2, prec); cpx_init(&f, prec);
+    mpf_t y;
+    mpf_init2(y, prec);
+    // q = e^(2 pi i tau) = e^(-pi sqrt(d) / a) (cos(pi b / a) - i sin(pi b / a))
+    mpf_sqrt_ui(y, (unsigned long)d);
+    mpf_mul(y, y, pi);
+    mpf_div_ui(y, y, (unsigned long)a);
+    double L = mpf_get_d(y) / M_LN2; // |q| = 2^-L
+    mpf_exp_neg(q2.re, y, prec);
+    mpf_mul_ui(y, pi, (unsigned long)labs(b));
+    mpf_div_ui(y, y, (unsigned long)a);
+    mpf_cos_sin(q.re, q.im, y, prec);
+    if (b > 0) mpf_neg(q.im, q.im);
+    mpf_mul(q.re, q.re, q2.re);
+    mpf_mul(q.im, q.im, q2.re);
+
+    cpx_mul(&q2, &q, &q, t);
+    pentagonal(&p1, &q, L, prec, t);
+    pentagonal(&p2, &q2, 2 * L, prec, t);
+    cpx_div(&f, &p2, &p1, t);         // (P(q^2) / P(q))^24 q = Delta(2 tau) / Delta(tau)
+    cpx_mul(&p1, &f, &f, t);          // ^2
+    cpx_mul(&p1, &p1, &p1, t);        // ^4
+    cpx_mul(&p1, &p1, &p1, t);        // ^8
+    cpx_mul(&p2, &p1, &p1, t);        // ^16
+    cpx_mul(&f, &p2, &p1, t);         // ^24
+    cpx_mul(&f, &f, &q, t);
+    mpf_mul_ui(p1.re, f.re, 256);     // j = (256 f + 1)^3 / f
+    mpf_mul_ui(p1.im, f.im, 256);
+    mpf_add_ui(p1.re, p1.re, 1);
+    cpx_mul(&p2, &p1, &p1, t);
+    cpx_mul(&p2, &p2, &p1, t);
+    cpx_div(j, &p2, &f, t);
+    mpf_clear(y);
+    cpx_clear(&q); cpx_clear(&q2); cpx_clear(&p1); cpx_clear(&p2); cpx_clear(&f);
+}
+
+// H_D = prod (x - j(tau)) over the reduced forms, coefficients rounded to integers
+static mpz_t *class_poly(const disc *s) {
+    long d = -s->D;
+    mpf_t pi, t[2];
+    mpf_init2(t[0], 64);
+    mpf_sqrt_ui(t[0], (unsigned long)d);
+    double bits = 0, sqrt_d = mpf_get_d(t[0]); // |j| is about e^(pi sqrt(d) / a)
+    mpf_clear(t[0]);
+    for (int i = 0; i < s->h; ++i) bits += M_PI * sqrt_d / s->fa[i] / M_LN2 + 8;
+    mp_bitcnt_t prec = (mp_bitcnt_t)bits + 128;
+
+    mpf_inits_prec(prec, pi, t[0], t[1], NULL);
+    mpf_pi(pi, prec);
+    cpx c[ECPP_MAX_CLASS + 1], j;
+    for (int i = 0; i <= s->h; ++i) cpx_init(&c[i], prec);
+    cpx_init(&j, prec);
+    mpf_set_ui(c[0].re, 1);
+    for (int i = 0; i < s->h; ++i) { // c *= (x - j)
+        j_value(&j, d, s->fa[i], s->fb[i], pi, prec, t);
+        cpx_set(&c[i + 1], &c[i]);
+        for (int k = i; k > 0; --k) {
+            cpx_mul(&c[k], &c[k], &j, t);
+            mpf_sub(c[k].re, c[k - 1].re, c[k].re);
+            mpf_sub(c[k].im, c[k - 1].im, c[k].im);
+        }
+        cpx_mul(&c[0], &c[0], &j, t);
+        mpf_neg(c[0].re, c[0].re);
+        mpf_neg(c[0].im, c[0].im);
+    }
+    mpz_t *H = malloc((size_t)(s->h + 1) * sizeof(mpz_t));
+    for (int i = 0; i <= s->h && H; ++i) { // c[i] holds the coefficient of x^i
+        mpz_init(H[i]);
+        mpf_set_d(t[0], mpf_sgn(c[i].re) < 0 ? -0.5 : 0.5);
+        mpf_add(t[0], c[i].re, t[0]);
+        mpz_set_f(H[i], t[0]);
+    }
+    for (int i = 0; i <= s->h; ++i) cpx_clear(&c[i]);
+    cpx_clear(&j);
+    mpf_clears(pi, t[0], t[1], NULL);
+    return H;
+}
+
+static mpz_t *class_poly_of(disc *s) {
+    pthread_mutex_lock(&H_lock);
+    if (!s->H) s->H = class_poly(s);
+    mpz_t *H = s->H;
+    pthread_mutex_unlock(&H_lock);
+    return H;
+}
+
+// ---------------- arithmetic mod N ----------------
+
+// r = sqrt(a) mod p (Tonelli-Shanks), p an odd probable prime; -1 if a is not a square (or p
+// is found composite)
+static int sqrt_mod(mpz_t r, const mpz_t a, const mpz_t p) {
+    mpz_t x, q, z, c, t, b;
+    mpz_inits(x, q, z, c, t, b, NULL);
+    int ok = -1;
+    mpz_mod(x, a, p);
+    if (mpz_sgn(x) == 0) { mpz_set_ui(r, 0); ok = 0; goto done; }
+    if (mpz_jacobi(x, p) != 1) goto done;
+    mpz_sub_ui(q, p, 1);
+    mp_bitcnt_t s = mpz_scan1(q, 0), m = s;
+    mpz_tdiv_q_2exp(q, q, s);
+    unsigned long g = 2;
+    while (mpz_ui_kronecker(g, p) != -1) ++g;
+    mpz_set_ui(z, g);
+    mpz_powm(c, z, q, p);
+    mpz_add_ui(b, q, 1);
+    mpz_tdiv_q_2exp(b, b, 1);
+    mpz_powm(r, x, b, p);
+    mpz_powm(t, x, q, p);
+    while (mpz_cmp_ui(t, 1) != 0) {
+        mp_bitcnt_t i = 0;
+        for (mpz_set(z, t); mpz_cmp_ui(z, 1) != 0 && i < m; ++i) { mpz_mul(z, z, z); mpz_mod(z, z, p); }
+        if (i == m) goto done;        // p is not prime
+        mpz_set(b, c);
+        for (mp_bitcnt_t k = 0; k + i + 1 < m; ++k) { mpz_mul(b, b, b); mpz_mod(b, b, p); }
+        mpz_mul(r, r, b); mpz_mod(r, r, p);
+        mpz_mul(c, b, b); mpz_mod(c, c, p);
+        mpz_mul(t, t, c); mpz_mod(t, t, p);
+        m = i;
+    }
+    mpz_mul(z, r, r);
+    ok = mpz_congruent_p(z, x, p) ? 0 : -1;
+done:
+    mpz_clears(x, q, z, c, t, b, NULL);
+    return ok;
+}
+
+// 4N = u^2 + d v^2 (modified Cornacchia, Cohen 1.5.3); 0 on success
+static int cornacchia(mpz_t u, mpz_t v, long d, const mpz_t N) {
+    mpz_t a, b, l, t;
+    mpz_inits(a, b, l, t, NULL);
+    int ok = -1;
+    mpz_set_si(t, -d);
+    if (sqrt_mod(b, t, N) != 0) goto done;
+    if (mpz_odd_p(b) != (d & 1)) mpz_sub(b, N, b);
+    mpz_mul_2exp(a, N, 1);
+    mpz_mul_2exp(l, N, 2);
+    mpz_sqrt(l, l);
+    while (mpz_cmp(b, l) > 0) {
+        mpz_mod(t, a, b);
+        mpz_swap(a, b);
+        mpz_swap(b, t);
+    }
+    mpz_mul_2exp(t, N, 2);
+    mpz_submul(t, b, b);
+    if (mpz_sgn(t) < 0 || !mpz_divisible_ui_p(t, (unsigned long)d)) goto done;
+    mpz_divexact_ui(t, t, (unsigned long)d);
+    if (!mpz_perfect_square_p(t)) goto done;
+    mpz_sqrt(v, t);
+    mpz_set(u, b);
+    ok = 0;
+done:
+    mpz_clears(a, b, l, t, NULL);
+    return ok;
+}
+
+// traces of the curves with CM by D: +-u, and +-2v (D = -4) or +-(u +- 3v)/2 (D = -3)
+static int traces(mpz_t t[6], long D, const mpz_t u, const mpz_t v) {
+    int n = 0;
+    mpz_set(t[n++], u);
+    if (D == -4) mpz_mul_2exp(t[n++], v, 1);
+    if (D == -3) {
+        mpz_mul_ui(t[n], v, 3); mpz_add(t[n], t[n], u); mpz_tdiv_q_2exp(t[n], t[n], 1); n++;
+        mpz_mul_ui(t[n], v, 3); mpz_sub(t[n], u, t[n]); mpz_tdiv_q_2exp(t[n], t[n], 1); n++;
+    }
+    for (int i = 0, k = n; i < k; ++i) mpz_neg(t[n++], t[i]);
+    return n;
+}
+
+// q = m without its prime factors below ECPP_SMOOTH_BOUND
+static void strip_smooth(mpz_t q, const mpz_t m, mpz_t g) {
+    mpz_mod(g, primorial, m);
+    mpz_gcd(g, g, m);
+    mpz_set(q, m);
+    while (mpz_cmp_ui(g, 1) > 0) {
+        mpz_divexact(q, q, g);
+        mpz_gcd(g, q, g);
+    }
+}
+
+// ---------------- polynomials mod N (root of H_D) ----------------
+
+typedef struct {
+    int deg;                              // -1 for 0
+    mpz_t c[2 * ECPP_MAX_CLASS + 1];
+} poly;
+
+static void poly_init(poly *p) { p->deg = -1; for (int i = 0; i <= 2 * ECPP_MAX_CLASS; ++i) mpz_init(p->c[i]); }
+static void poly_clear(poly *p) { for (int i = 0; i <= 2 * ECPP_MAX_CLASS; ++i) mpz_clear(p->c[i]); }
+static void poly_norm(poly *p) { while (p->deg >= 0 && mpz_sgn(p->c[p->deg]) == 0) p->deg--; }
+static void poly_set(poly *r, const poly *p) {
+    r->deg = p->deg;
+    for (int i = 0; i <= p->deg; ++i) mpz_set(r->c[i], p->c[i]);
+}
+
+// r = p mod f (f monic), coefficients mod N
+static void poly_rem(poly *r, const poly *p, const poly *f, const mpz_t N) {
+    if (r != p) poly_set(r, p);
+    for (int i = r->deg; i >= f->deg; --i) {
+        mpz_mod(r->c[i], r->c[i], N);
+        for (int k = 0; k < f->deg; ++k) mpz_submul(r->c[i - f->deg + k], r->c[i], f->c[k]);
+        mpz_set_ui(r->c[i], 0);
+    }
+    if (r->deg >= f->deg) r->deg = f->deg - 1;
+    for (int i = 0; i <= r->deg; ++i) mpz_mod(r->c[i], r->c[i], N);
+    poly_norm(r);
+}
+
+// r = p * q mod f; r must not alias p or q
+static void poly_mulmod(poly *r, const poly *p, const poly *q, const poly *f, const mpz_t N) {
+    r->deg = p->deg < 0 || q->deg < 0 ? -1 : p->deg + q->deg;
+    for (int i = 0; i <= r->deg; ++i) mpz_set_ui(r->c[i], 0);
+    for (int i = 0; i <= p->deg; ++i)
+        for (int k = 0; k <= q->deg; ++k) mpz_addmul(r->c[i + k], p->c[i], q->c[k]);
+    poly_rem(r, r, f, N);
+}
+
+// p monic (p != 0)
+static void poly_monic(poly *p, const mpz_t N, mpz_t t) {
+    mpz_invert(t, p->c[p->deg], N);
+    for (int i = 0; i <= p->deg; ++i) { mpz_mul(p->c[i], p->c[i], t); mpz_mod(p->c[i], p->c[i], N); }
+}
+
+// a = gcd(a, b), monic; b is destroyed
+static void poly_gcd(poly *a, poly *b, const mpz_t N, mpz_t t) {
+    poly r;
+    poly_init(&r);
+    while (b->deg >= 0) {
+        poly_monic(b, N, t);
+        poly_rem(&r, a, b, N);
+        poly_set(a, b);
+        poly_set(b, &r);
+    }
+    if (a->deg >= 0) poly_monic(a, N, t);
+    poly_clear(&r);
+}
+
+// a / b, b monic and a divisor of a
+static void poly_divexact(poly *q, const poly *a, const poly *b, const mpz_t N) {
+    poly r;
+    poly_init(&r);
+    poly_set(&r, a);
+    q->deg = a->deg - b->deg;
+    for (int i = q->deg; i >= 0; --i) {
+        mpz_mod(q->c[i], r.c[i + b->deg], N);
+        for (int k = 0; k <= b->deg; ++k) mpz_submul(r.c[i + k], q->c[i], b->c[k]);
+    }
+    poly_clear(&r);
+}
+
+// a root of H (degree h, splitting into distinct linear factors mod N): Cantor-Zassenhaus,
+// gcd((x + delta)^((N-1)/2) - 1, g) splits g about in half
+static int poly_root(mpz_t root, mpz_t *H, int h, const mpz_t N, drbg *rng) {
+    poly g, w, x, t, d;
+    poly_init(&g); poly_init(&w); poly_init(&x); poly_init(&t); poly_init(&d);
+    mpz_t e, s;
+    mpz_inits(e, s, NULL);
+    g.deg = h;
+    for (int i = 0; i <= h; ++i) mpz_mod(g.c[i], H[i], N);
+    mpz_sub_ui(e, N, 1);
+    mpz_tdiv_q_2exp(e, e, 1);
+    for (int tries = 0; g.deg > 1 && tries < ROOT_TRIES; ++tries) {
+        x.deg = 1;                    // x + delta
+        mpz_set_ui(x.c[1], 1);
+        drbg_urandomm(x.c[0], rng, N);
+        w.deg = 0;
+        mpz_set_ui(w.c[0], 1);
+        for (mp_bitcnt_t i = mpz_sizeinbase(e, 2); i-- > 0; ) {
+            poly_mulmod(&t, &w, &w, &g, N);
+            if (mpz_tstbit(e, i)) poly_mulmod(&w, &t, &x, &g, N); else poly_set(&w, &t);
+        }
+        if (w.deg < 0) continue;
+        mpz_sub_ui(w.c[0], w.c[0], 1);
+        mpz_mod(w.c[0], w.c[0], N);
+        poly_norm(&w);
+        poly_set(&d, &g);
+        poly_gcd(&d, &w, N, s);
+        if (d.deg <= 0 || d.deg >= g.deg) continue;
+        if (2 * d.deg > g.deg) { poly_divexact(&t, &g, &d, N); poly_set(&d, &t); }
+        poly_set(&g, &d);
+    }
+    int ok = g.deg == 1 ? 0 : -1;
+    if (ok == 0) { // g monic: root = -g0
+        mpz_neg(root, g.c[0]);
+        mpz_mod(root, root, N);
+    }
+    mpz_clears(e, s, NULL);
+    poly_clear(&g); poly_clear(&w); poly_clear(&x); poly_clear(&t); poly_clear(&d);
+    return ok;
+}
+
+// ---------------- the search ----------------
+
+typedef struct {
+    size_t disc;
+    mpz_t m, q;
+} candidate;
+
+// the discriminants of one batch, each on some worker
+struct batch {
+    mpz_srcptr N;
+    size_t first;
+    int *ok;          // per discriminant: an order was found
+    mpz_t *m, *q;     // the one with the smallest q
+};
+
+static void try_disc(size_t i, void *arg) {
+    struct batch *b = arg;
+    const disc *s = &discs[b->first + i];
+    b->ok[i] = 0;
+    if (mpz_si_kronecker(s->D, b->N) != 1) return;
+    mpz_t u, v, m, q, g, t[6];
+    mpz_inits(u, v, m, q, g, t[0], t[1], t[2], t[3], t[4], t[5], NULL);
+    if (cornacchia(u, v, -s->D, b->N) == 0) {
+        int n = traces(t, s->D, u, v);
+        for (int k = 0; k < n; ++k) {
+            mpz_add_ui(m, b->N, 1);
+            mpz_sub(m, m, t[k]);
+            strip_smooth(q, m, g);
+            if (mpz_cmp(q, b->N) >= 0 || !q_large_enough(q, b->N)) continue;
+            if (b->ok[i] && mpz_cmp(q, b->q[i]) >= 0) continue;
+            if (!mpz_probab_prime_p(q, 1)) continue;
+            b->ok[i] = 1;
+            mpz_set(b->m[i], m);
+            mpz_set(b->q[i], q);
+        }
+    }
+    mpz_clears(u, v, m, q, g, t[0], t[1], t[2], t[3], t[4], t[5], NULL);
+}
+
+typedef struct {
+    mpz_t N;
+    candidate *cand;
+    size_t ncand, cap, used;
+    size_t next_disc;
+} level;
+
+static int by_q(const void *x, const void *y) {
+    return mpz_cmp(((const candidate *)x)->q, ((const candidate *)y)->q);
+}
+
+// next candidate order for the level, running more batches of discriminants as needed
+static candidate *next_candidate(level *L, size_t batch_size) {
+    while (L->used == L->ncand) {
+        if (L->next_disc >= ndiscs) return NULL;
+        size_t n = ndiscs - L->next_disc < batch_size ? ndiscs - L->next_disc : batch_size;
+        int *ok = malloc(n * sizeof(int));
+        mpz_t *m = malloc(n * sizeof(mpz_t)), *q = malloc(n * sizeof(mpz_t));
+        if (!ok || !m || !q) { free(ok); free(m); free(q); return NULL; }
+        for (size_t i = 0; i < n; ++i) mpz_inits(m[i], q[i], NULL);
+        struct batch b = { L->N, L->next_disc, ok, m, q };
+        ws_parallel_for(0, n, 1, try_disc, &b);
+        size_t start = L->ncand;
+        for (size_t i = 0; i < n; ++i) {
+            if (ok[i]) {
+                if (L->ncand == L->cap) {
+                    size_t cap = L->cap ? 2 * L->cap : 16;
+                    candidate *c = realloc(L->cand, cap * sizeof(*c));
+                    if (!c) break;
+                    L->cand = c;
+                    L->cap = cap;
+                }
+                candidate *c = &L->cand[L->ncand++];
+                c->disc = L->next_disc + i;
+                mpz_init_set(c->m, m[i]);
+                mpz_init_set(c->q, q[i]);
+            }
+            mpz_clears(m[i], q[i], NULL);
+        }
+        free(ok); free(m); free(q);
+        qsort(L->cand + start, L->ncand - start, sizeof(candidate), by_q); // biggest step first
+        L->next_disc += n;
+    }
+    return &L->cand[L->used++];
+}
+
+static void level_clear(level *L) {
+    for (size_t i = 0; i < L->ncand; ++i) mpz_clears(L->cand[i].m, L->cand[i].q, NULL);
+    free(L->cand);
+    mpz_clear(L->N);
+}
+
+// a curve of order c->m with CM by D and a point meeting the Goldwasser-Kilian condition, into
+// s; 0 on success, -1 if none of the twists has order m (or N turned out composite)
+static int build_curve(ecpp_step *s, const mpz_t N, const candidate *c, drbg *rng) {
+    disc *d = &discs[c->disc];
+    mpz_t j, g, t, a, b, rhs;
+    mpz_inits(j, g, t, a, b, rhs, NULL);
+    int ok = -1, ntwists = d->D == -3 ? 6 : d->D == -4 ? 4 : 2;
+    mpz_t *H = class_poly_of(d);
+    if (!H || poly_root(j, H, d->h, N, rng) != 0) goto done;
+
+    if (d->D == -3) { mpz_set_ui(a, 0); mpz_set_ui(b, 1); }
+    else if (d->D == -4) { mpz_set_ui(a, 1); mpz_set_ui(b, 0); }
+    else { // k = j / (1728 - j), a = 3k, b = 2k
+        mpz_ui_sub(t, 1728, j);
+        mpz_mod(t, t, N);
+        if (mpz_sgn(j) == 0 || !mpz_invert(t, t, N)) goto done;
+        mpz_mul(t, t, j);
+        mpz_mul_ui(a, t, 3); mpz_mod(a, a, N);
+        mpz_mul_ui(b, t, 2); mpz_mod(b, b, N);
+    }
+    // twisting generator: a non-square, for D = -3 also a non-cube
+    mpz_sub_ui(t, N, 1);
+    for (unsigned long x = 2;; ++x) {
+        if (mpz_ui_kronecker(x, N) != -1) continue;
+        mpz_set_ui(g, x);
+        if (d->D == -3) {
+            mpz_divexact_ui(rhs, t, 3);
+            mpz_powm(rhs, g, rhs, N);
+            if (mpz_cmp_ui(rhs, 1) == 0) continue;
+        }
+        break;
+    }
+    for (int tw = 0; tw < ntwists && ok != 0; ++tw) {
+        if (tw) { // next twist: a g^2, b g^3 (generic); a g (D = -4); b g (D = -3)
+            if (d->D == -4) { mpz_mul(a, a, g); mpz_mod(a, a, N); }
+            else if (d->D == -3) { mpz_mul(b, b, g); mpz_mod(b, b, N); }
+            else {
+                mpz_mul(a, a, g); mpz_mul(a, a, g); mpz_mod(a, a, N);
+                mpz_mul(b, b, g); mpz_mul(b, b, g); mpz_mul(b, b, g); mpz_mod(b, b, N);
+            }
+        }
+        for (int p = 0; p < POINT_TRIES; ++p) {
+            int tries = 0;
+            do { // random point: x until x^3 + ax + b is a square
+                if (++tries > 256) goto done; // half of all x qualify when N is prime
+                drbg_urandomm(s->x, rng, N);
+                mpz_powm_ui(rhs, s->x, 3, N);
+                mpz_addmul(rhs, a, s->x);
+                mpz_add(rhs, rhs, b);
+                mpz_mod(rhs, rhs, N);
+            } while (sqrt_mod(s->y, rhs, N) != 0);
+            int r = gk_check(N, a, c->m, c->q, s->x, s->y);
+            if (r < 0) goto done;
+            if (r == 1) { ok = 0; break; }
+            if (r == 0) break; // [m]P != O: this twist has another order
+        }
+    }
+    if (ok == 0) {
+        mpz_set(s->N, N);
+        mpz_set(s->a, a); mpz_set(s->b, b);
+        mpz_set(s->m, c->m); mpz_set(s->q, c->q);
+    }
+done:
+    mpz_clears(j, g, t, a, b, rhs, NULL);
+    return ok;
+}
+
+int ecpp_prove(ecpp_cert *c, const mpz_t n) {
+    c->len = 0;
+    if (mpz_sizeinbase(n, 2) <= WORD_BITS)
+        return mpz_sgn(n) > 0 && mr64_is_prime(mpz_get_ui(n)) ? 0 : -1;
+    if (mpz_gcd_ui(NULL, n, 6) != 1 || !mpz_probab_prime_p(n, 1)) return -1;
+    pthread_once(&tables_once, tables_init);
+    if (!discs) return -1;
+    ws_worker *w = ws_self();
+    size_t batch = w ? 4 * ws_nworkers(w->owner) : 0;
+    if (batch < BATCH_MIN) batch = BATCH_MIN;
+    drbg *rng = drbg_thread();
+
+    size_t depth = 0, cap = 64;
+    level *L = malloc(cap * sizeof(*L));
+    if (!L) return -1;
+    memset(&L[0], 0, sizeof(L[0]));
+    mpz_init_set(L[0].N, n);
+    depth = 1;
+    int rc = -1;
+    while (depth > 0) {
+        level *top = &L[depth - 1];
+        candidate *cand = next_candidate(top, batch);
+        if (!cand) { // nothing left here: back to the previous step's next candidate
+            level_clear(top);
+            depth--;
+            if (c->len) c->len--;
+            continue;
+        }
+        ecpp_step *s = cert_push(c);
+        if (!s) break;
+        if (build_curve(s, top->N, cand, rng) != 0) { c->len--; continue; }
+        if (mpz_sizeinbase(cand->q, 2) <= WORD_BITS) {
+            if (mr64_is_prime(mpz_get_ui(cand->q))) { rc = 0; break; }
+            c->len--;
+            continue;
+        }
+        if (depth == cap) {
+            level *bigger = realloc(L, 2 * cap * sizeof(*L));
+            if (!bigger) break;
+            L = bigger;
+            cap *= 2;
+        }
+        memset(&L[depth], 0, sizeof(L[depth]));
+        mpz_init_set(L[depth].N, cand->q);
+        depth++;
+    }
+    while (depth > 0) level_clear(&L[--depth]);
+    free(L);
+    if (rc != 0) c->len = 0;
+    return rc;
+}
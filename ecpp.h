@@ -0,0 +1,56 @@
+// ecpp.h
+// Elliptic curve primality proving (Atkin-Morain) with a certificate anyone can re-check.
+//
+// Goldwasser-Kilian: if E: y^2 = x^3 + ax + b is nonsingular mod N, m = k*q with q prime and
+// q > (N^(1/4) + 1)^2, and a point P has [k]P != O and [q]([k]P) = O, then N is prime. Atkin
+// and Morain find such curves through complex multiplication: when 4N = u^2 + |D| v^2, a root
+// of the class polynomial H_D mod N is the j-invariant of a curve of order N + 1 -+ u (more
+// choices for D = -3, -4), so the order is known before the curve is built. Each step only
+// needs an order whose part above the small primes is a probable prime q, and q is proven the
+// same way, down to q < 2^64 (mr64.h).
+//
+// H_D is computed for every fundamental discriminant up to ECPP_MAX_DISC of class number up to
+// ECPP_MAX_CLASS, from the j-values of the reduced forms in multiprecision floating point, and
+// kept once built. The discriminants of one step are tried in batches spread over the calling
+// thread's scheduler (worksteal.h); a step with no usable order anywhere goes back to the
+// previous one and takes its next candidate.
+
+#ifndef ECPP_H
+#define ECPP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <gmp.h>
+
+#define ECPP_MAX_DISC 30000          // |D| bound of the discriminant table
+#define ECPP_MAX_CLASS 16            // class number bound (degree of H_D)
+#define ECPP_SMOOTH_BOUND (1ul << 20) // factors below this are stripped off the curve orders
+
+// one Goldwasser-Kilian step: N is prime if q is
+typedef struct {
+    mpz_t N, a, b; // curve y^2 = x^3 + ax + b mod N
+    mpz_t m, q;    // its order m = k*q
+    mpz_t x, y;    // point P with [k]P != O, [m]P = O
+} ecpp_step;
+
+// chain of steps from the proven number down; the last q is below 2^64
+typedef struct {
+    size_t len, cap;
+    ecpp_step *step;
+} ecpp_cert;
+
+void ecpp_cert_init(ecpp_cert *c);
+void ecpp_cert_clear(ecpp_cert *c);
+
+// Prove n prime. 0 with the certificate in c; -1 if n is composite (or no chain was found,
+// which the tables make unlikely below a few hundred digits). Parallel when called from a worker.
+int ecpp_prove(ecpp_cert *c, const mpz_t n);
+
+// 1 if c proves n prime, 0 otherwise; needs nothing but the certificate
+int ecpp_cert_verify(const ecpp_cert *c, const mpz_t n);
+
+// one line per step, "N a b m q x y" in hex; ecpp_cert_read takes the same back (0 or -1)
+void ecpp_cert_print(FILE *f, const ecpp_cert *c);
+int ecpp_cert_read(FILE *f, ecpp_cert *c);
+
+#endif
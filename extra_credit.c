@@ -1,6 +1,6 @@
 // diffie_fast.c
-// Build: gcc -O2 diffie_fast.c -o diffie_fast -lgmp
-// Run  : ./diffie_fast
+// Build: make diffie_fast   (see Makefile)
+// Run  : ./diffie_fast [dec|hex|bin]   (output format, see bigint_io.h)
 //
 // What it does (fast path only):
 // - Generates a safe prime P = 2*r + 1 with > 40 digits (default ~170 bits ≈ 51 digits).
@@ -14,18 +14,45 @@
 //   set USE_HARDCODED_P = 1 and fill HARDCODED_P below. Otherwise, keep generation on.
 //
 // Optional tweaks near the top:
+//   USE_SPECIAL_P: 1 = pseudo-Mersenne safe prime P = 2^k - c (fixed for a given DIGITS_MIN,
+//                  reduced mod P by folding instead of Montgomery REDC; -DUSE_SPECIAL_P=1)
+//   USE_FRIENDLY_P: 1 = random safe prime with P = -1 mod 2^64, whose -P^-1 mod 2^64 is 1
+//                  (Montgomery-friendly; see mont_use_friendly) (-DUSE_FRIENDLY_P=1)
+//   USE_PROVABLE_P: 1 = safe prime proven by a Pocklington certificate (Maurer's method)
+//                  instead of probable-prime tests; the chain is checked and its length printed
+//                  (-DUSE_PROVABLE_P=1)
 //   DIGITS_MIN   : minimum decimal digits for P (must be ≥ 41)
 //   XA_UI / XB_UI: private exponents (must exceed your assignment's thresholds)
 
 #include <stdio.h>
 #include <time.h>
 #include <gmp.h>
+#include "bigint_io.h"
+#include "fixint.h"
+#include "mont.h"
+#include "provable.h"
+#include "safeprime.h"
 
 // -------------------- Config --------------------
 #define USE_HARDCODED_P 0
 // If USE_HARDCODED_P == 1, put a SAFE PRIME here (P = 2r+1, with r prime):
 #define HARDCODED_P "0"
 
+// Special-form P = 2^k - c instead of a random safe prime (ignored with USE_HARDCODED_P)
+#ifndef USE_SPECIAL_P
+#define USE_SPECIAL_P 0
+#endif
+
+// Montgomery-friendly random P (ignored with USE_HARDCODED_P or USE_SPECIAL_P)
+#ifndef USE_FRIENDLY_P
+#define USE_FRIENDLY_P 0
+#endif
+
+// Provable random P (ignored with USE_HARDCODED_P, USE_SPECIAL_P or USE_FRIENDLY_P)
+#ifndef USE_PROVABLE_P
+#define USE_PROVABLE_P 0
+#endif
+
 // Minimum digits for P (assignment requires > 40). 51 ≈ 170 bits.
 static const unsigned DIGITS_MIN = 51;
 
@@ -36,74 +63,28 @@ static const unsigned long XB_UI = 51016;
 // Generator search starts at least from 100 (≥ 3 digits)
 static const unsigned long GEN_START_MIN = 100;
 
-// Miller-Rabin reps
+#if USE_HARDCODED_P
+// Miller-Rabin reps for checking HARDCODED_P
 static const int PRP_REPS = 30;
+#endif
 
 // ------------------------------------------------
 
-// Convert approximate decimal digits to bits: digits * log2(10) ≈ digits * 3.32193
-static unsigned digits_to_bits(unsigned digits) {
-    double bits_d = digits * 3.3219280948873626;
-    unsigned bits = (unsigned)(bits_d + 0.5);
-    if (bits < 3) bits = 3;
-    return bits;
-}
-
-// Generate a safe prime P=2r+1 with at least 'digits' decimal digits
-static void gen_safe_prime(mpz_t P, mpz_t r, unsigned digits) {
-    gmp_randstate_t st;
-    gmp_randinit_default(st);
-    gmp_randseed_ui(st, (unsigned)time(NULL));
-
-    unsigned bits = digits_to_bits(digits);
-    if (bits < 130) bits = 130; // keep it reasonably large
-
-    mpz_t candidate_r;
-    mpz_init(candidate_r);
-
-    // Loop until both r and P=2r+1 are probably prime
-    for (;;) {
-        mpz_urandomb(candidate_r, st, bits - 1);   // r has ~bits-1 bits
-        mpz_setbit(candidate_r, bits - 2);         // ensure high bit set for size
-        mpz_nextprime(candidate_r, candidate_r);   // r = next prime
-
-        // P = 2r + 1
-        mpz_mul_ui(P, candidate_r, 2);
-        mpz_add_ui(P, P, 1);
-
-        if (mpz_probab_prime_p(P, PRP_REPS)) {
-            // Ensure P has at least 'digits' decimal digits
-            if (mpz_sizeinbase(P, 10) >= digits) break;
-        }
+int main(int argc, char **argv) {
+    bigio_format fmt = BIGIO_DEC;
+    if (argc > 1) {
+        int f = bigio_parse_format(argv[1]);
+        if (f < 0) { fprintf(stderr, "unknown format %s (dec, hex, bin)\n", argv[1]); return 1; }
+        fmt = (bigio_format)f;
     }
-    mpz_set(r, candidate_r);
-    mpz_clear(candidate_r);
-    gmp_randclear(st);
-}
 
-// Return 1 if g is a primitive root modulo safe prime P (P=2r+1) using factors {2, r}
-static int is_generator_safe_prime(const mpz_t g, const mpz_t P, const mpz_t r) {
-    // For a primitive root modulo safe prime P, we need:
-    // g^((P-1)/2) != 1 mod P   and   g^((P-1)/r) != 1 mod P
-    mpz_t exp, t, Pm1;
-    mpz_inits(exp, t, Pm1, NULL);
-    mpz_sub_ui(Pm1, P, 1);
-
-    // Check factor 2
-    mpz_divexact_ui(exp, Pm1, 2);
-    mpz_powm(t, g, exp, P);
-    if (mpz_cmp_ui(t, 1) == 0) { mpz_clears(exp, t, Pm1, NULL); return 0; }
-
-    // Check factor r
-    mpz_divexact(exp, Pm1, r);
-    mpz_powm(t, g, exp, P);
-    if (mpz_cmp_ui(t, 1) == 0) { mpz_clears(exp, t, Pm1, NULL); return 0; }
-
-    mpz_clears(exp, t, Pm1, NULL);
-    return 1;
-}
+    // the generator test below runs on fixints: refuse a size that cannot fit before
+    // spending the time to generate P (the check after generation catches the rest)
+    if (!safeprime_fixint(DIGITS_MIN)) {
+        fprintf(stderr, "P of %u digits does not fit in %d limbs; raise FIXINT_LIMBS.\n", DIGITS_MIN, FIXINT_LIMBS);
+        return 1;
+    }
 
-int main(void) {
     mpz_t P, r; mpz_inits(P, r, NULL);
 
 #if USE_HARDCODED_P
@@ -131,51 +112,104 @@ int main(void) {
         mpz_clears(P, r, NULL);
         return 1;
     }
+#elif USE_SPECIAL_P
+    // Smallest c with 2^k - c a safe prime of >= DIGITS_MIN digits
+    unsigned long c;
+    if (safeprime_special(P, r, DIGITS_MIN, &c) != 0) {
+        fprintf(stderr, "No special-form safe prime found.\n");
+        mpz_clears(P, r, NULL);
+        return 1;
+    }
+#elif USE_FRIENDLY_P
+    // Safe prime with >= DIGITS_MIN decimal digits and an all-ones low limb
+    gen_safe_prime_friendly(P, r, DIGITS_MIN);
+#elif USE_PROVABLE_P
+    // Proven safe prime with >= DIGITS_MIN decimal digits: 2^(bits-1) > 10^(DIGITS_MIN-1)
+    prime_cert cert;
+    prime_cert_init(&cert);
+    mpz_ui_pow_ui(P, 10, DIGITS_MIN - 1);
+    unsigned bits = (unsigned)mpz_sizeinbase(P, 2) + 1;
+    if (provable_safe_prime(P, r, bits, drbg_thread(), &cert) != 0 || !prime_cert_verify(&cert)) {
+        fprintf(stderr, "Provable safe prime generation failed.\n");
+        prime_cert_clear(&cert);
+        mpz_clears(P, r, NULL);
+        return 1;
+    }
+    size_t cert_steps = cert.len;
+    prime_cert_clear(&cert);
 #else
     // Generate a safe prime with >= DIGITS_MIN decimal digits
     gen_safe_prime(P, r, DIGITS_MIN);
 #endif
 
-    // Primitive root search (start at ≥ GEN_START_MIN)
-    mpz_t alpha; mpz_init(alpha);
-    clock_t t0 = clock();
-    unsigned long start = GEN_START_MIN;
-    for (unsigned long cand = start;; ++cand) {
-        mpz_set_ui(alpha, cand);
-        if (is_generator_safe_prime(alpha, P, r)) break;
+    // Fixed-width copies of P and r for the generator test
+    fixint Pf, rf;
+    fixint_mont Pmod;
+    if (fixint_set_mpz(&Pf, P) != 0 || fixint_set_mpz(&rf, r) != 0 || fixint_mont_init(&Pmod, &Pf) != 0) {
+        fprintf(stderr, "P does not fit in %d limbs; raise FIXINT_LIMBS.\n", FIXINT_LIMBS);
+        mpz_clears(P, r, NULL);
+        return 1;
     }
-    clock_t t1 = clock();
-    double seconds = (double)(t1 - t0) / CLOCKS_PER_SEC;
+
+    // Primitive root search (start at ≥ GEN_START_MIN): one Legendre symbol per candidate
+    mpz_t alpha; mpz_init(alpha);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    unsigned long g = safeprime_generator(GEN_START_MIN, &Pmod, &rf, 0, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    mpz_set_ui(alpha, g);
+
+    // differential check: the Legendre-symbol test against the definition (g^r, g^2 != 1),
+    // on the answer and on every candidate it skipped
+    for (unsigned long c = GEN_START_MIN; c <= g; ++c)
+        if (is_generator_safe_prime_powm(c, &Pmod, &rf) != (c == g)) {
+            fprintf(stderr, "generator tests disagree at g = %lu\n", c);
+            mpz_clears(P, r, alpha, NULL);
+            return 1;
+        }
 
     // Private exponents
     mpz_t XA, XB; mpz_inits(XA, XB, NULL);
     mpz_set_ui(XA, XA_UI);
     mpz_set_ui(XB, XB_UI);
 
-    // Public keys
+    // Public keys (fixed-modulus Montgomery engine, set up once for P)
+    mont_ctx ctx; mont_init(&ctx, P);
     mpz_t YA, YB; mpz_inits(YA, YB, NULL);
-    mpz_powm(YA, alpha, XA, P);
-    mpz_powm(YB, alpha, XB, P);
+    mont_powm(YA, alpha, XA, &ctx);
+    mont_powm(YB, alpha, XB, &ctx);
 
     // Shared secrets
     mpz_t SA, SB; mpz_inits(SA, SB, NULL);
-    mpz_powm(SA, YB, XA, P);
-    mpz_powm(SB, YA, XB, P);
-
-    // Output
-    gmp_printf("P (prime, %lu digits) = %Zd\n", mpz_sizeinbase(P, 10), P);
-    gmp_printf("r ( (P-1)/2, prime ) = %Zd\n", r);
-    gmp_printf("alpha (generator)     = %Zd\n", alpha);
-    printf("Primitive root search time: %.6f s\n", seconds);
-    gmp_printf("XA = %Zd\n", XA);
-    gmp_printf("XB = %Zd\n", XB);
-    gmp_printf("YA = %Zd\n", YA);
-    gmp_printf("YB = %Zd\n", YB);
-    gmp_printf("S_A = %Zd\n", SA);
-    gmp_printf("S_B = %Zd\n", SB);
-    printf("Keys match? %s\n", (mpz_cmp(SA, SB) == 0) ? "YES" : "NO");
+    mont_powm(SA, YB, XA, &ctx);
+    mont_powm(SB, YA, XB, &ctx);
+
+    // Output (bin: just the records P, r, alpha, XA, XB, YA, YB, S_A, S_B)
+    bigio_writer out;
+    bigio_writer_init(&out, stdout, fmt, 0);
+    const char *label[] = { NULL, "r ( (P-1)/2, prime ) = ", "alpha (generator)     = ", "XA = ",
+                            "XB = ", "YA = ", "YB = ", "S_A = ", "S_B = " };
+    mpz_srcptr value[] = { P, r, alpha, XA, XB, YA, YB, SA, SB };
+    for (size_t i = 0; i < sizeof(value) / sizeof(value[0]); ++i) {
+        if (fmt != BIGIO_BIN) {
+#if USE_SPECIAL_P && !USE_HARDCODED_P
+            if (i == 0) bigio_printf(&out, "P = 2^%lu - %lu\n", mpz_sizeinbase(P, 2), c);
+#elif USE_PROVABLE_P && !USE_HARDCODED_P && !USE_SPECIAL_P && !USE_FRIENDLY_P
+            if (i == 0) bigio_printf(&out, "P proven prime: %zu-step Pocklington chain verified\n", cert_steps);
+#endif
+            if (i == 0) bigio_printf(&out, "P (prime, %lu digits) = ", mpz_sizeinbase(P, 10));
+            else if (i == 3) bigio_printf(&out, "Primitive root search time: %.6f s\n", seconds);
+            if (i) bigio_puts(&out, label[i]);
+        }
+        bigio_put_mpz(&out, value[i]);
+        if (fmt != BIGIO_BIN) bigio_puts(&out, "\n");
+    }
+    if (fmt != BIGIO_BIN) bigio_printf(&out, "Keys match? %s\n", (mpz_cmp(SA, SB) == 0) ? "YES" : "NO");
+    bigio_writer_close(&out);
 
     // Cleanup
+    mont_clear(&ctx);
     mpz_clears(P, r, alpha, XA, XB, YA, YB, SA, SB, NULL);
     return 0;
 }
@@ -0,0 +1,74 @@
+// fixedbase.c
+//
+// Every piece and every base goes through mont_powm, so large moduli get the IFMA engine
+// (ifma.h) inside each worker as well.
+
+#include <stdlib.h>
+#include "fixedbase.h"
+#include "hugepage.h"
+#include "worksteal.h"
+
+int fixed_base_init(fixed_base *fb, const mpz_t g, size_t ebits, size_t t, const mont_ctx *ctx) {
+    if (t == 0) t = ws_self() ? ws_nworkers(ws_self()->owner) : 1;
+    if (ebits == 0) ebits = 1;
+    if (t > ebits) t = ebits;
+    fb->ctx = ctx;
+    fb->t = t;
+    fb->chunk = (ebits + t - 1) / t;
+    fb->bases = hugepage_alloc(t * sizeof(mpz_t), NULL);
+    if (!fb->bases) return -1;
+    mpz_init(fb->g);
+    mpz_mod(fb->g, g, ctx->mz);
+
+    // each base is the previous one to the 2^chunk
+    mpz_t step;
+    mpz_init(step);
+    mpz_setbit(step, fb->chunk);
+    mpz_init_set(fb->bases[0], fb->g);
+    for (size_t i = 1; i < t; ++i) {
+        mpz_init(fb->bases[i]);
+        mont_powm(fb->bases[i], fb->bases[i - 1], step, ctx);
+    }
+    mpz_clear(step);
+    return 0;
+}
+
+void fixed_base_clear(fixed_base *fb) {
+    for (size_t i = 0; i < fb->t; ++i) mpz_clear(fb->bases[i]);
+    hugepage_free(fb->bases);
+    mpz_clear(fb->g);
+}
+
+struct split {
+    const fixed_base *fb;
+    mpz_srcptr e;
+    mpz_t *part; // part[i] = bases[i]^(e_i)
+};
+
+static void run_piece(size_t i, void *arg) {
+    struct split *s = arg;
+    const fixed_base *fb = s->fb;
+    mpz_t ei;
+    mpz_init(ei);
+    mpz_tdiv_q_2exp(ei, s->e, fb->chunk * i);
+    mpz_tdiv_r_2exp(ei, ei, fb->chunk);
+    mont_powm(s->part[i], fb->bases[i], ei, fb->ctx);
+    mpz_clear(ei);
+}
+
+void fixed_base_powm(mpz_t r, const fixed_base *fb, const mpz_t e) {
+    mpz_t *part = mpz_sizeinbase(e, 2) <= fb->chunk * fb->t ? hugepage_alloc(fb->t * sizeof(mpz_t), NULL) : NULL;
+    if (!part) { mont_powm(r, fb->g, e, fb->ctx); return; }
+    for (size_t i = 0; i < fb->t; ++i) mpz_init(part[i]);
+
+    struct split s = { fb, e, part };
+    ws_parallel_for(0, fb->t, 1, run_piece, &s);
+
+    mpz_set(r, part[0]);
+    for (size_t i = 1; i < fb->t; ++i) {
+        mpz_mul(r, r, part[i]);
+        mpz_mod(r, r, fb->ctx->mz);
+    }
+    for (size_t i = 0; i < fb->t; ++i) mpz_clear(part[i]);
+    hugepage_free(part);
+}
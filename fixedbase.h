@@ -0,0 +1,36 @@
+// fixedbase.h
+// Latency mode for exponentiations with a fixed base: one g^e split over the scheduler's
+// workers.
+//
+// With e cut into t chunks of c bits, e = sum e_i 2^(c*i), g^e is the product of
+// (g^(2^(c*i)))^(e_i). The bases g^(2^(c*i)) depend only on g, so they are computed once per
+// base; after that every piece is an independent exponentiation with a c-bit exponent, about
+// 1/t of the work, and the pieces run on different workers (worksteal.h). Only the t-1
+// products at the end are sequential, so one key generation takes about 1/t of the time.
+
+#ifndef FIXEDBASE_H
+#define FIXEDBASE_H
+
+#include <stddef.h>
+#include <gmp.h>
+#include "mont.h"
+
+typedef struct {
+    const mont_ctx *ctx; // modulus engine (borrowed; must outlive the fixed base)
+    mpz_t g;             // the base, for exponents wider than the split covers
+    size_t chunk;        // exponent bits per piece
+    size_t t;            // pieces
+    mpz_t *bases;        // bases[i] = g^(2^(chunk*i)) mod m
+} fixed_base;
+
+// Precompute for exponents of up to ebits bits in t pieces (t = 0: one per worker of the
+// calling thread's scheduler, or 1 outside it). 0 on success, -1 without memory.
+int fixed_base_init(fixed_base *fb, const mpz_t g, size_t ebits, size_t t, const mont_ctx *ctx);
+void fixed_base_clear(fixed_base *fb);
+
+// r = g^e mod m, e >= 0. The pieces run in parallel when called from a scheduler worker (ws_self
+// not NULL) and one after another otherwise; an e wider than the precomputation falls back to
+// a single mont_powm.
+void fixed_base_powm(mpz_t r, const fixed_base *fb, const mpz_t e);
+
+#endif
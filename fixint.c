@@ -0,0 +1,173 @@
+// fixint.c
+//
+// Fixed-width integer arithmetic on mpn with all temporaries on the stack.
+
+#include <string.h>
+#include "fixint.h"
+#include "mont_fixed.h"
+
+static void normalize(fixint *r) {
+    while (r->n > 0 && r->d[r->n - 1] == 0) r->n--;
+}
+
+void fixint_set_ui(fixint *r, mp_limb_t v) {
+    r->d[0] = v;
+    r->n = v != 0;
+}
+
+int fixint_set_mpz(fixint *r, const mpz_t a) {
+    mp_size_t an = mpz_size(a);
+    if (mpz_sgn(a) < 0 || an > FIXINT_LIMBS) return -1;
+    if (an) memcpy(r->d, mpz_limbs_read(a), an * sizeof(mp_limb_t));
+    r->n = an;
+    return 0;
+}
+
+void fixint_get_mpz(mpz_t r, const fixint *a) {
+    mp_limb_t *rp = mpz_limbs_write(r, a->n ? a->n : 1);
+    if (a->n) memcpy(rp, a->d, a->n * sizeof(mp_limb_t));
+    mpz_limbs_finish(r, a->n);
+}
+
+mpz_srcptr fixint_mpz(mpz_ptr view, const fixint *a) {
+    return mpz_roinit_n(view, a->d, a->n);
+}
+
+int fixint_cmp(const fixint *a, const fixint *b) {
+    if (a->n != b->n) return a->n < b->n ? -1 : 1;
+    return mpn_cmp(a->d, b->d, a->n);
+}
+
+int fixint_cmp_ui(const fixint *a, mp_limb_t v) {
+    if (a->n > 1) return 1;
+    mp_limb_t x = a->n ? a->d[0] : 0;
+    return (x > v) - (x < v);
+}
+
+void fixint_add(fixint *r, const fixint *a, const fixint *b) {
+    if (a->n < b->n) { const fixint *t = a; a = b; b = t; }
+    if (b->n == 0) { if (r != a) *r = *a; return; }
+    mp_limb_t cy = mpn_add(r->d, a->d, a->n, b->d, b->n);
+    r->n = a->n;
+    if (cy) r->d[r->n++] = cy;
+}
+
+void fixint_add_ui(fixint *r, const fixint *a, mp_limb_t v) {
+    if (a->n == 0) { fixint_set_ui(r, v); return; }
+    mp_limb_t cy = mpn_add_1(r->d, a->d, a->n, v);
+    r->n = a->n;
+    if (cy) r->d[r->n++] = cy;
+}
+
+void fixint_sub_ui(fixint *r, const fixint *a, mp_limb_t v) {
+    if (a->n == 0) { r->n = 0; return; }
+    mpn_sub_1(r->d, a->d, a->n, v);
+    r->n = a->n;
+    normalize(r);
+}
+
+void fixint_mul(fixint *r, const fixint *a, const fixint *b) {
+    if (a->n == 0 || b->n == 0) { r->n = 0; return; }
+    if (a->n < b->n) { const fixint *t = a; a = b; b = t; }
+    mp_limb_t t[2 * FIXINT_LIMBS];
+    mpn_mul(t, a->d, a->n, b->d, b->n); // result may not overlap the inputs
+    r->n = a->n + b->n;
+    memcpy(r->d, t, r->n * sizeof(mp_limb_t));
+    normalize(r);
+}
+
+void fixint_mul_ui(fixint *r, const fixint *a, mp_limb_t v) {
+    if (a->n == 0 || v == 0) { r->n = 0; return; }
+    mp_limb_t cy = mpn_mul_1(r->d, a->d, a->n, v);
+    r->n = a->n;
+    if (cy) r->d[r->n++] = cy;
+}
+
+void fixint_mod(fixint *r, const fixint *a, const fixint *m) {
+    if (a->n < m->n) { if (r != a) *r = *a; return; }
+    mp_limb_t q[2 * FIXINT_LIMBS], rem[FIXINT_LIMBS];
+    mpn_tdiv_qr(q, rem, 0, a->d, a->n, m->d, m->n);
+    memcpy(r->d, rem, m->n * sizeof(mp_limb_t));
+    r->n = m->n;
+    normalize(r);
+}
+
+mp_limb_t fixint_mod_ui(const fixint *a, mp_limb_t m) {
+    return a->n ? mpn_mod_1(a->d, a->n, m) : 0;
+}
+
+int fixint_mont_init(fixint_mont *ctx, const fixint *m) {
+    if (m->n == 0 || m->n > FIXINT_LIMBS || !(m->d[0] & 1) || fixint_cmp_ui(m, 3) < 0) return -1;
+    mp_size_t n = m->n;
+    ctx->n = n;
+    memcpy(ctx->m, m->d, n * sizeof(mp_limb_t));
+
+    mp_limb_t inv = m->d[0]; // Newton: 3, 6, 12, 24, 48, 96 correct bits
+    for (int i = 0; i < 5; ++i) inv *= 2 - m->d[0] * inv;
+    ctx->minv = -inv;
+
+    // R mod m and R^2 mod m by division of 2^(64n) and 2^(128n)
+    mp_limb_t num[2 * FIXINT_LIMBS + 1], q[FIXINT_LIMBS + 2];
+    memset(num, 0, sizeof(num));
+    num[n] = 1;
+    mpn_tdiv_qr(q, ctx->one, 0, num, n + 1, ctx->m, n);
+    num[n] = 0;
+    num[2 * n] = 1;
+    mpn_tdiv_qr(q, ctx->rr, 0, num, 2 * n + 1, ctx->m, n);
+    return 0;
+}
+
+// r = a*b/R mod m on n-limb operands (r may alias a or b); each width has its own unrolled kernel
+static void fixmont_mul(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const fixint_mont *ctx) {
+    switch (ctx->n) {
+    case 1: mont_mul_fixed(r, a, b, ctx->m, ctx->minv, 1); return;
+    case 2: mont_mul_fixed(r, a, b, ctx->m, ctx->minv, 2); return;
+    case 3: mont_mul_fixed(r, a, b, ctx->m, ctx->minv, 3); return;
+    case 4: mont_mul_fixed(r, a, b, ctx->m, ctx->minv, 4); return;
+    }
+    mp_size_t n = ctx->n; // only reached if FIXINT_LIMBS is raised past 4
+    mp_limb_t t[2 * FIXINT_LIMBS];
+    if (a == b) mpn_sqr(t, a, n);
+    else mpn_mul_n(t, a, b, n);
+    for (mp_size_t i = 0; i < n; ++i)
+        t[i] = mpn_addmul_1(t + i, ctx->m, n, t[i] * ctx->minv);
+    mp_limb_t cy = mpn_add_n(r, t + n, t, n);
+    if (cy || mpn_cmp(r, ctx->m, n) >= 0) mpn_sub_n(r, r, ctx->m, n);
+}
+
+void fixint_powm(fixint *r, const fixint *b, const fixint *e, const fixint_mont *ctx) {
+    mp_size_t n = ctx->n;
+    mp_limb_t base[FIXINT_LIMBS], acc[FIXINT_LIMBS], table[8][FIXINT_LIMBS], b2[FIXINT_LIMBS];
+
+    // base = (b mod m) in Montgomery form
+    fixint m = { .n = n }, bred;
+    memcpy(m.d, ctx->m, n * sizeof(mp_limb_t));
+    fixint_mod(&bred, b, &m);
+    memset(base, 0, sizeof(base));
+    memcpy(base, bred.d, bred.n * sizeof(mp_limb_t));
+    fixmont_mul(table[0], base, ctx->rr, ctx);
+
+    // sliding window of 4 bits: table[i] = b^(2i+1)
+    fixmont_mul(b2, table[0], table[0], ctx);
+    for (int i = 1; i < 8; ++i) fixmont_mul(table[i], table[i - 1], b2, ctx);
+
+    memcpy(acc, ctx->one, n * sizeof(mp_limb_t));
+    long bits = e->n ? (long)mpn_sizeinbase(e->d, e->n, 2) : 0;
+#define EBIT(i) ((int)(e->d[(i) / GMP_NUMB_BITS] >> ((i) % GMP_NUMB_BITS)) & 1)
+    for (long i = bits - 1; i >= 0;) {
+        if (!EBIT(i)) { fixmont_mul(acc, acc, acc, ctx); --i; continue; }
+        long j = i - 3 < 0 ? 0 : i - 3;
+        while (!EBIT(j)) ++j;
+        unsigned val = 0;
+        for (long k = i; k >= j; --k) { val = val << 1 | EBIT(k); fixmont_mul(acc, acc, acc, ctx); }
+        fixmont_mul(acc, acc, table[val >> 1], ctx);
+        i = j - 1;
+    }
+#undef EBIT
+
+    // out of Montgomery form: multiply by plain 1
+    mp_limb_t one[FIXINT_LIMBS] = { 1 };
+    fixmont_mul(r->d, acc, one, ctx);
+    r->n = n;
+    normalize(r);
+}
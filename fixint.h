@@ -0,0 +1,50 @@
+// fixint.h
+// Stack-resident fixed-width integers for operands of up to FIXINT_LIMBS limbs (256 bits).
+//
+// A fixint is a plain struct with inline limb storage, so temporaries cost nothing to create
+// and the arithmetic below (all built on mpn) never touches the heap. fixint_mpz gives a
+// zero-copy, read-only mpz view for anything that still needs a GMP mpz function.
+
+#ifndef FIXINT_H
+#define FIXINT_H
+
+#include <gmp.h>
+
+#define FIXINT_LIMBS 4 // widest operand; products use up to twice this
+
+typedef struct {
+    mp_limb_t d[2 * FIXINT_LIMBS];
+    mp_size_t n;                    // limbs in use, normalized (0 for zero)
+} fixint;
+
+// Montgomery context for an odd modulus of up to FIXINT_LIMBS limbs
+typedef struct {
+    mp_limb_t m[FIXINT_LIMBS];
+    mp_limb_t one[FIXINT_LIMBS];    // R mod m
+    mp_limb_t rr[FIXINT_LIMBS];     // R^2 mod m
+    mp_limb_t minv;                 // -m^-1 mod 2^GMP_NUMB_BITS
+    mp_size_t n;
+} fixint_mont;
+
+void fixint_set_ui(fixint *r, mp_limb_t v);
+int fixint_set_mpz(fixint *r, const mpz_t a);        // -1 if a < 0 or a is too wide
+void fixint_get_mpz(mpz_t r, const fixint *a);
+mpz_srcptr fixint_mpz(mpz_ptr view, const fixint *a); // read-only view, valid while a is
+
+int fixint_cmp(const fixint *a, const fixint *b);
+int fixint_cmp_ui(const fixint *a, mp_limb_t v);
+
+void fixint_add(fixint *r, const fixint *a, const fixint *b);
+void fixint_add_ui(fixint *r, const fixint *a, mp_limb_t v);
+void fixint_sub_ui(fixint *r, const fixint *a, mp_limb_t v); // a >= v
+void fixint_mul(fixint *r, const fixint *a, const fixint *b);
+void fixint_mul_ui(fixint *r, const fixint *a, mp_limb_t v);
+void fixint_mod(fixint *r, const fixint *a, const fixint *m); // m > 0, at most FIXINT_LIMBS
+mp_limb_t fixint_mod_ui(const fixint *a, mp_limb_t m);
+
+// 0 on success, -1 if m is even, < 3 or wider than FIXINT_LIMBS
+int fixint_mont_init(fixint_mont *ctx, const fixint *m);
+// r = b^e mod m (b is reduced first)
+void fixint_powm(fixint *r, const fixint *b, const fixint *e, const fixint_mont *ctx);
+
+#endif
@@ -0,0 +1,79 @@
+// hugepage.c
+//
+// Every block carries a small header in front of the returned pointer recording how it was
+// obtained, so hugepage_free needs nothing but the pointer.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "hugepage.h"
+
+#define HEADER 64 // keeps the returned pointer 64-byte aligned
+
+struct hp_header {
+    size_t mapped;      // bytes mapped (0 for aligned_alloc)
+    hugepage_kind kind;
+};
+
+static void *finish(void *base, size_t mapped, hugepage_kind kind) {
+    struct hp_header *h = base;
+    h->mapped = mapped;
+    h->kind = kind;
+    return (char *)base + HEADER;
+}
+
+static void *map_pages(size_t size, hugepage_kind kind, int advice) {
+    size_t len = (size + HEADER + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (kind == HUGEPAGE_HUGETLB ? MAP_HUGETLB : 0);
+    void *base = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    if (advice && madvise(base, len, advice) != 0 && kind == HUGEPAGE_THP) {
+        munmap(base, len);
+        return NULL;
+    }
+    return finish(base, len, kind); // anonymous mappings are already zero
+}
+
+static void *small_alloc(size_t size) {
+    size_t len = (size + HEADER + 63) / 64 * 64;
+    void *base = aligned_alloc(64, len);
+    if (!base) return NULL;
+    memset(base, 0, len);
+    return finish(base, 0, HUGEPAGE_NONE);
+}
+
+void *hugepage_alloc(size_t size, hugepage_kind *kind) {
+    void *p = NULL;
+    hugepage_kind k = HUGEPAGE_NONE;
+    if (size >= HUGEPAGE_MIN) {
+        if ((p = map_pages(size, HUGEPAGE_HUGETLB, 0))) k = HUGEPAGE_HUGETLB;
+        else if ((p = map_pages(size, HUGEPAGE_THP, MADV_HUGEPAGE))) k = HUGEPAGE_THP;
+    }
+    if (!p) p = small_alloc(size);
+    if (kind) *kind = k;
+    return p;
+}
+
+void *hugepage_alloc_as(size_t size, hugepage_kind kind) {
+    switch (kind) {
+    case HUGEPAGE_HUGETLB: return map_pages(size, HUGEPAGE_HUGETLB, 0);
+    case HUGEPAGE_THP: return map_pages(size, HUGEPAGE_THP, MADV_HUGEPAGE);
+    default: return map_pages(size, HUGEPAGE_NONE, MADV_NOHUGEPAGE);
+    }
+}
+
+void hugepage_free(void *p) {
+    if (!p) return;
+    struct hp_header *h = (void *)((char *)p - HEADER);
+    if (h->mapped) munmap(h, h->mapped);
+    else free(h);
+}
+
+const char *hugepage_kind_name(hugepage_kind kind) {
+    switch (kind) {
+    case HUGEPAGE_HUGETLB: return "hugetlb";
+    case HUGEPAGE_THP: return "thp";
+    default: return "4k";
+    }
+}
@@ -0,0 +1,35 @@
+// hugepage.h
+// Allocator for large, randomly accessed tables: SoA batches (soa_batch.c), NUMA replicas
+// (numa_topo.c), fixed-base powers (fixedbase.c), all-pairs window tables (allpairs.c) and
+// product/remainder tree levels (smooth.c).
+//
+// Tables of at least HUGEPAGE_MIN bytes are backed by 2 MB pages when the kernel will give
+// them: first explicit MAP_HUGETLB pages, then an anonymous mapping with
+// madvise(MADV_HUGEPAGE) for transparent huge pages, and finally ordinary aligned_alloc.
+// Smaller requests go straight to aligned_alloc. Memory is zeroed and 64-byte aligned.
+
+#ifndef HUGEPAGE_H
+#define HUGEPAGE_H
+
+#include <stddef.h>
+
+#define HUGEPAGE_SIZE (2UL << 20)
+#define HUGEPAGE_MIN  (1UL << 20) // below this a page walk or two is not worth a 2 MB mapping
+
+typedef enum {
+    HUGEPAGE_NONE,    // aligned_alloc
+    HUGEPAGE_THP,     // anonymous mmap + MADV_HUGEPAGE (a hint: the kernel may still use 4 KB)
+    HUGEPAGE_HUGETLB, // reserved hugetlbfs pages
+} hugepage_kind;
+
+// NULL on failure; the kind actually obtained is reported through kind if non-NULL
+void *hugepage_alloc(size_t size, hugepage_kind *kind);
+void hugepage_free(void *p);
+
+// force a backing (HUGEPAGE_NONE maps with MADV_NOHUGEPAGE), for measuring the difference;
+// NULL if that backing is not available
+void *hugepage_alloc_as(size_t size, hugepage_kind kind);
+
+const char *hugepage_kind_name(hugepage_kind kind);
+
+#endif
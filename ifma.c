@@ -0,0 +1,162 @@
+// ifma.c
+//
+// Almost Montgomery multiplication in radix 2^52 (Gueron and Krasnov; the AVX-512 RSA code in
+// OpenSSL works the same way). Row i adds the low halves of a*b[i] and m*y to the accumulator,
+// where y makes its lowest digit vanish; the accumulator then moves down one digit (valignq
+// across the registers) and the high halves, which belong one digit up, land where the low
+// halves just were. Lanes are 64 bits wide and each row adds less than 2^54 to any lane, so
+// up to 80 rows run without carry propagation; that happens once, after the last row.
+
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+#include "ifma.h"
+
+#define IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+#define DIGIT_MASK ((UINT64_C(1) << IFMA_DIGIT_BITS) - 1)
+
+static inline __attribute__((always_inline)) IFMA_TARGET
+void amm(uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *m, uint64_t k0,
+         const int K) {
+    const int V = K / 8;
+    __m512i acc[IFMA_MAX_DIGITS / 8], av[IFMA_MAX_DIGITS / 8], mv[IFMA_MAX_DIGITS / 8];
+    const __m512i zero = _mm512_setzero_si512();
+#pragma GCC unroll 10
+    for (int v = 0; v < V; ++v) {
+        acc[v] = zero;
+        av[v] = _mm512_loadu_si512(a + 8 * v);
+        mv[v] = _mm512_loadu_si512(m + 8 * v);
+    }
+
+    for (int i = 0; i < K; ++i) {
+        __m512i bi = _mm512_set1_epi64((long long)b[i]);
+#pragma GCC unroll 10
+        for (int v = 0; v < V; ++v) acc[v] = _mm512_madd52lo_epu64(acc[v], av[v], bi);
+
+        // y = -acc[0] / m mod 2^52 zeroes the lowest digit; its carry moves down with the rest
+        uint64_t a0 = (uint64_t)_mm_cvtsi128_si64(_mm512_castsi512_si128(acc[0]));
+        uint64_t y = (a0 * k0) & DIGIT_MASK;
+        uint64_t carry = (a0 + ((m[0] * y) & DIGIT_MASK)) >> IFMA_DIGIT_BITS;
+        __m512i yv = _mm512_set1_epi64((long long)y);
+#pragma GCC unroll 10
+        for (int v = 0; v < V; ++v) acc[v] = _mm512_madd52lo_epu64(acc[v], mv[v], yv);
+
+#pragma GCC unroll 10
+        for (int v = 0; v < V; ++v)
+            acc[v] = _mm512_alignr_epi64(v + 1 < V ? acc[v + 1] : zero, acc[v], 1);
+        acc[0] = _mm512_mask_add_epi64(acc[0], 1, acc[0], _mm512_set1_epi64((long long)carry));
+
+#pragma GCC unroll 10
+        for (int v = 0; v < V; ++v) {
+            acc[v] = _mm512_madd52hi_epu64(acc[v], av[v], bi);
+            acc[v] = _mm512_madd52hi_epu64(acc[v], mv[v], yv);
+        }
+    }
+
+    uint64_t t[IFMA_MAX_DIGITS];
+#pragma GCC unroll 10
+    for (int v = 0; v < V; ++v) _mm512_storeu_si512(t + 8 * v, acc[v]);
+    uint64_t carry = 0;
+    for (int j = 0; j < K; ++j) {
+        uint64_t x = t[j] + carry;
+        r[j] = x & DIGIT_MASK;
+        carry = x >> IFMA_DIGIT_BITS;
+    }
+}
+
+#define IFMA_KERNEL(K)                                                                    \
+    static IFMA_TARGET void amm_##K(uint64_t *r, const uint64_t *a, const uint64_t *b,    \
+                                    const uint64_t *m, uint64_t k0) {                     \
+        amm(r, a, b, m, k0, K);                                                           \
+    }
+IFMA_KERNEL(8) IFMA_KERNEL(16) IFMA_KERNEL(24) IFMA_KERNEL(32) IFMA_KERNEL(40)
+IFMA_KERNEL(48) IFMA_KERNEL(56) IFMA_KERNEL(64) IFMA_KERNEL(72) IFMA_KERNEL(80)
+#undef IFMA_KERNEL
+
+static ifma_kernel kernel_for(int k) {
+    static const ifma_kernel kernels[] = { amm_8, amm_16, amm_24, amm_32, amm_40,
+                                           amm_48, amm_56, amm_64, amm_72, amm_80 };
+    return kernels[k / 8 - 1];
+}
+
+int ifma_available(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+}
+
+// a (0 <= a < 2^(52k)) as k digits of 52 bits
+static void to_digits(uint64_t *d, int k, const mpz_t a) {
+    const mp_limb_t *l = mpz_limbs_read(a);
+    size_t n = mpz_size(a);
+    for (int j = 0; j < k; ++j) {
+        size_t bit = (size_t)j * IFMA_DIGIT_BITS, w = bit / GMP_NUMB_BITS, s = bit % GMP_NUMB_BITS;
+        uint64_t x = w < n ? l[w] >> s : 0;
+        if (s + IFMA_DIGIT_BITS > GMP_NUMB_BITS && w + 1 < n) x |= l[w + 1] << (GMP_NUMB_BITS - s);
+        d[j] = x & DIGIT_MASK;
+    }
+}
+
+static void from_digits(mpz_t r, const uint64_t *d, int k) {
+    size_t n = ((size_t)k * IFMA_DIGIT_BITS + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    mp_limb_t *l = mpz_limbs_write(r, n);
+    memset(l, 0, n * sizeof(mp_limb_t));
+    for (int j = 0; j < k; ++j) {
+        size_t bit = (size_t)j * IFMA_DIGIT_BITS, w = bit / GMP_NUMB_BITS, s = bit % GMP_NUMB_BITS;
+        l[w] |= d[j] << s;
+        if (s + IFMA_DIGIT_BITS > GMP_NUMB_BITS) l[w + 1] |= d[j] >> (GMP_NUMB_BITS - s);
+    }
+    while (n > 0 && l[n - 1] == 0) --n;
+    mpz_limbs_finish(r, n);
+}
+
+int ifma_init(ifma_ctx *ctx, const mpz_t m) {
+    if (mpz_even_p(m) || mpz_cmp_ui(m, 3) < 0 || !ifma_available()) return -1;
+    // 4m < R keeps almost-Montgomery results below 2m
+    size_t digits = (mpz_sizeinbase(m, 2) + 2 + IFMA_DIGIT_BITS - 1) / IFMA_DIGIT_BITS;
+    int k = (int)((digits + 7) / 8 * 8);
+    if (k > IFMA_MAX_DIGITS) return -1;
+
+    ctx->k = k;
+    ctx->kernel = kernel_for(k);
+    mpz_init_set(ctx->mz, m);
+    to_digits(ctx->m, k, m);
+    uint64_t inv = ctx->m[0]; // Newton: 3, 6, 12, 24, 48, 96 correct bits
+    for (int i = 0; i < 5; ++i) inv *= 2 - ctx->m[0] * inv;
+    ctx->k0 = -inv & DIGIT_MASK;
+
+    mpz_t t;
+    mpz_init(t);
+    mpz_setbit(t, 2 * (mp_bitcnt_t)k * IFMA_DIGIT_BITS);
+    mpz_mod(t, t, m);
+    to_digits(ctx->rr, k, t);
+    mpz_clear(t);
+    return 0;
+}
+
+void ifma_clear(ifma_ctx *ctx) {
+    mpz_clear(ctx->mz);
+}
+
+void ifma_to(uint64_t *r, const mpz_t a, const ifma_ctx *ctx) {
+    mpz_t t;
+    mpz_init(t);
+    mpz_mod(t, a, ctx->mz);
+    to_digits(r, ctx->k, t);
+    mpz_clear(t);
+    ctx->kernel(r, r, ctx->rr, ctx->m, ctx->k0);
+}
+
+void ifma_from(mpz_t r, const uint64_t *a, const ifma_ctx *ctx) {
+    uint64_t one[IFMA_MAX_DIGITS] = { 1 }, t[IFMA_MAX_DIGITS];
+    ctx->kernel(t, a, one, ctx->m, ctx->k0);
+    from_digits(r, t, ctx->k);
+    if (mpz_cmp(r, ctx->mz) >= 0) mpz_sub(r, r, ctx->mz);
+}
+
+void ifma_mul(uint64_t *r, const uint64_t *a, const uint64_t *b, const ifma_ctx *ctx) {
+    ctx->kernel(r, a, b, ctx->m, ctx->k0);
+}
+
+void ifma_sqr(uint64_t *r, const uint64_t *a, const ifma_ctx *ctx) {
+    ctx->kernel(r, a, a, ctx->m, ctx->k0);
+}
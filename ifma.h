@@ -0,0 +1,56 @@
+// ifma.h
+// Radix-2^52 Montgomery multiplication on AVX-512 IFMA for one operand pair at a time.
+//
+// A single 2048-4096-bit exponentiation is latency-bound on the scalar mulx/adc chain. IFMA
+// (vpmadd52luq / vpmadd52huq) multiplies eight 52-bit digits per instruction and adds the low
+// or high 52 bits of each product into a 64-bit lane, so one row of the product is a handful
+// of independent vector instructions and carries can wait until the end. Values are k digits
+// of 52 bits (k a multiple of 8, R = 2^(52k)); the multiply is "almost Montgomery": inputs and
+// outputs are below 2m rather than m, which 4m < R keeps closed, so nothing is subtracted
+// until ifma_from.
+//
+// The kernels are compiled for AVX-512 with function attributes, so the file builds with the
+// same flags as everything else; ifma_init fails on a CPU without IFMA and callers keep their
+// scalar path (mont_init does this for moduli from IFMA_MIN_BITS up).
+
+#ifndef IFMA_H
+#define IFMA_H
+
+#include <stdint.h>
+#include <gmp.h>
+
+#define IFMA_DIGIT_BITS 52
+#define IFMA_MAX_DIGITS 80  // 4096-bit moduli plus the two bits of headroom
+#define IFMA_MIN_BITS 1024  // narrowest modulus mont_init hands over (./bench ifma)
+
+typedef void (*ifma_kernel)(uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *m,
+                            uint64_t k0);
+
+typedef struct ifma_ctx {
+    int k;                             // 52-bit digits per value, a multiple of 8
+    uint64_t k0;                       // -m^-1 mod 2^52
+    _Alignas(64) uint64_t m[IFMA_MAX_DIGITS];
+    _Alignas(64) uint64_t rr[IFMA_MAX_DIGITS]; // R^2 mod m, converts into Montgomery form
+    mpz_t mz;
+    ifma_kernel kernel;                // compiled for exactly k digits
+} ifma_ctx;
+
+// 1 if this CPU has AVX-512F and AVX-512 IFMA
+int ifma_available(void);
+
+// 0 on success; -1 if m is even or < 3, needs more than IFMA_MAX_DIGITS digits, or the CPU
+// has no IFMA. The context is read-only afterwards.
+int ifma_init(ifma_ctx *ctx, const mpz_t m);
+void ifma_clear(ifma_ctx *ctx);
+
+// to / from Montgomery form (k-digit arrays; ifma_from also does the final subtraction)
+void ifma_to(uint64_t *r, const mpz_t a, const ifma_ctx *ctx);
+void ifma_from(mpz_t r, const uint64_t *a, const ifma_ctx *ctx);
+
+// r = a*b/R mod m up to one multiple of m (inputs and result < 2m); r may alias a or b.
+// ifma_sqr is the same row-by-row pass with b = a: the reduction is interleaved with the
+// rows, so there is no half product to skip as in a schoolbook square.
+void ifma_mul(uint64_t *r, const uint64_t *a, const uint64_t *b, const ifma_ctx *ctx);
+void ifma_sqr(uint64_t *r, const uint64_t *a, const ifma_ctx *ctx);
+
+#endif
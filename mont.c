@@ -0,0 +1,518 @@
+// mont.c
+//
+// Montgomery multiplication on GMP limbs: mpn products followed by a word-by-word REDC,
+// sliding-window exponentiation and two-base (Straus/Shamir) exponentiation. Kernels from
+// mont_fixed.h are compiled for 1-4 limbs (2 for the 30-digit P, 3 for the safe prime), where
+// they beat the mpn product and REDC per multiply; from 8 limbs up GMP's assembly
+// mpn_addmul_1 loops are faster (./bench montfixed), so wider moduli have no kernel.
+// A modulus 2^(64n) - c with small c skips REDC altogether and folds the high half of each
+// product back in (pm_mul_fixed, pm_reduce). From IFMA_MIN_BITS up, on a CPU with AVX-512
+// IFMA, the exponentiations run in radix 2^52 instead (ifma.c); below that, mont_powm is
+// mpz_powm unless the modulus folds.
+
+#include <stdlib.h>
+#include <string.h>
+#include "mont.h"
+#include "mont_fixed.h"
+
+#define MONT_FIXED_KERNEL(N)                                                              \
+    static void mont_mul_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b,        \
+                             const mp_limb_t *m, mp_limb_t minv) {                        \
+        mont_mul_fixed(r, a, b, m, minv, N);                                              \
+    }
+MONT_FIXED_KERNEL(1) MONT_FIXED_KERNEL(2) MONT_FIXED_KERNEL(3) MONT_FIXED_KERNEL(4)
+#undef MONT_FIXED_KERNEL
+
+#define MONT_FIXED1_KERNEL(N)                                                             \
+    static void mont_mul1_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b,       \
+                              const mp_limb_t *m, mp_limb_t minv) {                       \
+        (void)minv;                                                                       \
+        mont_mul_fixed1(r, a, b, m, N);                                                   \
+    }
+MONT_FIXED1_KERNEL(1) MONT_FIXED1_KERNEL(2) MONT_FIXED1_KERNEL(3) MONT_FIXED1_KERNEL(4)
+#undef MONT_FIXED1_KERNEL
+
+#define MONT_PM_KERNEL(N)                                                                 \
+    static void pm_mul_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b,          \
+                           const mp_limb_t *m, mp_limb_t c) {                             \
+        (void)m;                                                                          \
+        pm_mul_fixed(r, a, b, c, N);                                                      \
+    }
+MONT_PM_KERNEL(1) MONT_PM_KERNEL(2) MONT_PM_KERNEL(3) MONT_PM_KERNEL(4)
+#undef MONT_PM_KERNEL
+
+mont_kernel mont_fixed_kernel(mp_size_t n) {
+    switch (n) {
+    case 1: return mont_mul_1;
+    case 2: return mont_mul_2;
+    case 3: return mont_mul_3;
+    case 4: return mont_mul_4;
+    default: return NULL;
+    }
+}
+
+mont_kernel mont_fixed1_kernel(mp_size_t n) {
+    switch (n) {
+    case 1: return mont_mul1_1;
+    case 2: return mont_mul1_2;
+    case 3: return mont_mul1_3;
+    case 4: return mont_mul1_4;
+    default: return NULL;
+    }
+}
+
+mont_kernel mont_pm_kernel(mp_size_t n) {
+    switch (n) {
+    case 1: return pm_mul_1;
+    case 2: return pm_mul_2;
+    case 3: return pm_mul_3;
+    case 4: return pm_mul_4;
+    default: return NULL;
+    }
+}
+
+// -m0^-1 mod 2^64 by Newton iteration (each step doubles the correct low bits)
+static mp_limb_t limb_neg_inverse(mp_limb_t m0) {
+    mp_limb_t inv = m0; // correct to 3 bits for odd m0
+    for (int i = 0; i < 5; ++i) inv *= 2 - m0 * inv;
+    return -inv;
+}
+
+// copy an mpz (0 <= a < m) into n limbs, zero padded
+static void limbs_from_mpz(mp_limb_t *r, const mpz_t a, mp_size_t n) {
+    mp_size_t an = mpz_size(a);
+    if (an) memcpy(r, mpz_limbs_read(a), an * sizeof(mp_limb_t));
+    memset(r + an, 0, (n - an) * sizeof(mp_limb_t));
+}
+
+// c if m = 2^(64n) - c with 0 < c <= MONT_PM_MAX_C, else 0
+static mp_limb_t pseudo_mersenne_c(const mp_limb_t *m, mp_size_t n) {
+    for (mp_size_t i = 1; i < n; ++i)
+        if (m[i] != GMP_NUMB_MAX) return 0;
+    mp_limb_t c = -m[0];
+    return c <= MONT_PM_MAX_C ? c : 0;
+}
+
+static int init(mont_ctx *ctx, const mpz_t m, int allow_pm) {
+    if (mpz_even_p(m) || mpz_cmp_ui(m, 3) < 0) return -1;
+
+    mp_size_t n = mpz_size(m);
+    ctx->n = n;
+    ctx->m = malloc(3 * n * sizeof(mp_limb_t));
+    if (!ctx->m) return -1;
+    ctx->one = ctx->m + n;
+    ctx->rr = ctx->m + 2 * n;
+    mpz_init_set(ctx->mz, m);
+    limbs_from_mpz(ctx->m, m, n);
+    ctx->minv = limb_neg_inverse(ctx->m[0]);
+    ctx->kernel = mont_fixed_kernel(n);
+
+    ctx->ifma = NULL;
+    ctx->pmc = allow_pm ? pseudo_mersenne_c(ctx->m, n) : 0;
+    if (ctx->pmc) { // R = 1: one and rr are plain 1
+        ctx->kernel = mont_pm_kernel(n); // wider: the mpn fold is faster (./bench special)
+        memset(ctx->one, 0, 2 * n * sizeof(mp_limb_t));
+        ctx->one[0] = ctx->rr[0] = 1;
+        return 0;
+    }
+
+    mpz_t t; mpz_init(t);
+    mpz_setbit(t, n * GMP_NUMB_BITS);
+    mpz_mod(t, t, m);
+    limbs_from_mpz(ctx->one, t, n);
+    mpz_mul(t, t, t);
+    mpz_mod(t, t, m);
+    limbs_from_mpz(ctx->rr, t, n);
+    mpz_clear(t);
+
+    if (mpz_sizeinbase(m, 2) >= IFMA_MIN_BITS) { // stays NULL without the instructions
+        ctx->ifma = aligned_alloc(64, sizeof(ifma_ctx));
+        if (ctx->ifma && ifma_init(ctx->ifma, m) != 0) { free(ctx->ifma); ctx->ifma = NULL; }
+    }
+    return 0;
+}
+
+int mont_init(mont_ctx *ctx, const mpz_t m) { return init(ctx, m, 1); }
+int mont_init_redc(mont_ctx *ctx, const mpz_t m) { return init(ctx, m, 0); }
+
+int mont_use_friendly(mont_ctx *ctx) {
+    if (ctx->pmc || ctx->minv != 1 || !mont_fixed1_kernel(ctx->n)) return -1;
+    ctx->kernel = mont_fixed1_kernel(ctx->n);
+    return 0;
+}
+
+void mont_clear(mont_ctx *ctx) {
+    if (ctx->ifma) { ifma_clear(ctx->ifma); free(ctx->ifma); }
+    free(ctx->m);
+    mpz_clear(ctx->mz);
+}
+
+// r = t/R mod m for a 2n-limb t < m*R; t is destroyed
+static void mont_redc(mp_limb_t *r, mp_limb_t *t, const mont_ctx *ctx) {
+    mp_size_t n = ctx->n;
+    for (mp_size_t i = 0; i < n; ++i) {
+        mp_limb_t q = t[i] * ctx->minv;
+        t[i] = mpn_addmul_1(t + i, ctx->m, n, q); // low limb becomes 0: keep the carry there
+    }
+    mp_limb_t cy = mpn_add_n(r, t + n, t, n);
+    if (cy || mpn_cmp(r, ctx->m, n) >= 0) mpn_sub_n(r, r, ctx->m, n);
+}
+
+// r = t mod m for a 2n-limb t < m^2, m = 2^(64n) - c: the mpn form of pm_mul_fixed's folding
+static void pm_reduce(mp_limb_t *r, const mp_limb_t *t, const mont_ctx *ctx) {
+    mp_size_t n = ctx->n;
+    mp_limb_t c = ctx->pmc;
+    mp_limb_t top = mpn_mul_1(r, t + n, n, c);
+    top += mpn_add_n(r, r, t, n);
+    mp_limb_t carry = mpn_add_1(r, r, n, top * c);
+    mp_limb_t d[n];
+    if (mpn_add_1(d, r, n, c) || carry) memcpy(r, d, n * sizeof(mp_limb_t));
+}
+
+void mont_mul(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const mont_ctx *ctx) {
+    if (ctx->kernel) { ctx->kernel(r, a, b, ctx->m, ctx->pmc ? ctx->pmc : ctx->minv); return; }
+    mp_limb_t t[2 * ctx->n];
+    mpn_mul_n(t, a, b, ctx->n);
+    if (ctx->pmc) pm_reduce(r, t, ctx);
+    else mont_redc(r, t, ctx);
+}
+
+void mont_sqr(mp_limb_t *r, const mp_limb_t *a, const mont_ctx *ctx) {
+    if (ctx->kernel) { ctx->kernel(r, a, a, ctx->m, ctx->pmc ? ctx->pmc : ctx->minv); return; }
+    mp_limb_t t[2 * ctx->n];
+    mpn_sqr(t, a, ctx->n);
+    if (ctx->pmc) pm_reduce(r, t, ctx);
+    else mont_redc(r, t, ctx);
+}
+
+void mont_to(mp_limb_t *r, const mpz_t a, const mont_ctx *ctx) {
+    mp_limb_t t[ctx->n];
+    if (mpz_sgn(a) >= 0 && mpz_cmp(a, ctx->mz) < 0) {
+        limbs_from_mpz(t, a, ctx->n);
+    } else {
+        mpz_t red; mpz_init(red);
+        mpz_mod(red, a, ctx->mz);
+        limbs_from_mpz(t, red, ctx->n);
+        mpz_clear(red);
+    }
+    mont_mul(r, t, ctx->rr, ctx);
+}
+
+void mont_from(mpz_t r, const mp_limb_t *a, const mont_ctx *ctx) {
+    mp_size_t n = ctx->n;
+    mp_limb_t t[2 * n];
+    memcpy(t, a, n * sizeof(mp_limb_t));
+    memset(t + n, 0, n * sizeof(mp_limb_t));
+    mp_limb_t *rp = mpz_limbs_write(r, n);
+    if (ctx->pmc) memcpy(rp, a, n * sizeof(mp_limb_t)); // R = 1
+    else mont_redc(rp, t, ctx);
+    mpz_limbs_finish(r, n);
+}
+
+// bit i of an exponent given as limbs (0 past the top)
+static inline int limb_bit(const mp_limb_t *e, size_t en, size_t i) {
+    size_t w = i / GMP_NUMB_BITS;
+    return w < en ? (int)(e[w] >> (i % GMP_NUMB_BITS)) & 1 : 0;
+}
+
+// window width for a sliding-window exponent of the given bit length
+static int window_bits(size_t ebits) {
+    if (ebits <= 24) return 1;
+    if (ebits <= 80) return 3;
+    if (ebits <= 240) return 4;
+    if (ebits <= 672) return 5;
+    return 6;
+}
+
+// mont_powm's window schedule on the radix-2^52 engine
+static void powm_ifma(mpz_t r, const mpz_t b, const mpz_t e, const ifma_ctx *ctx) {
+    int k = ctx->k;
+    size_t ebits = mpz_sizeinbase(e, 2);
+    const mp_limb_t *ep = mpz_limbs_read(e);
+    size_t en = mpz_size(e);
+    int w = window_bits(ebits);
+    uint64_t table[(1 << (w - 1)) * k]; // b, b^3, b^5, ... in Montgomery form
+    uint64_t acc[k], b2[k];
+
+    ifma_to(table, b, ctx);
+    if (w > 1) {
+        ifma_sqr(b2, table, ctx);
+        for (int i = 1; i < (1 << (w - 1)); ++i)
+            ifma_mul(table + i * k, table + (i - 1) * k, b2, ctx);
+    }
+
+    int started = 0;
+    for (long i = (long)ebits - 1; i >= 0;) {
+        if (!limb_bit(ep, en, i)) {
+            if (started) ifma_sqr(acc, acc, ctx);
+            --i;
+            continue;
+        }
+        long j = i - w + 1 < 0 ? 0 : i - w + 1;
+        while (!limb_bit(ep, en, j)) ++j;
+        unsigned long val = 0;
+        for (long q = i; q >= j; --q) val = (val << 1) | limb_bit(ep, en, q);
+
+        if (started) {
+            for (long q = i; q >= j; --q) ifma_sqr(acc, acc, ctx);
+            ifma_mul(acc, acc, table + (val >> 1) * k, ctx);
+        } else {
+            memcpy(acc, table + (val >> 1) * k, k * sizeof(uint64_t));
+            started = 1;
+        }
+        i = j - 1;
+    }
+    ifma_from(r, acc, ctx);
+}
+
+void mont_powm(mpz_t r, const mpz_t b, const mpz_t e, const mont_ctx *ctx) {
+    mp_size_t n = ctx->n;
+    if (mpz_sgn(e) == 0) { mpz_set_ui(r, 1); return; }
+    if (ctx->ifma) { powm_ifma(r, b, e, ctx->ifma); return; }
+    // REDC on limbs never beat mpz_powm (its redc_1/redc_2 loops are assembly), from 1 limb
+    // up to the IFMA range: 15.2 vs 8.6 us at 4 limbs, 109 vs 80 at 8 (./bench montfixed).
+    // Only the folding reduction wins, so only it keeps the ladder below.
+    if (!ctx->pmc) { mpz_powm(r, b, e, ctx->mz); return; }
+
+    size_t ebits = mpz_sizeinbase(e, 2);
+    const mp_limb_t *ep = mpz_limbs_read(e);
+    size_t en = mpz_size(e);
+    int w = window_bits(ebits);
+    mp_limb_t table[(1 << (w - 1)) * n]; // b, b^3, b^5, ... in Montgomery form
+    mp_limb_t acc[n], b2[n];
+
+    mont_to(table, b, ctx);
+    if (w > 1) {
+        mont_sqr(b2, table, ctx);
+        for (int i = 1; i < (1 << (w - 1)); ++i)
+            mont_mul(table + i * n, table + (i - 1) * n, b2, ctx);
+    }
+
+    int started = 0;
+    for (long i = (long)ebits - 1; i >= 0;) {
+        if (!limb_bit(ep, en, i)) {
+            if (started) mont_sqr(acc, acc, ctx);
+            --i;
+            continue;
+        }
+        long j = i - w + 1 < 0 ? 0 : i - w + 1;
+        while (!limb_bit(ep, en, j)) ++j;
+        unsigned long val = 0;
+        for (long k = i; k >= j; --k) val = (val << 1) | limb_bit(ep, en, k);
+
+        if (started) {
+            for (long k = i; k >= j; --k) mont_sqr(acc, acc, ctx);
+            mont_mul(acc, acc, table + (val >> 1) * n, ctx);
+        } else {
+            memcpy(acc, table + (val >> 1) * n, n * sizeof(mp_limb_t));
+            started = 1;
+        }
+        i = j - 1;
+    }
+    mont_from(r, acc, ctx);
+}
+
+// mont_powm2 runs on whichever engine mont_powm would: values are ctx->ifma->k radix-2^52
+// digits when the modulus has an IFMA engine, ctx->n limbs otherwise
+static size_t eng_words(const mont_ctx *ctx) { return ctx->ifma ? (size_t)ctx->ifma->k : (size_t)ctx->n; }
+
+static void eng_to(mp_limb_t *r, const mpz_t a, const mont_ctx *ctx) {
+    if (ctx->ifma) ifma_to(r, a, ctx->ifma);
+    else mont_to(r, a, ctx);
+}
+
+static void eng_from(mpz_t r, const mp_limb_t *a, const mont_ctx *ctx) {
+    if (ctx->ifma) ifma_from(r, a, ctx->ifma);
+    else mont_from(r, a, ctx);
+}
+
+static void eng_mul(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const mont_ctx *ctx) {
+    if (ctx->ifma) ifma_mul(r, a, b, ctx->ifma);
+    else mont_mul(r, a, b, ctx);
+}
+
+static void eng_sqr(mp_limb_t *r, const mp_limb_t *a, const mont_ctx *ctx) {
+    if (ctx->ifma) ifma_sqr(r, a, ctx->ifma);
+    else mont_sqr(r, a, ctx);
+}
+
+// Joint sparse form of (a, b) (Solinas): digits in {-1, 0, 1}, at most half of the digit
+// columns non-zero on average. Digits are written least significant first; returns the length.
+static size_t jsf_recode(signed char *u1, signed char *u2, const mpz_t a, const mpz_t b) {
+    const mp_limb_t *ap = mpz_limbs_read(a), *bp = mpz_limbs_read(b);
+    size_t an = mpz_size(a), bn = mpz_size(b);
+    size_t la = mpz_sizeinbase(a, 2), lb = mpz_sizeinbase(b, 2);
+    int d1 = 0, d2 = 0;
+    size_t len = 0;
+    for (size_t t = 0; t < la || t < lb || d1 || d2; ++t, ++len) {
+        int l1 = (limb_bit(ap, an, t) | limb_bit(ap, an, t + 1) << 1 | limb_bit(ap, an, t + 2) << 2) + d1;
+        int l2 = (limb_bit(bp, bn, t) | limb_bit(bp, bn, t + 1) << 1 | limb_bit(bp, bn, t + 2) << 2) + d2;
+        int v1 = 0, v2 = 0;
+        if (l1 & 1) {
+            v1 = (l1 & 3) == 1 ? 1 : -1;
+            if (((l1 & 7) == 3 || (l1 & 7) == 5) && (l2 & 3) == 2) v1 = -v1;
+        }
+        if (l2 & 1) {
+            v2 = (l2 & 3) == 1 ? 1 : -1;
+            if (((l2 & 7) == 3 || (l2 & 7) == 5) && (l1 & 3) == 2) v2 = -v2;
+        }
+        if (2 * d1 == 1 + v1) d1 = 1 - d1;
+        if (2 * d2 == 1 + v2) d2 = 1 - d2;
+        u1[len] = (signed char)v1;
+        u2[len] = (signed char)v2;
+    }
+    return len;
+}
+
+void mont_powm2(mpz_t r, const mpz_t g1, const mpz_t a, const mpz_t g2, const mpz_t b,
+                const mont_ctx *ctx) {
+    if (!ctx->ifma) { // on limbs the shared squarings lose to two mont_powm (./bench multiexp)
+        mpz_t t1, t2; mpz_inits(t1, t2, NULL);
+        mont_powm(t1, g1, a, ctx);
+        mont_powm(t2, g2, b, ctx);
+        mpz_mul(r, t1, t2);
+        mpz_mod(r, r, ctx->mz);
+        mpz_clears(t1, t2, NULL);
+        return;
+    }
+    size_t n = eng_words(ctx);
+    size_t maxbits = mpz_sizeinbase(a, 2);
+    if (mpz_sizeinbase(b, 2) > maxbits) maxbits = mpz_sizeinbase(b, 2);
+
+    // table[(v1 + 1) * 3 + (v2 + 1)] = g1^v1 * g2^v2; entry 4 is the identity
+    mp_limb_t table[9 * n], acc[n];
+    signed char u1[maxbits + 2], u2[maxbits + 2];
+    size_t len;
+
+    mpz_t inv1, inv2; mpz_inits(inv1, inv2, NULL);
+    int invertible = mpz_invert(inv1, g1, ctx->mz) && mpz_invert(inv2, g2, ctx->mz);
+    eng_to(table + 5 * n, g2, ctx);
+    eng_to(table + 7 * n, g1, ctx);
+    eng_mul(table + 8 * n, table + 7 * n, table + 5 * n, ctx);
+    if (invertible) {
+        eng_to(table + 3 * n, inv2, ctx);
+        eng_to(table + 1 * n, inv1, ctx);
+        eng_mul(table + 0 * n, table + 1 * n, table + 3 * n, ctx);
+        eng_mul(table + 2 * n, table + 1 * n, table + 5 * n, ctx);
+        eng_mul(table + 6 * n, table + 7 * n, table + 3 * n, ctx);
+        len = jsf_recode(u1, u2, a, b);
+    } else {
+        // plain Shamir: binary digits only, no inverses needed
+        const mp_limb_t *ap = mpz_limbs_read(a), *bp = mpz_limbs_read(b);
+        for (len = 0; len < maxbits; ++len) {
+            u1[len] = (signed char)limb_bit(ap, mpz_size(a), len);
+            u2[len] = (signed char)limb_bit(bp, mpz_size(b), len);
+        }
+    }
+    mpz_clears(inv1, inv2, NULL);
+
+    int started = 0;
+    for (size_t t = len; t-- > 0;) {
+        if (started) eng_sqr(acc, acc, ctx);
+        int idx = (u1[t] + 1) * 3 + (u2[t] + 1);
+        if (idx == 4) continue;
+        if (started) eng_mul(acc, acc, table + idx * n, ctx);
+        else { memcpy(acc, table + idx * n, n * sizeof(mp_limb_t)); started = 1; }
+    }
+    if (started) eng_from(r, acc, ctx);
+    else mpz_set_ui(r, 1); // both exponents 0 (m >= 3)
+}
+
+// r = a*b/R mod m for SOA_LANES lanes at once; limb rows of a, b and r are stride words apart
+// and r may alias a or b. x86-64 has no vector 64x64->128 multiply, so each lane is gathered
+// into registers and run through the fixed-width kernel; the lanes are independent, which lets
+// the out-of-order core overlap their carry chains.
+static inline __attribute__((always_inline))
+void mont_mul_lanes_n(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, size_t stride,
+                      const mont_ctx *ctx, const int N, const int PM) {
+    for (int l = 0; l < SOA_LANES; ++l) {
+        mp_limb_t x[MONT_FIXED_MAX_LIMBS], y[MONT_FIXED_MAX_LIMBS];
+        for (int i = 0; i < N; ++i) { x[i] = a[i * stride + l]; y[i] = b[i * stride + l]; }
+        if (PM) pm_mul_fixed(x, x, y, ctx->pmc, N);
+        else mont_mul_fixed(x, x, y, ctx->m, ctx->minv, N);
+        for (int i = 0; i < N; ++i) r[i * stride + l] = x[i];
+    }
+}
+
+// ctx->n <= 4 (mont_powm_soa only sends 2 limbs here)
+static void mont_mul_lanes(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, size_t stride,
+                           const mont_ctx *ctx) {
+    switch (ctx->pmc ? -ctx->n : ctx->n) {
+    case 1: mont_mul_lanes_n(r, a, b, stride, ctx, 1, 0); return;
+    case 2: mont_mul_lanes_n(r, a, b, stride, ctx, 2, 0); return;
+    case 3: mont_mul_lanes_n(r, a, b, stride, ctx, 3, 0); return;
+    case 4: mont_mul_lanes_n(r, a, b, stride, ctx, 4, 0); return;
+    case -1: mont_mul_lanes_n(r, a, b, stride, ctx, 1, 1); return;
+    case -2: mont_mul_lanes_n(r, a, b, stride, ctx, 2, 1); return;
+    case -3: mont_mul_lanes_n(r, a, b, stride, ctx, 3, 1); return;
+    case -4: mont_mul_lanes_n(r, a, b, stride, ctx, 4, 1); return;
+    }
+}
+
+// mont_powm_soa one element at a time: mont_powm on each column, with its IFMA engine if any
+static void powm_soa_columns(soa_batch *r, const soa_batch *b, const mpz_t e, const mont_ctx *ctx) {
+    mp_size_t n = ctx->n;
+    mp_limb_t x[n];
+    mpz_t v, z;
+    mpz_init2(v, n * GMP_NUMB_BITS);
+    for (size_t j = 0; j < b->count; ++j) {
+        for (mp_size_t i = 0; i < n; ++i) x[i] = b->data[i * b->lanes + j];
+        mont_powm(v, mpz_roinit_n(z, x, n), e, ctx);
+        for (mp_size_t i = 0; i < n; ++i) r->data[i * r->lanes + j] = mpz_getlimbn(v, i);
+    }
+    mpz_clear(v);
+    r->count = b->count;
+}
+
+void mont_powm_soa(soa_batch *r, const soa_batch *b, const mpz_t e, const mont_ctx *ctx) {
+    mp_size_t n = ctx->n;
+    // the lanes only break even at 2 limbs: ./bench soa measured 0.90x, 1.06x, 0.60x and
+    // 0.74x of mont_powm per element at 1-4 limbs, so every other width (and from
+    // IFMA_MIN_BITS up, radix 2^52) runs mont_powm per element
+    if (ctx->ifma || n != 2) { powm_soa_columns(r, b, e, ctx); return; }
+    size_t ebits = mpz_sgn(e) ? mpz_sizeinbase(e, 2) : 0;
+    const mp_limb_t *ep = mpz_limbs_read(e);
+    size_t en = mpz_size(e);
+    int w = window_bits(ebits);
+    if (w > 5) w = 5; // the table is SOA_LANES times larger than mont_powm's
+    const size_t S = SOA_LANES;
+    mp_limb_t table[(1 << (w - 1)) * n * S], acc[n * S], b2[n * S], k[n * S];
+
+    for (size_t blk = 0; blk < b->lanes; blk += S) {
+        // R^2 in every lane converts the block into Montgomery form
+        for (mp_size_t i = 0; i < n; ++i)
+            for (size_t l = 0; l < S; ++l) k[i * S + l] = ctx->rr[i];
+        for (mp_size_t i = 0; i < n; ++i)
+            memcpy(acc + i * S, b->data + i * b->lanes + blk, S * sizeof(mp_limb_t));
+        mont_mul_lanes(table, acc, k, S, ctx);
+        if (w > 1) {
+            mont_mul_lanes(b2, table, table, S, ctx);
+            for (int i = 1; i < (1 << (w - 1)); ++i)
+                mont_mul_lanes(table + i * n * S, table + (i - 1) * n * S, b2, S, ctx);
+        }
+
+        for (mp_size_t i = 0; i < n; ++i)
+            for (size_t l = 0; l < S; ++l) acc[i * S + l] = ctx->one[i];
+        for (long i = (long)ebits - 1; i >= 0;) {
+            if (!limb_bit(ep, en, i)) { mont_mul_lanes(acc, acc, acc, S, ctx); --i; continue; }
+            long j = i - w + 1 < 0 ? 0 : i - w + 1;
+            while (!limb_bit(ep, en, j)) ++j;
+            unsigned long val = 0;
+            for (long q = i; q >= j; --q) {
+                val = (val << 1) | limb_bit(ep, en, q);
+                mont_mul_lanes(acc, acc, acc, S, ctx);
+            }
+            mont_mul_lanes(acc, acc, table + (val >> 1) * n * S, S, ctx);
+            i = j - 1;
+        }
+
+        // out of Montgomery form: multiply by plain 1, written straight into r's rows
+        memset(k, 0, sizeof(k));
+        for (size_t l = 0; l < S; ++l) k[l] = 1;
+        mp_limb_t out[n * S];
+        mont_mul_lanes(out, acc, k, S, ctx);
+        for (mp_size_t i = 0; i < n; ++i)
+            memcpy(r->data + i * r->lanes + blk, out + i * S, S * sizeof(mp_limb_t));
+    }
+    r->count = b->count;
+}
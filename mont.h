@@ -0,0 +1,84 @@
+// mont.h
+// Fixed-modulus Montgomery engine shared by the DH programs.
+//
+// A mont_ctx is set up once per odd modulus m (n limbs, R = 2^(64n)); values in Montgomery
+// form are plain n-limb arrays holding a*R mod m. The context is read-only after
+// mont_init, so several threads may use it at once; temporaries live on the caller's stack.
+//
+// A Montgomery-friendly modulus (low limb all ones, so minv = 1; see gen_safe_prime_friendly)
+// can be switched to REDC kernels that use each limb as its own multiplier (mont_use_friendly).
+// A pseudo-Mersenne modulus m = 2^(64n) - c with c < 2^32 (see safeprime_special) is reduced
+// by folding instead: there R = 1, so "Montgomery form" is the plain residue and every
+// function below works unchanged, only cheaper.
+//
+// On a CPU with AVX-512 IFMA, mont_init also sets up a radix-2^52 context (ifma.h) for moduli
+// of IFMA_MIN_BITS and more, and the exponentiations (mont_powm, mont_powm2, mont_powm_soa)
+// run on it; every other function keeps the limbs.
+
+#ifndef MONT_H
+#define MONT_H
+
+#include <gmp.h>
+#include "ifma.h"
+#include "soa_batch.h"
+
+typedef void (*mont_kernel)(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b,
+                            const mp_limb_t *m, mp_limb_t minv);
+
+typedef struct {
+    mp_size_t n;     // limbs in m
+    mp_limb_t *m;    // odd modulus
+    mp_limb_t minv;  // -m^-1 mod 2^GMP_NUMB_BITS
+    mp_limb_t *one;  // R mod m (Montgomery form of 1)
+    mp_limb_t *rr;   // R^2 mod m (converts into Montgomery form)
+    mpz_t mz;        // m as an mpz, for inversion and reduction of inputs
+    mont_kernel kernel; // limb-count specialised multiply (mont_fixed.h), NULL for generic mpn
+    mp_limb_t pmc;   // c if m = 2^(64n) - c is reduced by folding, 0 for REDC
+    ifma_ctx *ifma;  // radix-2^52 AVX-512 IFMA engine the exponentiations hand off to, NULL if none
+} mont_ctx;
+
+// largest c for which mont_init picks the folding reduction
+#define MONT_PM_MAX_C 0xffffffffUL
+
+// kernel compiled for exactly n limbs (1-4), NULL otherwise
+mont_kernel mont_fixed_kernel(mp_size_t n);
+// the same kernels for a Montgomery-friendly m = -1 mod 2^64 (minv = 1)
+mont_kernel mont_fixed1_kernel(mp_size_t n);
+// folding kernel for m = 2^(64n) - c (1-4 limbs; c is passed in place of minv)
+mont_kernel mont_pm_kernel(mp_size_t n);
+
+// 0 on success, -1 if m is even or < 3 or out of memory
+int mont_init(mont_ctx *ctx, const mpz_t m);
+// the same, but always Montgomery REDC even for a pseudo-Mersenne m (for comparisons)
+int mont_init_redc(mont_ctx *ctx, const mpz_t m);
+void mont_clear(mont_ctx *ctx);
+// Switch a Montgomery-friendly m (minv = 1, 1-4 limbs, not folded) to mont_fixed1_kernel:
+// 0 on success, -1 if m does not qualify. mont_init never does this by itself, since
+// ./bench friendly puts the gain within run-to-run noise.
+int mont_use_friendly(mont_ctx *ctx);
+
+// r = a*b/R mod m, r may alias a or b
+void mont_mul(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const mont_ctx *ctx);
+void mont_sqr(mp_limb_t *r, const mp_limb_t *a, const mont_ctx *ctx);
+
+// to / from Montgomery form
+void mont_to(mp_limb_t *r, const mpz_t a, const mont_ctx *ctx);
+void mont_from(mpz_t r, const mp_limb_t *a, const mont_ctx *ctx);
+
+// r = b^e mod m, e >= 0 (sliding window): radix 2^52 with an IFMA engine, the folding
+// kernels for a pseudo-Mersenne m, and mpz_powm for everything else, which is faster there
+void mont_powm(mpz_t r, const mpz_t b, const mpz_t e, const mont_ctx *ctx);
+
+// r = g1^a * g2^b mod m, a, b >= 0. With an IFMA engine: Straus/Shamir with shared squarings,
+// joint sparse form recoding when g1 and g2 are invertible. Without one it is two mont_powm
+// and a product, which the shared squarings do not beat on limbs.
+void mont_powm2(mpz_t r, const mpz_t g1, const mpz_t a, const mpz_t g2, const mpz_t b,
+                const mont_ctx *ctx);
+
+// r[j] = b[j]^e mod m for every element of a structure-of-arrays batch (ctx->n limbs each,
+// every b[j] < m). The exponent is shared, so all lanes follow one square/multiply schedule
+// and each step is a lane-wise multiply over SOA_LANES contiguous limbs. That only breaks even
+// for 2-limb moduli (./bench soa); every other width is mont_powm per element. r may be b.
+void mont_powm_soa(soa_batch *r, const soa_batch *b, const mpz_t e, const mont_ctx *ctx);
+
+#endif
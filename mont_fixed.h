@@ -0,0 +1,132 @@
+// mont_fixed.h
+// Montgomery multiplication specialised on a compile-time limb count.
+//
+// mont_mul_fixed is always inlined with a constant N, so every instantiation gets loops with
+// fixed trip counts that GCC fully unrolls for small N; the carry chains are written with
+// unsigned __int128 and compile to mul/adc sequences. Instantiate it in a small wrapper per
+// width (see MONT_FIXED_KERNEL in mont.c) and pick the wrapper once per modulus. pm_mul_fixed
+// is the same idea for pseudo-Mersenne moduli.
+
+#ifndef MONT_FIXED_H
+#define MONT_FIXED_H
+
+#include <gmp.h>
+
+typedef unsigned __int128 mont_u128;
+
+#define MONT_FIXED_MAX_LIMBS 4 // wider: GMP's mpn loops are faster (./bench montfixed)
+
+// r = a*b/R mod m, N-limb operands < m, minv = -m^-1 mod 2^64 (CIOS: multiply and reduce
+// interleaved limb by limb). r may alias a or b. N <= MONT_FIXED_MAX_LIMBS. With MINV1 the
+// caller guarantees minv = 1 (m = -1 mod 2^64), and the reduction multiplier is t[0] itself.
+static inline __attribute__((always_inline))
+void mont_mul_fixed_q(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b,
+                      const mp_limb_t *m, mp_limb_t minv, const int N, const int MINV1) {
+    mp_limb_t t[MONT_FIXED_MAX_LIMBS + 2]; // constant size: no VLA in the inlined body
+#pragma GCC unroll 8
+    for (int j = 0; j < N + 2; ++j) t[j] = 0;
+
+#pragma GCC unroll 8
+    for (int i = 0; i < N; ++i) {
+        mont_u128 c = 0;
+        mp_limb_t bi = b[i];
+#pragma GCC unroll 8
+        for (int j = 0; j < N; ++j) {
+            c = (mont_u128)a[j] * bi + t[j] + (mp_limb_t)(c >> 64);
+            t[j] = (mp_limb_t)c;
+        }
+        c = (mont_u128)t[N] + (mp_limb_t)(c >> 64);
+        t[N] = (mp_limb_t)c;
+        t[N + 1] = (mp_limb_t)(c >> 64);
+
+        mp_limb_t q = MINV1 ? t[0] : t[0] * minv;
+        c = (mont_u128)q * m[0] + t[0]; // low limb cancels
+#pragma GCC unroll 8
+        for (int j = 1; j < N; ++j) {
+            c = (mont_u128)q * m[j] + t[j] + (mp_limb_t)(c >> 64);
+            t[j - 1] = (mp_limb_t)c;
+        }
+        c = (mont_u128)t[N] + (mp_limb_t)(c >> 64);
+        t[N - 1] = (mp_limb_t)c;
+        t[N] = t[N + 1] + (mp_limb_t)(c >> 64);
+    }
+
+    // t < 2m: one conditional subtraction
+    mp_limb_t borrow = 0, d[MONT_FIXED_MAX_LIMBS];
+#pragma GCC unroll 8
+    for (int j = 0; j < N; ++j) {
+        mont_u128 s = (mont_u128)t[j] - m[j] - borrow;
+        d[j] = (mp_limb_t)s;
+        borrow = (mp_limb_t)(s >> 64) & 1;
+    }
+    int keep_t = t[N] == 0 && borrow; // t < m
+#pragma GCC unroll 8
+    for (int j = 0; j < N; ++j) r[j] = keep_t ? t[j] : d[j];
+}
+
+static inline __attribute__((always_inline))
+void mont_mul_fixed(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b,
+                    const mp_limb_t *m, mp_limb_t minv, const int N) {
+    mont_mul_fixed_q(r, a, b, m, minv, N, 0);
+}
+
+// Montgomery-friendly m (low limb all ones, so -m^-1 mod 2^64 = 1): one multiply less per limb
+static inline __attribute__((always_inline))
+void mont_mul_fixed1(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const mp_limb_t *m,
+                     const int N) {
+    mont_mul_fixed_q(r, a, b, m, 1, N, 1);
+}
+
+// r = a*b mod m for a pseudo-Mersenne m = 2^(64N) - c, c < 2^32, N-limb operands < m.
+// 2^(64N) = c mod m, so the high half of the product folds onto the low half as c times its
+// value, twice, with no division and no Montgomery form. r may alias a or b.
+static inline __attribute__((always_inline))
+void pm_mul_fixed(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, mp_limb_t c, const int N) {
+    mp_limb_t t[2 * MONT_FIXED_MAX_LIMBS];
+#pragma GCC unroll 8
+    for (int j = 0; j < N; ++j) t[j] = 0;
+#pragma GCC unroll 8
+    for (int i = 0; i < N; ++i) {
+        mont_u128 u = 0;
+        mp_limb_t ai = a[i];
+#pragma GCC unroll 8
+        for (int j = 0; j < N; ++j) {
+            u = (mont_u128)ai * b[j] + t[i + j] + (mp_limb_t)(u >> 64);
+            t[i + j] = (mp_limb_t)u;
+        }
+        t[i + N] = (mp_limb_t)(u >> 64);
+    }
+
+    // x = lo + c*hi < (c+1) 2^(64N), then fold the top word once more: x < 2^(64N) + c^2
+    mp_limb_t x[MONT_FIXED_MAX_LIMBS];
+    mont_u128 u = 0;
+#pragma GCC unroll 8
+    for (int j = 0; j < N; ++j) {
+        u = (mont_u128)t[N + j] * c + t[j] + (mp_limb_t)(u >> 64);
+        x[j] = (mp_limb_t)u;
+    }
+    u = (mont_u128)(mp_limb_t)(u >> 64) * c;
+#pragma GCC unroll 8
+    for (int j = 0; j < N; ++j) {
+        u += x[j];
+        x[j] = (mp_limb_t)u;
+        u >>= 64;
+    }
+    mp_limb_t carry = (mp_limb_t)u; // value is x + carry * 2^(64N)
+
+    // With the carry the value minus m is x + c (x < c^2 then, so no overflow). Without it,
+    // x >= m exactly when x + c carries out, and x - m is x + c without that carry.
+    mp_limb_t d[MONT_FIXED_MAX_LIMBS];
+    u = c;
+#pragma GCC unroll 8
+    for (int j = 0; j < N; ++j) {
+        u += x[j];
+        d[j] = (mp_limb_t)u;
+        u >>= 64;
+    }
+    int reduce = carry || (mp_limb_t)u;
+#pragma GCC unroll 8
+    for (int j = 0; j < N; ++j) r[j] = reduce ? d[j] : x[j];
+}
+
+#endif
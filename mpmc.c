@@ -0,0 +1,86 @@
+// mpmc.c
+//
+// D. Vyukov, "Bounded MPMC queue" (1024cores.net). Cell i starts with seq = i. A producer
+// that sees seq == pos owns the cell once it moves head past pos, writes the value and
+// publishes seq = pos + 1; a consumer that sees seq == pos + 1 owns it once it moves tail,
+// reads it and hands it to the next lap with seq = pos + capacity.
+
+#include <stdlib.h>
+#include "mpmc.h"
+
+int mpmc_init(mpmc_ring *q, size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    q->cells = aligned_alloc(64, (cap * sizeof(mpmc_cell) + 63) & ~(size_t)63);
+    if (!q->cells) return -1;
+    q->mask = cap - 1;
+    for (size_t i = 0; i < cap; ++i) atomic_init(&q->cells[i].seq, i);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return 0;
+}
+
+void mpmc_destroy(mpmc_ring *q) {
+    free(q->cells);
+    q->cells = NULL;
+}
+
+// Claim up to n consecutive cells at pos (which races on *counter) whose seq is pos + i + lag,
+// i.e. free (lag 0) for producers or full (lag 1) for consumers. Returns the count, with
+// *at set to the first claimed position; 0 if the cell at the current position is not ready.
+static size_t claim(mpmc_ring *q, atomic_size_t *counter, size_t lag, size_t n, size_t *at) {
+    size_t pos = atomic_load_explicit(counter, memory_order_relaxed);
+    for (;;) {
+        size_t k = 0;
+        while (k < n) {
+            size_t seq = atomic_load_explicit(&q->cells[(pos + k) & q->mask].seq, memory_order_acquire);
+            if (seq != pos + k + lag) break;
+            ++k;
+        }
+        if (k == 0) {
+            size_t seq = atomic_load_explicit(&q->cells[pos & q->mask].seq, memory_order_acquire);
+            if ((ptrdiff_t)(seq - (pos + lag)) < 0) return 0; // full (producers) / empty (consumers)
+            pos = atomic_load_explicit(counter, memory_order_relaxed); // someone else got there
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(counter, &pos, pos + k, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            *at = pos;
+            return k;
+        }
+    }
+}
+
+size_t mpmc_push_n(mpmc_ring *q, const uint64_t *v, size_t n) {
+    size_t pos, k = claim(q, &q->head, 0, n, &pos);
+    for (size_t i = 0; i < k; ++i) {
+        mpmc_cell *c = &q->cells[(pos + i) & q->mask];
+        c->value = v[i];
+        atomic_store_explicit(&c->seq, pos + i + 1, memory_order_release);
+    }
+    return k;
+}
+
+size_t mpmc_pop_n(mpmc_ring *q, uint64_t *v, size_t n) {
+    size_t pos, k = claim(q, &q->tail, 1, n, &pos);
+    for (size_t i = 0; i < k; ++i) {
+        mpmc_cell *c = &q->cells[(pos + i) & q->mask];
+        v[i] = c->value;
+        atomic_store_explicit(&c->seq, pos + i + q->mask + 1, memory_order_release);
+    }
+    return k;
+}
+
+int mpmc_push(mpmc_ring *q, uint64_t v) {
+    return mpmc_push_n(q, &v, 1) ? 0 : -1;
+}
+
+int mpmc_pop(mpmc_ring *q, uint64_t *v) {
+    return mpmc_pop_n(q, v, 1) ? 0 : -1;
+}
+
+size_t mpmc_size(mpmc_ring *q) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    return head - tail <= q->mask + 1 ? head - tail : 0;
+}
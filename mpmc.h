@@ -0,0 +1,44 @@
+// mpmc.h
+// Bounded lock-free multi-producer/multi-consumer ring of 64-bit items (Vyukov's bounded
+// MPMC queue). Every cell carries a sequence number that tells producers and consumers on
+// which lap it is free or full, so a push or pop is one CAS on the shared position plus one
+// store to the cell. The two positions sit on cache lines of their own.
+//
+// Batch operations claim several consecutive cells with a single CAS: one producer's batch
+// lands contiguously and in order, and a consumer may take items from several producers.
+
+#ifndef MPMC_H
+#define MPMC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    atomic_size_t seq; // position this cell is free (seq == pos) or full (seq == pos + 1) for
+    uint64_t value;
+} mpmc_cell;
+
+typedef struct {
+    _Alignas(64) atomic_size_t head; // next position to push
+    _Alignas(64) atomic_size_t tail; // next position to pop
+    _Alignas(64) mpmc_cell *cells;
+    size_t mask; // capacity - 1
+} mpmc_ring;
+
+// capacity is rounded up to a power of two (at least 2); 0 on success, -1 without memory
+int mpmc_init(mpmc_ring *q, size_t capacity);
+void mpmc_destroy(mpmc_ring *q);
+
+// 0 on success, -1 if the ring is full / empty (never blocks)
+int mpmc_push(mpmc_ring *q, uint64_t v);
+int mpmc_pop(mpmc_ring *q, uint64_t *v);
+
+// push / pop up to n items at once; returns how many were moved (0 if full / empty)
+size_t mpmc_push_n(mpmc_ring *q, const uint64_t *v, size_t n);
+size_t mpmc_pop_n(mpmc_ring *q, uint64_t *v, size_t n);
+
+// items currently queued (a snapshot, exact only when nobody is pushing or popping)
+size_t mpmc_size(mpmc_ring *q);
+
+#endif
@@ -0,0 +1,220 @@
+// mr64.c
+//
+// 64-bit Montgomery arithmetic (one REDC per product, via unsigned __int128) and the
+// deterministic Miller-Rabin test on top of it. The batch version runs MR64_LANES independent
+// candidates in lockstep through the same square/multiply schedule: x86-64 has no vector
+// 64x64->128 multiply, so the lanes buy instruction-level parallelism across the scalar
+// multipliers rather than SIMD width. Base 2 doubles under a mask instead of multiplying;
+// the other bases share one schedule of fixed 4-bit windows, each lane multiplying by its
+// own table entry. Nothing in the lanes branches on a lane's data.
+
+#include "mr64.h"
+
+static const uint64_t MR_BASES[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+#define MR_NBASES (sizeof(MR_BASES) / sizeof(MR_BASES[0]))
+
+// stand-in for unused batch lanes: the largest 64-bit prime
+#define FILLER_PRIME 0xFFFFFFFFFFFFFFC5ULL
+
+struct mont64 {
+    uint64_t n, ninv; // n odd, ninv = n^-1 mod 2^64
+    uint64_t one;     // 2^64 mod n
+    uint64_t r2;      // 2^128 mod n, once mont64_r2 has run (base 2 never needs it)
+};
+
+static void mont64_init(struct mont64 *m, uint64_t n) {
+    uint64_t inv = n; // 3 correct bits
+    for (int i = 0; i < 5; ++i) inv *= 2 - n * inv;
+    m->n = n;
+    m->ninv = inv;
+    m->one = (0 - n) % n;
+    m->r2 = 0;
+}
+
+// a 128-bit division: only for candidates that get past base 2
+static void mont64_r2(struct mont64 *m) {
+    m->r2 = (uint64_t)(((unsigned __int128)m->one * m->one) % m->n);
+}
+
+// a mod n without the division in the usual case of a base below n
+static inline uint64_t base_mod(uint64_t a, uint64_t n) {
+    return a < n ? a : a % n;
+}
+
+// t/2^64 mod n for t < n*2^64
+static inline uint64_t redc64(unsigned __int128 t, uint64_t n, uint64_t ninv) {
+    uint64_t q = (uint64_t)t * ninv;
+    uint64_t hi = (uint64_t)(t >> 64);
+    uint64_t qn = (uint64_t)(((unsigned __int128)q * n) >> 64);
+    return hi >= qn ? hi - qn : hi - qn + n;
+}
+
+static inline uint64_t mul64(uint64_t a, uint64_t b, const struct mont64 *m) {
+    return redc64((unsigned __int128)a * b, m->n, m->ninv);
+}
+
+// 2x mod n for x < n, as x - (n - x) when that does not wrap: one comparison, so it
+// compiles to a conditional move instead of a branch on a coin flip
+static inline uint64_t dbl64(uint64_t x, uint64_t n) {
+    uint64_t y = n - x;
+    return x >= y ? x - y : x + x;
+}
+
+// 2^d mod n in Montgomery form, left to right: multiplying by the base 2 is just a doubling
+static uint64_t pow2_mont(uint64_t d, const struct mont64 *m) {
+    uint64_t x = m->one;
+    for (int i = 63 - __builtin_clzll(d); i >= 0; --i) {
+        x = mul64(x, x, m);
+        if ((d >> i) & 1) x = dbl64(x, m->n);
+    }
+    return x;
+}
+
+// 1 = prime, 0 = composite, -1 = no verdict (odd n > 53 without small factors).
+// Constant divisors let the compiler turn every % into a multiply by the reciprocal.
+static int small_verdict(uint64_t n) {
+    if (n < 2) return 0;
+#define SMALL_PRIME(p) if (n % p == 0) return n == p;
+    SMALL_PRIME(2) SMALL_PRIME(3) SMALL_PRIME(5) SMALL_PRIME(7) SMALL_PRIME(11) SMALL_PRIME(13)
+    SMALL_PRIME(17) SMALL_PRIME(19) SMALL_PRIME(23) SMALL_PRIME(29) SMALL_PRIME(31)
+    SMALL_PRIME(37) SMALL_PRIME(41) SMALL_PRIME(43) SMALL_PRIME(47) SMALL_PRIME(53)
+#undef SMALL_PRIME
+    return n < 59 * 59 ? 1 : -1;
+}
+
+int mr64_is_prime(uint64_t n) {
+    int v = small_verdict(n);
+    if (v >= 0) return v;
+
+    struct mont64 m;
+    mont64_init(&m, n);
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+    uint64_t minus_one = n - m.one;
+
+    for (unsigned b = 0; b < MR_NBASES; ++b) {
+        uint64_t a = base_mod(MR_BASES[b], n), x = m.one;
+        if (b == 1) mont64_r2(&m); // past base 2
+        if (a == 0) continue;
+        if (a == 2) {
+            x = pow2_mont(d, &m);
+        } else {
+            uint64_t base = mul64(a, m.r2, &m);
+            for (uint64_t e = d; e; e >>= 1) { // right-to-left: fine for a 64-bit exponent
+                if (e & 1) x = mul64(x, base, &m);
+                base = mul64(base, base, &m);
+            }
+        }
+        if (x == m.one || x == minus_one) continue;
+        int witness = 1;
+        for (int r = 1; r < s && witness; ++r) {
+            x = mul64(x, x, &m);
+            if (x == minus_one) witness = 0;
+        }
+        if (witness) return 0;
+    }
+    return 1;
+}
+
+// MR64_LANES candidates (odd, no small factors) in lockstep over bases [b0, b1);
+// composite[l] is set when lane l fails
+static void mr64_lanes(const uint64_t *n, unsigned char *composite, unsigned b0, unsigned b1) {
+    struct mont64 m[MR64_LANES];
+    uint64_t d[MR64_LANES], minus_one[MR64_LANES];
+    int s[MR64_LANES], smax = 0, dbits = 0;
+
+    for (int l = 0; l < MR64_LANES; ++l) {
+        mont64_init(&m[l], n[l]);
+        if (b1 > 1) mont64_r2(&m[l]); // a base other than 2
+        s[l] = __builtin_ctzll(n[l] - 1);
+        d[l] = (n[l] - 1) >> s[l];
+        minus_one[l] = n[l] - m[l].one;
+        composite[l] = 0;
+        if (s[l] > smax) smax = s[l];
+        int bits = 64 - __builtin_clzll(d[l]);
+        if (bits > dbits) dbits = bits;
+    }
+
+    for (unsigned b = b0; b < b1; ++b) {
+        uint64_t x[MR64_LANES];
+        unsigned char done[MR64_LANES];
+        for (int l = 0; l < MR64_LANES; ++l) done[l] = composite[l] || base_mod(MR_BASES[b], n[l]) == 0;
+        if (MR_BASES[b] == 2) {
+            // left to right, one bit at a time: a set bit only doubles, so it is masked in
+            for (int l = 0; l < MR64_LANES; ++l) x[l] = m[l].one;
+            for (int i = dbits - 1; i >= 0; --i)
+                for (int l = 0; l < MR64_LANES; ++l) {
+                    uint64_t sq = mul64(x[l], x[l], &m[l]);
+                    uint64_t mask = 0 - ((d[l] >> i) & 1);
+                    x[l] = sq ^ ((sq ^ dbl64(sq, n[l])) & mask);
+                }
+        } else {
+            // fixed 4-bit windows: every lane squares four times and then multiplies by its own
+            // table entry (entry 0 is one), so the schedule stays shared without spending a
+            // masked-out multiply on every bit
+            uint64_t table[16][MR64_LANES];
+            for (int l = 0; l < MR64_LANES; ++l) {
+                table[0][l] = m[l].one;
+                table[1][l] = mul64(base_mod(MR_BASES[b], n[l]), m[l].r2, &m[l]);
+            }
+            for (int k = 2; k < 16; ++k)
+                for (int l = 0; l < MR64_LANES; ++l) table[k][l] = mul64(table[k - 1][l], table[1][l], &m[l]);
+            int top = (dbits - 1) / 4 * 4;
+            for (int l = 0; l < MR64_LANES; ++l) x[l] = table[(d[l] >> top) & 15][l];
+            for (int i = top - 4; i >= 0; i -= 4) {
+                for (int k = 0; k < 4; ++k) // all lanes per step: eight independent chains
+                    for (int l = 0; l < MR64_LANES; ++l) x[l] = mul64(x[l], x[l], &m[l]);
+                for (int l = 0; l < MR64_LANES; ++l) x[l] = mul64(x[l], table[(d[l] >> i) & 15][l], &m[l]);
+            }
+        }
+        for (int l = 0; l < MR64_LANES; ++l)
+            if (x[l] == m[l].one || x[l] == minus_one[l]) done[l] = 1;
+        for (int r = 1; r < smax; ++r) {
+            for (int l = 0; l < MR64_LANES; ++l) {
+                if (done[l] || r >= s[l]) continue;
+                x[l] = mul64(x[l], x[l], &m[l]);
+                if (x[l] == minus_one[l]) done[l] = 1;
+            }
+        }
+        for (int l = 0; l < MR64_LANES; ++l)
+            if (!done[l]) composite[l] = 1;
+    }
+}
+
+// run the candidates idx[0..count) through bases [b0, b1) in groups of MR64_LANES;
+// returns how many survived, compacted to the front of idx
+static size_t mr64_pass(const uint64_t *n, size_t *idx, size_t count, unsigned b0, unsigned b1) {
+    uint64_t lane_n[MR64_LANES];
+    unsigned char composite[MR64_LANES];
+    size_t kept = 0;
+
+    for (size_t i = 0; i < count; i += MR64_LANES) {
+        int filled = count - i < MR64_LANES ? (int)(count - i) : MR64_LANES;
+        for (int l = 0; l < MR64_LANES; ++l) lane_n[l] = l < filled ? n[idx[i + l]] : FILLER_PRIME;
+        mr64_lanes(lane_n, composite, b0, b1);
+        for (int l = 0; l < filled; ++l)
+            if (!composite[l]) idx[kept++] = idx[i + l];
+    }
+    return kept;
+}
+
+void mr64_batch(const soa_batch *batch, unsigned char *is_prime) {
+    const uint64_t *n = soa_row(batch, 0);
+    size_t count = batch->count, idx[256];
+
+    // Base 2 alone rejects nearly every composite, so it runs over the whole block first and
+    // the remaining bases only see the survivors: full lanes instead of lanes kept busy by
+    // the odd prime among composites.
+    for (size_t start = 0; start < count; start += 256) {
+        size_t end = count - start < 256 ? count : start + 256, m = 0;
+        for (size_t i = start; i < end; ++i) {
+            int v = small_verdict(n[i]);
+            is_prime[i] = v > 0;
+            if (v < 0) idx[m++] = i;
+        }
+        m = mr64_pass(n, idx, m, 0, 1);
+        m = mr64_pass(n, idx, m, 1, MR_NBASES);
+        for (size_t i = 0; i < m; ++i) is_prime[idx[i]] = 1;
+    }
+}
@@ -0,0 +1,22 @@
+// mr64.h
+// Deterministic Miller-Rabin for word-sized numbers (n < 2^64).
+//
+// Uses the fixed 7-base set {2, 325, 9375, 28178, 450775, 9780504, 1795265022}, which has no
+// strong pseudoprimes below 2^64, so the answer is exact rather than probabilistic.
+
+#ifndef MR64_H
+#define MR64_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "soa_batch.h"
+
+// 1 if n is prime, 0 otherwise
+int mr64_is_prime(uint64_t n);
+
+// is_prime[i] = mr64_is_prime(n[i]) for the n->count candidates of a single-limb batch,
+// MR64_LANES at a time in lockstep
+#define MR64_LANES SOA_LANES
+void mr64_batch(const soa_batch *n, unsigned char *is_prime);
+
+#endif
@@ -0,0 +1,132 @@
+// numa_topo.c
+//
+// Replicas are placed by first touch: a thread pinned to the node's CPUs allocates and fills
+// each copy, so the kernel backs it with that node's memory without needing libnuma.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "numa_topo.h"
+#include "hugepage.h"
+
+static numa_topo topo;
+static pthread_once_t topo_once = PTHREAD_ONCE_INIT;
+static _Thread_local int bound_node = -1;
+
+// parse a cpulist such as "0-3,8-11" into node index idx
+static void read_cpulist(FILE *f, int idx) {
+    int lo, hi;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        int c = fgetc(f);
+        if (c == '-') { if (fscanf(f, "%d", &hi) != 1) break; c = fgetc(f); }
+        for (int cpu = lo; cpu <= hi && cpu < TOPO_MAX_CPUS; ++cpu) {
+            if (cpu < 0) continue;
+            topo.node_of_cpu[cpu] = (short)idx;
+            topo.ncpus[idx]++;
+        }
+        if (c != ',') break;
+    }
+}
+
+static void discover(void) {
+    for (int c = 0; c < TOPO_MAX_CPUS; ++c) topo.node_of_cpu[c] = -1;
+    for (int id = 0; id < 4 * TOPO_MAX_NODES && topo.nnodes < TOPO_MAX_NODES; ++id) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        int idx = topo.nnodes;
+        topo.sysfs_id[idx] = id;
+        topo.ncpus[idx] = 0;
+        read_cpulist(f, idx);
+        fclose(f);
+        if (topo.ncpus[idx] > 0) topo.nnodes++; // memory-only nodes get no workers
+    }
+    if (topo.nnodes == 0) { // no NUMA information: one node with everything
+        topo.nnodes = 1;
+        topo.sysfs_id[0] = 0;
+        topo.ncpus[0] = TOPO_MAX_CPUS;
+        for (int c = 0; c < TOPO_MAX_CPUS; ++c) topo.node_of_cpu[c] = 0;
+    }
+}
+
+const numa_topo *topo_get(void) {
+    pthread_once(&topo_once, discover);
+    return &topo;
+}
+
+int topo_cpu_node(int cpu) {
+    const numa_topo *t = topo_get();
+    if (cpu < 0 || cpu >= TOPO_MAX_CPUS || t->node_of_cpu[cpu] < 0) return 0;
+    return t->node_of_cpu[cpu];
+}
+
+void topo_bind_node(int node) {
+    bound_node = node;
+}
+
+int topo_current_node(void) {
+    if (bound_node >= 0) return bound_node;
+    return topo_cpu_node(sched_getcpu());
+}
+
+struct fill_arg {
+    topo_replica *r;
+    const void *src;
+    int node;
+};
+
+static void *fill_copy(void *p) {
+    struct fill_arg *a = p;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c = 0; c < TOPO_MAX_CPUS && c < CPU_SETSIZE; ++c)
+        if (topo.node_of_cpu[c] == a->node) CPU_SET(c, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // best effort
+    void *copy = hugepage_alloc(a->r->size, NULL);
+    if (copy) memcpy(copy, a->src, a->r->size);
+    a->r->copy[a->node] = copy;
+    return NULL;
+}
+
+int topo_replicate(topo_replica *r, const void *src, size_t size) {
+    const numa_topo *t = topo_get();
+    r->size = size;
+    r->ncopies = t->nnodes;
+    memset(r->copy, 0, sizeof(r->copy));
+
+    if (t->nnodes == 1) {
+        r->copy[0] = hugepage_alloc(size, NULL);
+        if (!r->copy[0]) return -1;
+        memcpy(r->copy[0], src, size);
+        return 0;
+    }
+    struct fill_arg args[TOPO_MAX_NODES];
+    pthread_t tids[TOPO_MAX_NODES];
+    int started[TOPO_MAX_NODES];
+    for (int n = 0; n < t->nnodes; ++n) {
+        args[n] = (struct fill_arg){ r, src, n };
+        started[n] = pthread_create(&tids[n], NULL, fill_copy, &args[n]) == 0;
+        if (!started[n]) fill_copy(&args[n]); // placed wherever this thread runs
+    }
+    for (int n = 0; n < t->nnodes; ++n)
+        if (started[n]) pthread_join(tids[n], NULL);
+    for (int n = 0; n < t->nnodes; ++n)
+        if (!r->copy[n]) { topo_replica_free(r); return -1; }
+    return 0;
+}
+
+void topo_replica_free(topo_replica *r) {
+    for (int n = 0; n < r->ncopies; ++n) hugepage_free(r->copy[n]);
+    memset(r->copy, 0, sizeof(r->copy));
+    r->ncopies = 0;
+}
+
+const void *topo_local(const topo_replica *r) {
+    int n = topo_current_node();
+    return r->copy[n < r->ncopies ? n : 0];
+}
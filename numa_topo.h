@@ -0,0 +1,45 @@
+// numa_topo.h
+// NUMA topology from /sys and per-node replicas of read-only tables.
+//
+// The topology is read once from /sys/devices/system/node/node*/cpulist; machines without that
+// directory (or containers that hide it) look like a single node holding every CPU. A replica
+// is one copy of a table per node, each first touched by a thread running on that node so its
+// pages are local there; topo_local hands back the copy for the calling thread's node.
+
+#ifndef NUMA_TOPO_H
+#define NUMA_TOPO_H
+
+#include <stddef.h>
+
+#define TOPO_MAX_NODES 64
+#define TOPO_MAX_CPUS  1024
+
+typedef struct {
+    int nnodes;                       // nodes that have CPUs, indexed 0 .. nnodes-1
+    int sysfs_id[TOPO_MAX_NODES];     // their numbers under /sys (may be sparse)
+    int ncpus[TOPO_MAX_NODES];        // CPUs on each node
+    short node_of_cpu[TOPO_MAX_CPUS]; // node index of every CPU, -1 if unknown
+} numa_topo;
+
+// discovered on first use, read-only afterwards
+const numa_topo *topo_get(void);
+int topo_cpu_node(int cpu);           // node index of cpu (0 if unknown)
+
+// the node the calling thread works on: the one recorded by topo_bind_node, otherwise the
+// node of the CPU it is running on right now
+void topo_bind_node(int node);
+int topo_current_node(void);
+
+typedef struct {
+    size_t size;
+    int ncopies;
+    void *copy[TOPO_MAX_NODES];
+} topo_replica;
+
+// one copy of src[0..size) per node; 0 on success, -1 on allocation failure
+int topo_replicate(topo_replica *r, const void *src, size_t size);
+void topo_replica_free(topo_replica *r);
+// the copy local to the calling thread's node
+const void *topo_local(const topo_replica *r);
+
+#endif
@@ -0,0 +1,68 @@
+// perfctr.c
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfctr.h"
+
+int perfctr_open(perfctr *c, perfctr_event ev) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    switch (ev) {
+    case PERFCTR_CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PERFCTR_INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PERFCTR_CACHE_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PERFCTR_DTLB_LOAD_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                      PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        break;
+    }
+    c->fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return c->fd < 0 ? -1 : 0;
+}
+
+void perfctr_close(perfctr *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+}
+
+void perfctr_start(perfctr *c) {
+    if (c->fd < 0) return;
+    ioctl(c->fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(c->fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t perfctr_stop(perfctr *c) {
+    uint64_t v = 0;
+    if (c->fd < 0) return 0;
+    ioctl(c->fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(c->fd, &v, sizeof(v)) != sizeof(v)) v = 0;
+    return v;
+}
+
+const char *perfctr_event_name(perfctr_event ev) {
+    switch (ev) {
+    case PERFCTR_CYCLES: return "cycles";
+    case PERFCTR_INSTRUCTIONS: return "instructions";
+    case PERFCTR_CACHE_MISSES: return "cache-misses";
+    case PERFCTR_DTLB_LOAD_MISSES: return "dTLB-load-misses";
+    }
+    return "?";
+}
@@ -0,0 +1,32 @@
+// perfctr.h
+// Hardware performance counters for the benchmarks (Linux perf_event_open).
+//
+// A counter counts user-space events of the calling thread between perfctr_start and
+// perfctr_stop. Opening fails (-1) where perf is unavailable (containers, VMs without a PMU,
+// perf_event_paranoid > 2); callers print "n/a" and carry on.
+
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdint.h>
+
+typedef enum {
+    PERFCTR_CYCLES,
+    PERFCTR_INSTRUCTIONS,
+    PERFCTR_CACHE_MISSES,
+    PERFCTR_DTLB_LOAD_MISSES,
+} perfctr_event;
+
+typedef struct {
+    int fd;
+} perfctr;
+
+int perfctr_open(perfctr *c, perfctr_event ev);
+void perfctr_close(perfctr *c);
+
+void perfctr_start(perfctr *c);
+uint64_t perfctr_stop(perfctr *c); // events since perfctr_start
+
+const char *perfctr_event_name(perfctr_event ev);
+
+#endif
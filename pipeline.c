@@ -0,0 +1,175 @@
+// pipeline.c
+//
+// Waiting on a ring sleeps on the pipeline's condition variable until something moves: a
+// stage reads p->moves before it looks at its rings and sleeps only while it is unchanged,
+// and whatever bumps moves afterwards sees the sleeper and wakes it. Every sleeper then
+// looks again, so one condition serves both directions of every ring.
+
+#include <stdlib.h>
+#include <time.h>
+#include "pipeline.h"
+#include "worksteal.h"
+
+struct runner {
+    pipeline *p;
+    size_t stage;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// something moved: wake every sleeper (sequentially consistent against park's count and check)
+static void moved(pipeline *p) {
+    atomic_fetch_add(&p->moves, 1);
+    if (atomic_load(&p->sleepers) > 0) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_broadcast(&p->moved);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+// sleep until moves is no longer seen (its value before the failed push or pop) or the
+// pipeline stops
+static void park(pipeline *p, unsigned long seen) {
+    pthread_mutex_lock(&p->lock);
+    atomic_fetch_add(&p->sleepers, 1);
+    while (atomic_load(&p->moves) == seen && !pipe_stopped(p))
+        pthread_cond_wait(&p->moved, &p->lock);
+    atomic_fetch_sub(&p->sleepers, 1);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pipe_init(pipeline *p, size_t ring_cap) {
+    p->nstages = 0;
+    p->ring_cap = ring_cap;
+    atomic_init(&p->stop, 0);
+    atomic_init(&p->moves, 0);
+    atomic_init(&p->sleepers, 0);
+}
+
+int pipe_add(pipeline *p, const char *name, pipe_fn fn, void *arg, unsigned threads) {
+    if (p->nstages == PIPE_MAX_STAGES) return -1;
+    pipe_stage *s = &p->stage[p->nstages++];
+    s->name = name;
+    s->fn = fn;
+    s->arg = arg;
+    s->threads = p->nstages == 1 || threads == 0 ? 1 : threads;
+    atomic_init(&s->in, 0);
+    atomic_init(&s->out, 0);
+    atomic_init(&s->waits, 0);
+    atomic_init(&s->busy_ns, 0);
+    atomic_init(&s->running, 0);
+    return 0;
+}
+
+void pipe_stop(pipeline *p) {
+    atomic_store_explicit(&p->stop, 1, memory_order_release);
+    moved(p);
+}
+int pipe_stopped(pipeline *p) { return atomic_load_explicit(&p->stop, memory_order_acquire); }
+
+// push all n survivors downstream, waiting while the ring is full; 0 if stopped first
+static int forward(pipeline *p, size_t i, const uint64_t *items, size_t n) {
+    pipe_stage *s = &p->stage[i];
+    int waited = 0;
+    while (n) {
+        unsigned long seen = atomic_load(&p->moves);
+        size_t k = mpmc_push_n(&p->ring[i], items, n);
+        if (k) moved(p);
+        items += k; n -= k;
+        if (n == 0) break;
+        if (pipe_stopped(p)) return 0;
+        if (!waited) { atomic_fetch_add_explicit(&s->waits, 1, memory_order_relaxed); waited = 1; }
+        park(p, seen);
+    }
+    return 1;
+}
+
+static void stage_task(void *arg) {
+    struct runner *r = arg;
+    pipeline *p = r->p;
+    size_t i = r->stage;
+    pipe_stage *s = &p->stage[i], *up = i ? &p->stage[i - 1] : NULL;
+    int last = i + 1 == p->nstages;
+    uint64_t items[PIPE_BATCH];
+
+    while (!pipe_stopped(p)) {
+        size_t n = 0;
+        if (up) {
+            // moves, then the upstream count, then the ring: an empty ring seen after the
+            // count reached zero really is the end, and a count that reaches zero later bumps
+            // moves, so the sleep below cannot miss it
+            unsigned long seen = atomic_load(&p->moves);
+            unsigned upstream = atomic_load(&up->running);
+            n = mpmc_pop_n(&p->ring[i - 1], items, PIPE_BATCH);
+            if (n == 0) {
+                if (upstream == 0) break;
+                park(p, seen);
+                continue;
+            }
+            moved(p);
+        }
+        uint64_t t0 = now_ns();
+        size_t k = s->fn(p, s->arg, items, n);
+        atomic_fetch_add_explicit(&s->busy_ns, now_ns() - t0, memory_order_relaxed);
+        if (!up && k == 0) break; // source exhausted
+        atomic_fetch_add_explicit(&s->in, up ? n : k, memory_order_relaxed);
+        atomic_fetch_add_explicit(&s->out, k, memory_order_relaxed);
+        if (!last && k && !forward(p, i, items, k)) break;
+    }
+    atomic_fetch_sub(&s->running, 1);
+    moved(p);
+}
+
+int pipe_run(pipeline *p) {
+    size_t rings = 0, total = 0;
+    int rc = 0;
+    for (; rings + 1 < p->nstages; ++rings)
+        if (mpmc_init(&p->ring[rings], p->ring_cap) != 0) { rc = -1; break; }
+    for (size_t i = 0; i < p->nstages; ++i) total += p->stage[i].threads;
+
+    // a scheduler of its own: the stage tasks park on the rings, so on a shared one they could
+    // hold every worker the tasks they wait for need (ws_create nests under a running worker)
+    ws_sched *sched = rc ? NULL : ws_create(total);
+    if (!rc && (!sched || ws_nworkers(sched) < total)) rc = -1; // fewer workers than sleeping tasks
+    struct runner *runners = rc ? NULL : malloc(p->nstages * sizeof(struct runner));
+    if (!runners) rc = -1;
+    if (!rc) {
+        pthread_mutex_init(&p->lock, NULL);
+        pthread_cond_init(&p->moved, NULL);
+        for (size_t i = 0; i < p->nstages; ++i) // all counts up before any task looks
+            atomic_store(&p->stage[i].running, p->stage[i].threads);
+        ws_group g;
+        ws_group_init(&g);
+        size_t last = p->nstages - 1;
+        for (size_t i = 0; i < p->nstages; ++i) {
+            runners[i] = (struct runner){ p, i };
+            for (unsigned t = i == last; t < p->stage[i].threads; ++t)
+                ws_submit(sched, &g, stage_task, &runners[i]);
+        }
+        stage_task(&runners[last]); // the sink ends last, so ws_wait has little left to wait for
+        ws_wait(&g);
+        pthread_cond_destroy(&p->moved);
+        pthread_mutex_destroy(&p->lock);
+    }
+    free(runners);
+    if (sched) ws_destroy(sched);
+    for (size_t i = 0; i < rings; ++i) mpmc_destroy(&p->ring[i]);
+    return rc;
+}
+
+void pipe_report(pipeline *p, FILE *f) {
+    fprintf(f, "%-10s %7s %12s %12s %8s %14s\n", "stage", "threads", "in", "out", "waits", "items/s");
+    for (size_t i = 0; i < p->nstages; ++i) {
+        pipe_stage *s = &p->stage[i];
+        unsigned long long in = atomic_load(&s->in), busy = atomic_load(&s->busy_ns);
+        // busy time is summed over the stage's threads, so busy / threads is its wall time
+        double rate = busy ? (double)in / (busy / 1e9 / s->threads) : 0;
+        fprintf(f, "%-10s %7u %12llu %12llu %8llu %14.0f\n", s->name, s->threads, in,
+                (unsigned long long)atomic_load(&s->out), (unsigned long long)atomic_load(&s->waits),
+                rate);
+    }
+}
@@ -0,0 +1,71 @@
+// pipeline.h
+// Staged candidate pipelines over bounded MPMC rings (mpmc.h).
+//
+// Stage 0 is the source; every later stage takes batches of 64-bit items (candidate offsets)
+// from the ring in front of it, keeps the ones that pass, and pushes the survivors to the
+// ring behind it; the last stage only consumes. Each stage thread is a task on a work-stealing
+// scheduler (worksteal.h). A full ring makes the stage in front of it sleep (backpressure),
+// so a fast sieve never runs more than one ring ahead of the exponentiations, and an empty
+// one makes the stage behind it sleep. A stage ends once everything upstream has ended and
+// its input ring is empty, or at once after pipe_stop.
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mpmc.h"
+
+#define PIPE_MAX_STAGES 4
+#define PIPE_BATCH 64 // items moved through a ring per push / pop
+
+typedef struct pipeline pipeline;
+
+// Source (stage 0): called with n = 0; fill items[0..PIPE_BATCH) and return the count, 0 when
+// there is nothing more. Later stages: items[0..n) came in; move the survivors to the front
+// and return how many there are. Threads of one stage call fn concurrently.
+typedef size_t (*pipe_fn)(pipeline *p, void *arg, uint64_t *items, size_t n);
+
+typedef struct {
+    const char *name;
+    pipe_fn fn;
+    void *arg;
+    unsigned threads;
+    atomic_ullong in, out;  // items taken / passed on
+    atomic_ullong waits;    // times a full output ring held this stage back
+    atomic_ullong busy_ns;  // time spent inside fn, summed over the stage's threads
+    atomic_uint running;    // threads not yet finished
+} pipe_stage;
+
+struct pipeline {
+    size_t nstages;
+    pipe_stage stage[PIPE_MAX_STAGES];
+    mpmc_ring ring[PIPE_MAX_STAGES - 1]; // ring[i] joins stage i to stage i + 1
+    size_t ring_cap;
+    atomic_int stop;
+    atomic_ulong moves;     // bumped by every push, pop, finished stage and pipe_stop
+    atomic_uint sleepers;   // stage threads waiting for moves to change
+    pthread_mutex_t lock;   // held only to sleep on and to signal moved
+    pthread_cond_t moved;
+};
+
+// ring_cap = capacity of each ring between stages
+void pipe_init(pipeline *p, size_t ring_cap);
+// append a stage with 'threads' threads (the source always gets one); 0 or -1 if full
+int pipe_add(pipeline *p, const char *name, pipe_fn fn, void *arg, unsigned threads);
+// Run every stage to completion. The tasks go to a scheduler made for the run with a worker
+// for each stage thread (they sleep rather than return, so they need one each), also when the
+// caller is itself a worker; the caller runs one of the last stage's threads itself.
+// 0 on success, -1 if a ring or the workers could not be set up.
+int pipe_run(pipeline *p);
+// ask every stage to finish now (callable from inside a stage function)
+void pipe_stop(pipeline *p);
+int pipe_stopped(pipeline *p);
+
+// per-stage counters after pipe_run: items in/out, backpressure waits, items per second
+void pipe_report(pipeline *p, FILE *f);
+
+#endif
@@ -0,0 +1,294 @@
+// primroot.c
+//
+// Factoring of p-1 (trial division, then Pollard-Brent rho) and primitive-root tests.
+
+#include <stdint.h>
+#include <pthread.h>
+#include "primroot.h"
+#include "mr64.h"
+#include "numa_topo.h"
+
+#define TRIAL_PRIMES 6541 // odd primes below PRIMROOT_TRIAL_LIMIT
+
+// Odd primes below PRIMROOT_TRIAL_LIMIT, sieved once. Batch mode runs factor_distinct on
+// every worker at the same time, so the table is replicated per NUMA node and each worker
+// reads its own.
+static uint32_t trial_table[TRIAL_PRIMES];
+static topo_replica trial_replica;
+static pthread_once_t trial_once = PTHREAD_ONCE_INIT;
+
+static void trial_init(void) {
+    static unsigned char composite[PRIMROOT_TRIAL_LIMIT];
+    size_t count = 0;
+    for (unsigned long i = 3; i < PRIMROOT_TRIAL_LIMIT; i += 2) {
+        if (composite[i]) continue;
+        trial_table[count++] = (uint32_t)i;
+        for (unsigned long j = i * i; j < PRIMROOT_TRIAL_LIMIT; j += 2 * i) composite[j] = 1;
+    }
+    if (topo_replicate(&trial_replica, trial_table, sizeof(trial_table)) != 0)
+        trial_replica.ncopies = 0; // fall back to the master copy
+}
+
+static const uint32_t *trial_primes(void) {
+    pthread_once(&trial_once, trial_init);
+    return trial_replica.ncopies ? topo_local(&trial_replica) : trial_table;
+}
+
+// record prime f in factors[] unless it is already there
+static void add_factor(mpz_t factors[], size_t *k, const mpz_t f) {
+    for (size_t i = 0; i < *k; ++i)
+        if (mpz_cmp(factors[i], f) == 0) return;
+    mpz_init_set(factors[(*k)++], f);
+}
+
+// Pollard-Brent rho: d = nontrivial factor of odd composite n (polynomial x^2 + c)
+static void rho_brent(mpz_t d, const mpz_t n, unsigned long c) {
+    mpz_t x, y, ys, q, t;
+    mpz_inits(x, y, ys, q, t, NULL);
+    for (;; ++c) {
+        mpz_set_ui(y, 2); mpz_set_ui(q, 1); mpz_set_ui(d, 1);
+        for (unsigned long r = 1; mpz_cmp_ui(d, 1) == 0; r <<= 1) {
+            mpz_set(x, y);
+            for (unsigned long i = 0; i < r; ++i) { mpz_mul(y, y, y); mpz_add_ui(y, y, c); mpz_mod(y, y, n); }
+            for (unsigned long j = 0; j < r && mpz_cmp_ui(d, 1) == 0; j += 128) {
+                mpz_set(ys, y);
+                for (unsigned long i = 0; i < 128 && i < r - j; ++i) {
+                    mpz_mul(y, y, y); mpz_add_ui(y, y, c); mpz_mod(y, y, n);
+                    mpz_sub(t, x, y); mpz_abs(t, t);
+                    mpz_mul(q, q, t); mpz_mod(q, q, n);
+                }
+                mpz_gcd(d, q, n);
+            }
+        }
+        if (mpz_cmp(d, n) == 0) { // batch overshot: redo the last block one step at a time
+            do {
+                mpz_mul(ys, ys, ys); mpz_add_ui(ys, ys, c); mpz_mod(ys, ys, n);
+                mpz_sub(t, x, ys); mpz_abs(t, t);
+                mpz_gcd(d, t, n);
+            } while (mpz_cmp_ui(d, 1) == 0);
+        }
+        if (mpz_cmp(d, n) != 0) break; // otherwise retry with the next c
+    }
+    mpz_clears(x, y, ys, q, t, NULL);
+}
+
+// split n (free of factors below PRIMROOT_TRIAL_LIMIT) into its distinct primes
+static void split_factors(const mpz_t n, mpz_t factors[], size_t *k) {
+    if (mpz_cmp_ui(n, 1) <= 0) return;
+    int prime = mpz_sizeinbase(n, 2) <= 64 ? mr64_is_prime(mpz_get_ui(n)) // exact for one word
+                                           : mpz_probab_prime_p(n, 30) != 0;
+    if (prime) { add_factor(factors, k, n); return; }
+
+    mpz_t d, e; mpz_inits(d, e, NULL);
+    rho_brent(d, n, 1);
+    mpz_divexact(e, n, d);
+    split_factors(d, factors, k);
+    split_factors(e, factors, k);
+    mpz_clears(d, e, NULL);
+}
+
+void factor_begin(factor_state *f, const mpz_t n, mpz_t factors[], size_t *k) {
+    mpz_init_set(f->n, n);
+    f->next = 0;
+    f->done = 0;
+    *k = 0;
+    // factor out 2
+    if (mpz_divisible_ui_p(f->n, 2)) {
+        mpz_init_set_ui(factors[(*k)++], 2);
+        while (mpz_divisible_ui_p(f->n, 2)) mpz_divexact_ui(f->n, f->n, 2);
+    }
+}
+
+int factor_step(factor_state *f, mpz_t factors[], size_t *k, size_t window) {
+    if (f->done) return 1;
+    const uint32_t *primes = trial_primes();
+    // odd trial division by the prime table
+    size_t end = f->next + window < TRIAL_PRIMES ? f->next + window : TRIAL_PRIMES;
+    for (; f->next < end && mpz_cmp_ui(f->n, 1) > 0; ++f->next) {
+        unsigned long p = primes[f->next];
+        if (mpz_divisible_ui_p(f->n, p)) {
+            mpz_init_set_ui(factors[(*k)++], p);
+            while (mpz_divisible_ui_p(f->n, p)) mpz_divexact_ui(f->n, f->n, p);
+        }
+        if (mpz_cmp_ui(f->n, p * p) < 0) { f->next = TRIAL_PRIMES; break; } // 1 or prime left
+    }
+    if (f->next < TRIAL_PRIMES && mpz_cmp_ui(f->n, 1) > 0) return 0;
+    split_factors(f->n, factors, k); // leftover prime, or composite without small factors
+    f->done = 1;
+    return 1;
+}
+
+void factor_end(factor_state *f) {
+    mpz_clear(f->n);
+}
+
+// factor n into distinct prime factors (sufficient for primitive-root test):
+// trial division up to PRIMROOT_TRIAL_LIMIT, then Pollard-Brent rho on the cofactor
+void factor_distinct(mpz_t n, mpz_t factors[], size_t *k) {
+    factor_state f;
+    factor_begin(&f, n, factors, k);
+    factor_step(&f, factors, k, TRIAL_PRIMES);
+    factor_end(&f);
+}
+
+// the same with the smooth part already known (smooth.h): only that part is trial-divided,
+// and it is usually a word or two however large n is
+void factor_distinct_smooth(mpz_t n, const mpz_t smooth, mpz_t factors[], size_t *k) {
+    factor_state f;
+    factor_begin(&f, smooth, factors, k);
+    factor_step(&f, factors, k, TRIAL_PRIMES);
+    factor_end(&f);
+    mpz_t rest; mpz_init(rest);
+    mpz_divexact(rest, n, smooth);
+    split_factors(rest, factors, k);
+    mpz_clear(rest);
+}
+
+// return 1 if g is a primitive root mod p (p prime) given factors of p-1
+int is_generator(const mpz_t g, const mpz_t p, mpz_t factors[], size_t k) {
+    mpz_t p_minus_1, exp, t;
+    mpz_inits(p_minus_1, exp, t, NULL);
+    mpz_sub_ui(p_minus_1, p, 1);
+
+    for (size_t i = 0; i < k; ++i) {
+        mpz_divexact(exp, p_minus_1, factors[i]);
+        mpz_powm(t, g, exp, p);
+        if (mpz_cmp_ui(t, 1) == 0) { // not a generator
+            mpz_clears(p_minus_1, exp, t, NULL);
+            return 0;
+        }
+    }
+    mpz_clears(p_minus_1, exp, t, NULL);
+    return 1;
+}
+
+// return 1 if g (a primitive root mod odd prime p) is still one mod p^2,
+// which by the lifting lemma makes it a primitive root mod p^k for every k >= 2
+int lifts_to_prime_power(const mpz_t g, const mpz_t p) {
+    mpz_t p2, exp, t;
+    mpz_inits(p2, exp, t, NULL);
+    mpz_mul(p2, p, p);
+    mpz_sub_ui(exp, p, 1);
+    mpz_powm(t, g, exp, p2);
+    int lifts = mpz_cmp_ui(t, 1) != 0;
+    mpz_clears(p2, exp, t, NULL);
+    return lifts;
+}
+
+// return 1 if g is a primitive root mod p^k (twice == 0) or mod 2p^k (twice != 0), p an odd prime.
+// Reuses the factors of p-1 from the prime case: phi(p^k) = p^(k-1)(p-1) never needs factoring,
+// the lift to k >= 2 costs one extra exponentiation mod p^2.
+int is_generator_prime_power(const mpz_t g, const mpz_t p, unsigned long k, int twice,
+                             mpz_t factors[], size_t nf) {
+    if (twice && mpz_even_p(g)) return 0; // not a unit mod 2p^k
+
+    mpz_t gp; mpz_init(gp);
+    mpz_mod(gp, g, p);
+    int ok = mpz_sgn(gp) != 0 && is_generator(gp, p, factors, nf);
+    mpz_clear(gp);
+
+    if (ok && k >= 2) ok = lifts_to_prime_power(g, p);
+    return ok;
+}
+
+
+// preorder numbering of the tree over factors [lo, hi): a node's left child follows it,
+// and its right child follows the 2 * (mid - lo) - 1 nodes of the left subtree
+static void tree_prod(primroot_ctx *ctx, mpz_t factors[], size_t lo, size_t hi, size_t node) {
+    if (hi - lo == 1) { mpz_set(ctx->prod[node], factors[lo]); return; }
+    size_t mid = lo + (hi - lo) / 2;
+    tree_prod(ctx, factors, lo, mid, node + 1);
+    tree_prod(ctx, factors, mid, hi, node + 2 * (mid - lo));
+    mpz_mul(ctx->prod[node], ctx->prod[node + 1], ctx->prod[node + 2 * (mid - lo)]);
+}
+
+int primroot_init(primroot_ctx *ctx, const mpz_t p, mpz_t factors[], size_t k) {
+    if (mpz_even_p(p) || mpz_cmp_ui(p, 3) < 0 || k > PRIMROOT_MAX_FACTORS) return -1;
+
+    mpz_t p2; mpz_init(p2);
+    mpz_mul(p2, p, p);
+    mont_init(&ctx->mod_p, p);
+    mont_init(&ctx->mod_p2, p2);
+    mpz_clear(p2);
+
+    mpz_init(ctx->pm1);
+    mpz_sub_ui(ctx->pm1, p, 1);
+    ctx->k = k;
+    for (size_t i = 0; i < k; ++i) {
+        mpz_init(ctx->exps[i]);
+        mpz_divexact(ctx->exps[i], ctx->pm1, factors[i]);
+    }
+    mpz_init_set(ctx->top, ctx->pm1);
+    for (size_t i = 0; i + 1 < 2 * k; ++i) mpz_init(ctx->prod[i]);
+    if (k) {
+        tree_prod(ctx, factors, 0, k, 0);
+        mpz_divexact(ctx->top, ctx->pm1, ctx->prod[0]);
+    }
+    // preallocate for the widest result so the tests never grow them
+    mpz_init2(ctx->g, GMP_NUMB_BITS);
+    mpz_init2(ctx->t, 2 * mpz_sizeinbase(p, 2));
+    for (int d = 0; d < PRIMROOT_TREE_DEPTH; ++d) mpz_init2(ctx->level[d], mpz_sizeinbase(p, 2));
+    return 0;
+}
+
+void primroot_clear(primroot_ctx *ctx) {
+    for (size_t i = 0; i < ctx->k; ++i) mpz_clear(ctx->exps[i]);
+    for (size_t i = 0; i + 1 < 2 * ctx->k; ++i) mpz_clear(ctx->prod[i]);
+    for (int d = 0; d < PRIMROOT_TREE_DEPTH; ++d) mpz_clear(ctx->level[d]);
+    mpz_clears(ctx->pm1, ctx->top, ctx->g, ctx->t, NULL);
+    mont_clear(&ctx->mod_p);
+    mont_clear(&ctx->mod_p2);
+}
+
+// level[d] = g^((p-1)/Q) for the product Q of the q in [lo, hi); 0 as soon as some
+// g^((p-1)/q) is 1 (a 1 anywhere stays 1 all the way down)
+static int tree_test(primroot_ctx *ctx, size_t lo, size_t hi, size_t node, int d) {
+    if (mpz_cmp_ui(ctx->level[d], 1) == 0) return 0;
+    if (hi - lo == 1) return 1;
+    size_t mid = lo + (hi - lo) / 2, right = node + 2 * (mid - lo);
+    // the left half still owes the right half's q, and the other way round
+    mont_powm(ctx->level[d + 1], ctx->level[d], ctx->prod[right], &ctx->mod_p);
+    if (!tree_test(ctx, lo, mid, node + 1, d + 1)) return 0;
+    mont_powm(ctx->level[d + 1], ctx->level[d], ctx->prod[node + 1], &ctx->mod_p);
+    return tree_test(ctx, mid, hi, right, d + 1);
+}
+
+int primroot_test(primroot_ctx *ctx, unsigned long g) {
+    mpz_set_ui(ctx->g, g);
+    if (mpz_divisible_p(ctx->g, ctx->mod_p.mz)) return 0; // not a unit (only for tiny p)
+    if (ctx->k == 0) return 1;
+    mont_powm(ctx->level[0], ctx->g, ctx->top, &ctx->mod_p);
+    return tree_test(ctx, 0, ctx->k, 0, 0);
+}
+
+int primroot_test_soa(primroot_ctx *ctx, const soa_batch *g, unsigned char *is_gen) {
+    mp_size_t n = ctx->mod_p.n;
+    soa_batch t;
+    if (soa_init(&t, n, g->count) != 0) return -1;
+
+    for (size_t j = 0; j < g->count; ++j) { // 0 is not a unit
+        int zero = 1;
+        for (mp_size_t i = 0; i < n; ++i) zero &= soa_row(g, i)[j] == 0;
+        is_gen[j] = !zero;
+    }
+    for (size_t f = 0; f < ctx->k; ++f) {
+        mont_powm_soa(&t, g, ctx->exps[f], &ctx->mod_p);
+        for (size_t j = 0; j < g->count; ++j) {
+            int one = soa_row(&t, 0)[j] == 1;
+            for (mp_size_t i = 1; i < n; ++i) one &= soa_row(&t, i)[j] == 0;
+            if (one) is_gen[j] = 0;
+        }
+    }
+    soa_clear(&t);
+    return 0;
+}
+
+int primroot_test_prime_power(primroot_ctx *ctx, unsigned long g, unsigned long k, int twice) {
+    if (twice && g % 2 == 0) return 0; // not a unit mod 2p^k
+    if (!primroot_test(ctx, g)) return 0;
+    if (k < 2) return 1;
+
+    mpz_set_ui(ctx->g, g);
+    mont_powm(ctx->t, ctx->g, ctx->pm1, &ctx->mod_p2);
+    return mpz_cmp_ui(ctx->t, 1) != 0;
+}
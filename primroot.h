@@ -0,0 +1,70 @@
+// primroot.h
+// Factoring p-1 and testing primitive roots mod a prime p (and mod p^k, 2p^k).
+//
+// is_generator and friends are the one-shot API: every call sets up its own temporaries and
+// runs one full exponentiation per prime factor q of p-1. A primroot_ctx does its set-up once
+// per prime, including a product tree over the q: g^((p-1)/q) for every q then comes from
+// one exponentiation by (p-1)/(q1...qk) followed by raising to the products of subtrees, so
+// each level of the tree costs about one exponentiation instead of each q costing one.
+
+#ifndef PRIMROOT_H
+#define PRIMROOT_H
+
+#include <stddef.h>
+#include <gmp.h>
+#include "mont.h"
+
+// room for the distinct prime factors of p-1 (far more than any p-1 of practical size has)
+#define PRIMROOT_MAX_FACTORS 256
+#define PRIMROOT_TREE_DEPTH 9 // levels of the product tree over PRIMROOT_MAX_FACTORS leaves
+
+// trial division bound; whatever is left of n after that is split with Pollard-Brent rho
+#define PRIMROOT_TRIAL_LIMIT 65536UL
+
+// factor n into distinct prime factors; factors[0..*k) are initialized (n is not needed
+// afterwards; it is left unchanged)
+void factor_distinct(mpz_t n, mpz_t factors[], size_t *k);
+// the same, given smooth = the part of n below PRIMROOT_TRIAL_LIMIT as smooth_batch finds it
+// for a whole batch at once (smooth.h), so that n itself is never trial-divided
+void factor_distinct_smooth(mpz_t n, const mpz_t smooth, mpz_t factors[], size_t *k);
+
+// the same factorisation in slices: factor_step trial-divides by up to window table primes
+// per call and returns 1 once done (the final rho split of the cofactor is one slice)
+typedef struct {
+    mpz_t n;     // cofactor still to split
+    size_t next; // next trial prime
+    int done;
+} factor_state;
+void factor_begin(factor_state *f, const mpz_t n, mpz_t factors[], size_t *k);
+int factor_step(factor_state *f, mpz_t factors[], size_t *k, size_t window);
+void factor_end(factor_state *f);
+
+int is_generator(const mpz_t g, const mpz_t p, mpz_t factors[], size_t k);
+int lifts_to_prime_power(const mpz_t g, const mpz_t p);
+int is_generator_prime_power(const mpz_t g, const mpz_t p, unsigned long k, int twice,
+                             mpz_t factors[], size_t nf);
+
+typedef struct {
+    size_t k;
+    mpz_t exps[PRIMROOT_MAX_FACTORS]; // (p-1)/q for every prime q | p-1
+    mpz_t pm1;                        // p-1, the exponent of the lift check
+    mpz_t top;                        // (p-1)/(q1...qk)
+    mpz_t prod[2 * PRIMROOT_MAX_FACTORS]; // product of each tree node's q, in preorder
+    mpz_t level[PRIMROOT_TREE_DEPTH]; // g^top raised down the tree, one per depth
+    mont_ctx mod_p, mod_p2;           // engines for p and p^2
+    mpz_t g, t;                       // candidate and result, reused by every test
+} primroot_ctx;
+
+// 0 on success, -1 if p is even or < 3. factors are the distinct primes of p-1 (not kept).
+int primroot_init(primroot_ctx *ctx, const mpz_t p, mpz_t factors[], size_t k);
+void primroot_clear(primroot_ctx *ctx);
+
+// 1 if g is a primitive root mod p
+int primroot_test(primroot_ctx *ctx, unsigned long g);
+// 1 if g is a primitive root mod p^k (twice == 0) or 2p^k (twice != 0)
+int primroot_test_prime_power(primroot_ctx *ctx, unsigned long g, unsigned long k, int twice);
+// is_gen[j] = primroot_test on every element of g (ctx->mod_p.n limbs each, reduced mod p),
+// all lanes through each exponent together; 0 on success, -1 on allocation failure
+int primroot_test_soa(primroot_ctx *ctx, const soa_batch *g, unsigned char *is_gen);
+
+#endif
@@ -0,0 +1,410 @@
+// provable.c
+//
+// U. Maurer, "Fast generation of prime numbers and secure public-key cryptographic
+// parameters" (J. Cryptology 1995); NIST FIPS 186-4 appendix C.6 for Shawe-Taylor. The
+// Maurer search walks R upwards from a random start in its interval with the residues of
+// n = 2Rq+1 mod the sieve primes stepped along, as safeprime.c walks r. Shawe-Taylor fixes
+// every candidate through the seed, so there the sieve only skips the exponentiation of a
+// candidate that would fail anyway; the output is exactly the standard's.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "provable.h"
+#include "mr64.h"
+
+#define WORD_BITS 64   // chains bottom out below 2^64, where mr64 is exact
+#define MAURER_MARGIN 20 // bits of R at least, so every interval holds plenty of candidates
+
+// ---------------- certificate ----------------
+
+void prime_cert_init(prime_cert *c) {
+    c->len = c->cap = 0;
+    c->n = c->a = NULL;
+}
+
+void prime_cert_clear(prime_cert *c) {
+    for (size_t i = 0; i < c->cap; ++i) mpz_clears(c->n[i], c->a[i], NULL);
+    free(c->n);
+    free(c->a);
+    prime_cert_init(c);
+}
+
+static int cert_push(prime_cert *c, const mpz_t n, unsigned long a) {
+    if (c->len == c->cap) {
+        size_t cap = c->cap ? 2 * c->cap : 16;
+        mpz_t *nn = realloc(c->n, cap * sizeof(mpz_t));
+        if (!nn) return -1;
+        c->n = nn;
+        mpz_t *aa = realloc(c->a, cap * sizeof(mpz_t));
+        if (!aa) return -1;
+        c->a = aa;
+        for (size_t i = c->cap; i < cap; ++i) mpz_inits(c->n[i], c->a[i], NULL);
+        c->cap = cap;
+    }
+    mpz_set(c->n[c->len], n);
+    mpz_set_ui(c->a[c->len], a);
+    c->len++;
+    return 0;
+}
+
+int prime_cert_verify(const prime_cert *c) {
+    if (c->len == 0 || mpz_sizeinbase(c->n[0], 2) > WORD_BITS || mpz_sgn(c->n[0]) <= 0
+        || !mr64_is_prime(mpz_get_ui(c->n[0])))
+        return 0;
+    mpz_t e, z, t;
+    mpz_inits(e, z, t, NULL);
+    int ok = 1;
+    for (size_t i = 1; i < c->len && ok; ++i) {
+        mpz_srcptr q = c->n[i - 1], n = c->n[i], a = c->a[i];
+        mpz_sub_ui(e, n, 1);
+        mpz_mul(t, q, q);
+        ok = mpz_odd_p(n) && mpz_cmp(t, n) > 0 && mpz_divisible_p(e, q) && mpz_cmp_ui(a, 2) >= 0
+             && mpz_cmp(a, e) < 0;
+        if (!ok) break;
+        mpz_powm(t, a, e, n); // a^(n-1) = 1
+        ok = mpz_cmp_ui(t, 1) == 0;
+        if (!ok) break;
+        mpz_divexact(e, e, q); // gcd(a^((n-1)/q) - 1, n) = 1
+        mpz_powm(z, a, e, n);
+        mpz_sub_ui(z, z, 1);
+        mpz_gcd(t, z, n);
+        ok = mpz_cmp_ui(t, 1) == 0;
+    }
+    mpz_clears(e, z, t, NULL);
+    return ok;
+}
+
+void prime_cert_print(FILE *f, const prime_cert *c) {
+    for (size_t i = 0; i < c->len; ++i) gmp_fprintf(f, "%Zx %Zx\n", c->n[i], c->a[i]);
+}
+
+// ---------------- sieve ----------------
+
+static void sieve_primes(unsigned primes[PROVABLE_SIEVE_PRIMES]) {
+    unsigned count = 0;
+    for (unsigned c = 3; count < PROVABLE_SIEVE_PRIMES; c += 2) {
+        int prime = 1;
+        for (unsigned i = 0; i < count && primes[i] * primes[i] <= c; ++i)
+            if (c % primes[i] == 0) { prime = 0; break; }
+        if (prime) primes[count++] = c;
+    }
+}
+
+// Walk n = 2Rq + 1 over R in (I, 2I], I = floor(2^(bits-1) / 2q), from a random R until n is
+// proven prime with witness *a (and, with safe, 2n+1 is prime as well). q is prime, q^2 > 2^bits.
+static void pocklington_search(mpz_t n, unsigned long *a, const mpz_t q, unsigned bits, int safe,
+                               drbg *rng, const unsigned *primes) {
+    unsigned res[PROVABLE_SIEVE_PRIMES], step[PROVABLE_SIEVE_PRIMES];
+    mpz_t I, R, q2, z, w, P;
+    mpz_inits(I, R, q2, z, w, P, NULL);
+    mpz_mul_2exp(q2, q, 1);
+    mpz_setbit(I, bits - 1);
+    mpz_fdiv_q(I, I, q2);
+    drbg_urandomm(R, rng, I);
+    mpz_add(R, R, I);
+    mpz_add_ui(R, R, 1);
+    for (unsigned i = 0; i < PROVABLE_SIEVE_PRIMES; ++i) step[i] = (unsigned)mpz_fdiv_ui(q2, primes[i]);
+
+    for (int restart = 1;; ) {
+        if (restart) { // n and its residues from R
+            mpz_mul(n, R, q2);
+            mpz_add_ui(n, n, 1);
+            for (unsigned i = 0; i < PROVABLE_SIEVE_PRIMES; ++i) res[i] = (unsigned)mpz_fdiv_ui(n, primes[i]);
+            restart = 0;
+        }
+        int sieved = 1;
+        for (unsigned i = 0; i < PROVABLE_SIEVE_PRIMES && sieved; ++i)
+            sieved = res[i] != 0 && (!safe || (2 * res[i] + 1) % primes[i] != 0);
+
+        if (sieved) {
+            // z = a^(2R) and z^q = a^(n-1): the Fermat test and the Pocklington power in one
+            for (unsigned long b = 2; b < 64; ++b) {
+                mpz_set_ui(w, b);
+                mpz_mul_2exp(z, R, 1);
+                mpz_powm(z, w, z, n);
+                mpz_powm(w, z, q, n);
+                if (mpz_cmp_ui(w, 1) != 0) break; // composite
+                if (safe && b == 2) { // P = 2n+1 passes the Fermat test too (proven once n is)
+                    mpz_mul_2exp(P, n, 1);
+                    mpz_add_ui(P, P, 1);
+                    mpz_set_ui(w, 2);
+                    mpz_powm(w, w, n, P); // 2^(P-1) = (2^n)^2
+                    mpz_mul(w, w, w);
+                    mpz_mod(w, w, P);
+                    if (mpz_cmp_ui(w, 1) != 0) break;
+                }
+                mpz_sub_ui(z, z, 1);
+                mpz_gcd(w, z, n);
+                if (mpz_cmp_ui(w, 1) == 0) {
+                    *a = b;
+                    mpz_clears(I, R, q2, z, w, P, NULL);
+                    return;
+                }
+            }
+        }
+
+        mpz_add_ui(R, R, 1);
+        mpz_add(n, n, q2);
+        for (unsigned i = 0; i < PROVABLE_SIEVE_PRIMES; ++i) {
+            res[i] += step[i];
+            if (res[i] >= primes[i]) res[i] -= primes[i];
+        }
+        if (mpz_sizeinbase(n, 2) > bits) { // past 2I: back to I + 1
+            mpz_add_ui(R, I, 1);
+            restart = 1;
+        }
+    }
+}
+
+// ---------------- Maurer ----------------
+
+static void maurer(mpz_t p, unsigned bits, drbg *rng, prime_cert *cert, const unsigned *primes) {
+    if (bits <= WORD_BITS) {
+        uint64_t x;
+        do {
+            x = drbg_u64(rng);
+            if (bits < 64) x &= ((uint64_t)1 << bits) - 1;
+            x |= (uint64_t)1 << (bits - 1) | 1;
+        } while (!mr64_is_prime(x));
+        mpz_set_ui(p, x);
+        cert_push(cert, p, 0);
+        return;
+    }
+    // relative size of q: r = 2^(s-1), s uniform in [0, 1), as Maurer draws it (2^s by its
+    // Taylor series, no libm), kept between half the bits plus one (q^2 > n) and all but
+    // MAURER_MARGIN of them
+    double s = (double)(drbg_u64(rng) >> 11) / (double)(1ULL << 53);
+    double r = 0.5 * (1 + s * (0.6931472 + s * (0.2402265 + s * (0.0555041 + s * 0.0096181))));
+    unsigned qbits = (unsigned)(bits * r);
+    if (qbits < (bits + 1) / 2 + 1) qbits = (bits + 1) / 2 + 1;
+    if (qbits > bits - MAURER_MARGIN) qbits = bits - MAURER_MARGIN;
+
+    mpz_t q;
+    mpz_init(q);
+    maurer(q, qbits, rng, cert, primes);
+    unsigned long a;
+    pocklington_search(p, &a, q, bits, 0, rng, primes);
+    cert_push(cert, p, a);
+    mpz_clear(q);
+}
+
+int provable_prime_maurer(mpz_t p, unsigned bits, drbg *rng, prime_cert *cert) {
+    if (bits < 2) return -1;
+    unsigned primes[PROVABLE_SIEVE_PRIMES];
+    sieve_primes(primes);
+    cert->len = 0;
+    maurer(p, bits, rng, cert, primes);
+    return 0;
+}
+
+// ---------------- Shawe-Taylor ----------------
+
+// SHA-256 (FIPS 180-4), the hash C.6 is run with here
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR32(x, n) ((x) >> (n) | (x) << (32 - (n)))
+
+static void sha256_block(uint32_t h[8], const unsigned char *p) {
+    uint32_t w[64], s[8];
+    for (int i = 0; i < 16; ++i)
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ w[i - 15] >> 3;
+        uint32_t s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ w[i - 2] >> 10;
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    memcpy(s, h, sizeof(s));
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = s[7] + (ROR32(s[4], 6) ^ ROR32(s[4], 11) ^ ROR32(s[4], 25))
+                      + ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROR32(s[0], 2) ^ ROR32(s[0], 13) ^ ROR32(s[0], 22))
+                      + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(s + 1, s, 7 * sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; ++i) h[i] += s[i];
+}
+
+static void sha256(unsigned char out[32], const unsigned char *msg, size_t len) {
+    uint32_t h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    unsigned char tail[128] = { 0 };
+    size_t full = len / 64 * 64, rest = len - full;
+    for (size_t off = 0; off < full; off += 64) sha256_block(h, msg + off);
+    memcpy(tail, msg + full, rest);
+    tail[rest] = 0x80;
+    size_t tlen = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; ++i) tail[tlen - 1 - i] = (unsigned char)(bits >> (8 * i));
+    for (size_t off = 0; off < tlen; off += 64) sha256_block(h, tail + off);
+    for (int i = 0; i < 8; ++i)
+        for (int j = 0; j < 4; ++j) out[4 * i + j] = (unsigned char)(h[i] >> (24 - 8 * j));
+}
+
+#define ST_OUTLEN 256
+
+// v (0 <= v < 2^(8 len)) as len big-endian bytes
+static void put_be(unsigned char *buf, size_t len, const mpz_t v) {
+    size_t count;
+    memset(buf, 0, len);
+    if (mpz_sgn(v)) mpz_export(buf + len - mpz_sizeinbase(v, 256), &count, 1, 1, 0, 0, v);
+}
+
+typedef struct {
+    mpz_t seed;          // prime_seed, an integer of seedlen bytes
+    size_t seedlen;
+    unsigned char *buf;  // seedlen bytes
+    unsigned long counter; // prime_gen_counter
+    prime_cert *cert;
+    const unsigned *primes;
+    mpz_t t, h;          // scratch for st_hash
+} st_state;
+
+// h += Hash(prime_seed + i) << shift, with the sum taken mod 2^(8 seedlen)
+static void st_hash(st_state *st, mpz_t h, unsigned long i, mp_bitcnt_t shift) {
+    unsigned char d[32];
+    mpz_add_ui(st->t, st->seed, i);
+    mpz_tdiv_r_2exp(st->t, st->t, 8 * st->seedlen);
+    put_be(st->buf, st->seedlen, st->t);
+    sha256(d, st->buf, st->seedlen);
+    mpz_import(st->t, 32, 1, 1, 0, 0, d);
+    mpz_mul_2exp(st->t, st->t, shift);
+    mpz_add(h, h, st->t);
+}
+
+// Hash(prime_seed) || ... || Hash(prime_seed + iterations) as an integer, then prime_seed
+// moves past them (steps 19-20 and 27-28)
+static void st_hash_run(st_state *st, mpz_t x, unsigned long iterations) {
+    mpz_set_ui(x, 0);
+    for (unsigned long i = 0; i <= iterations; ++i) st_hash(st, x, i, i * ST_OUTLEN);
+    mpz_add_ui(st->seed, st->seed, iterations + 1);
+}
+
+static int has_small_factor(const mpz_t c, const unsigned *primes) {
+    for (unsigned i = 0; i < PROVABLE_SIEVE_PRIMES; ++i)
+        if (mpz_divisible_ui_p(c, primes[i])) return 1;
+    return 0;
+}
+
+// ST_Random_Prime, steps 1-34; prime_seed and prime_gen_counter live in st
+static int st_random_prime(mpz_t c, unsigned length, st_state *st) {
+    if (length < 2) return -1;
+    if (length < 33) { // steps 3-13
+        st->counter = 0;
+        for (;;) {
+            mpz_set_ui(st->h, 0);
+            mpz_set_ui(c, 0);
+            st_hash(st, st->h, 0, 0);
+            st_hash(st, c, 1, 0);
+            mpz_xor(c, c, st->h);
+            mpz_tdiv_r_2exp(c, c, length - 1);
+            mpz_setbit(c, length - 1);
+            mpz_setbit(c, 0);
+            st->counter++;
+            mpz_add_ui(st->seed, st->seed, 2);
+            if (mr64_is_prime(mpz_get_ui(c))) { // exact below 2^64, as trial division is
+                cert_push(st->cert, c, 0);
+                return 0;
+            }
+            if (st->counter > 4ul * length) return -1;
+        }
+    }
+
+    mpz_t c0, x, t, a, z, e;
+    int rc = -1;
+    mpz_inits(c0, x, t, a, z, e, NULL);
+    if (st_random_prime(c0, (length + 1) / 2 + 1, st) != 0) goto done;
+    unsigned long iterations = (length + ST_OUTLEN - 1) / ST_OUTLEN - 1;
+    unsigned long old_counter = st->counter;
+    st_hash_run(st, x, iterations);
+    mpz_tdiv_r_2exp(x, x, length - 1);
+    mpz_setbit(x, length - 1);
+    mpz_mul_2exp(e, c0, 1); // 2 c0
+    mpz_cdiv_q(t, x, e);
+    for (;;) {
+        mpz_mul(c, t, e); // step 23: wrap back to the bottom of the range
+        mpz_add_ui(c, c, 1);
+        if (mpz_sizeinbase(c, 2) > length) {
+            mpz_set_ui(t, 0);
+            mpz_setbit(t, length - 1);
+            mpz_cdiv_q(t, t, e);
+            mpz_mul(c, t, e);
+            mpz_add_ui(c, c, 1);
+        }
+        st->counter++;
+        st_hash_run(st, a, iterations); // steps 26-29 run whether or not c is worth testing
+        mpz_sub_ui(z, c, 3);
+        mpz_mod(a, a, z);
+        mpz_add_ui(a, a, 2);
+        if (!has_small_factor(c, st->primes)) {
+            mpz_mul_2exp(z, t, 1); // z = a^(2t), then z^c0 = a^(c-1)
+            mpz_powm(z, a, z, c);
+            mpz_sub_ui(x, z, 1);
+            mpz_gcd(x, x, c);
+            if (mpz_cmp_ui(x, 1) == 0) {
+                mpz_powm(x, z, c0, c);
+                if (mpz_cmp_ui(x, 1) == 0) {
+                    cert_push(st->cert, c, 0);
+                    mpz_set(st->cert->a[st->cert->len - 1], a);
+                    rc = 0;
+                    break;
+                }
+            }
+        }
+        if (st->counter >= 4ul * length + old_counter) break;
+        mpz_add_ui(t, t, 1);
+    }
+done:
+    mpz_clears(c0, x, t, a, z, e, NULL);
+    return rc;
+}
+
+int provable_prime_shawe_taylor(mpz_t p, unsigned bits, const unsigned char *seed, size_t seedlen,
+                                prime_cert *cert, unsigned char *seed_out, unsigned long *counter) {
+    if (seedlen == 0) return -1;
+    unsigned primes[PROVABLE_SIEVE_PRIMES];
+    sieve_primes(primes);
+    st_state st = { .seedlen = seedlen, .cert = cert, .primes = primes };
+    if (!(st.buf = malloc(seedlen))) return -1;
+    mpz_inits(st.seed, st.t, st.h, NULL);
+    mpz_import(st.seed, seedlen, 1, 1, 0, 0, seed);
+    cert->len = 0;
+    int rc = st_random_prime(p, bits, &st);
+    if (rc == 0) {
+        mpz_tdiv_r_2exp(st.seed, st.seed, 8 * seedlen);
+        if (seed_out) put_be(seed_out, seedlen, st.seed);
+        if (counter) *counter = st.counter;
+    }
+    mpz_clears(st.seed, st.t, st.h, NULL);
+    free(st.buf);
+    return rc;
+}
+
+int provable_safe_prime(mpz_t P, mpz_t r, unsigned bits, drbg *rng, prime_cert *cert) {
+    if (bits < WORD_BITS + 2 * MAURER_MARGIN) return -1; // r must sit on a proven q
+    unsigned primes[PROVABLE_SIEVE_PRIMES];
+    sieve_primes(primes);
+    cert->len = 0;
+    mpz_t q;
+    mpz_init(q);
+    maurer(q, bits / 2 + 1, rng, cert, primes); // q^2 > r, r of bits - 1 bits
+    unsigned long a;
+    pocklington_search(r, &a, q, bits - 1, 1, rng, primes);
+    cert_push(cert, r, a);
+    mpz_mul_2exp(P, r, 1);
+    mpz_add_ui(P, P, 1);
+    cert_push(cert, P, 2);
+    mpz_clear(q);
+    return 0;
+}
@@ -0,0 +1,50 @@
+// provable.h
+// Provable prime generation: Maurer's recursive method and the Shawe-Taylor construction of
+// FIPS 186-4 (appendix C.6), each returning its Pocklington chain as a certificate.
+//
+// Both build a prime n = 2Rq + 1 on top of a smaller prime q > sqrt(n) proven the same way,
+// down to a word-sized base. Pocklington's theorem then needs one witness per step:
+// a^(n-1) = 1 (mod n) and gcd(a^((n-1)/q) - 1, n) = 1 prove n prime. Candidates are sieved by
+// small primes before the exponentiation, so a proven prime costs about what a probabilistic
+// one does; the proof is a by-product of the test that accepts it.
+
+#ifndef PROVABLE_H
+#define PROVABLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <gmp.h>
+#include "drbg.h"
+
+// small odd primes that candidates are sieved by
+#define PROVABLE_SIEVE_PRIMES 1024
+
+// Pocklington chain: n[0] < 2^64 is prime by deterministic Miller-Rabin (mr64.h); for i > 0,
+// n[i-1] divides n[i] - 1, n[i-1]^2 > n[i], and a[i] is the witness (a[0] is unused).
+typedef struct {
+    size_t len, cap;
+    mpz_t *n, *a;
+} prime_cert;
+
+void prime_cert_init(prime_cert *c);
+void prime_cert_clear(prime_cert *c);
+// 1 if every step of the chain holds (then n[len-1] is prime), 0 otherwise
+int prime_cert_verify(const prime_cert *c);
+// one line per step: "n a" in hex, base first
+void prime_cert_print(FILE *f, const prime_cert *c);
+
+// Maurer: a random prime of exactly 'bits' bits (bits >= 2) with its chain; 0 on success
+int provable_prime_maurer(mpz_t p, unsigned bits, drbg *rng, prime_cert *cert);
+
+// FIPS 186-4 C.6 ST_Random_Prime with SHA-256: the prime of 'bits' bits determined by the
+// seed (seedlen bytes, big-endian). *seed_out (seedlen bytes, may be NULL) and *counter (may
+// be NULL) are prime_seed and prime_gen_counter of the standard. 0 on success, -1 on the
+// standard's failure exits.
+int provable_prime_shawe_taylor(mpz_t p, unsigned bits, const unsigned char *seed, size_t seedlen,
+                                prime_cert *cert, unsigned char *seed_out, unsigned long *counter);
+
+// Safe prime P = 2r+1 of 'bits' bits with r proven by its Maurer chain and P by one more
+// step on top of r (the chain ends r, P); 0 on success
+int provable_safe_prime(mpz_t P, mpz_t r, unsigned bits, drbg *rng, prime_cert *cert);
+
+#endif
@@ -1,9 +1,12 @@
 // https://www.geeksforgeeks.org/computer-networks/rsa-algorithm-cryptography/
 // https://www.geeksforgeeks.org/dsa/euclidean-algorithms-basic-and-extended/
 
+// Build: make rsa_algorithm   (see Makefile)
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include "mr64.h"
 
 // Function for extended Euclidean Algorithm 
 int gcdExtended(int a, int b, int *x, int *y) {
@@ -70,6 +73,12 @@ int main() {
     int p = 1013;
     int q = 1019;
 
+    // p and q must be prime (deterministic Miller-Rabin, exact for word-sized numbers)
+    if (!mr64_is_prime(p) || !mr64_is_prime(q)) {
+        fprintf(stderr, "p and q must both be prime.\n");
+        return 1;
+    }
+
     int n = p * q;
     int totient = (p-1) * (q-1);
     
@@ -0,0 +1,477 @@
+// safeprime.c
+//
+// Candidates are stack-resident fixints: residues of r mod small primes are stepped along with
+// r, so the sieve, the Fermat filters and the zero-copy mpz views used for the final
+// Miller-Rabin run do no dynamic allocation. The pipelined versions hand candidates between
+// stages as offsets from the start of the walk, so a ring cell is one word. P wider than a
+// fixint takes the same paths on mpz candidates.
+
+#include <limits.h>
+#include <unistd.h>
+#include "safeprime.h"
+#include "mont.h"
+#include "pipeline.h"
+
+// Miller-Rabin reps
+static const int PRP_REPS = 30;
+
+// Consecutive odd r tried from one random start before drawing a new one
+static const unsigned long SEARCH_SPAN = 1UL << 20;
+
+// Convert approximate decimal digits to bits: digits * log2(10) ≈ digits * 3.32193
+static unsigned digits_to_bits(unsigned digits) {
+    double bits_d = digits * 3.3219280948873626;
+    unsigned bits = (unsigned)(bits_d + 0.5);
+    if (bits < 3) bits = 3;
+    return bits;
+}
+
+// First SAFEPRIME_SIEVE_PRIMES odd primes (3, 5, 7, ...)
+static void init_sieve_primes(unsigned primes[SAFEPRIME_SIEVE_PRIMES]) {
+    unsigned count = 0;
+    for (unsigned c = 3; count < SAFEPRIME_SIEVE_PRIMES; c += 2) {
+        int prime = 1;
+        for (unsigned i = 0; i < count && primes[i] * primes[i] <= c; ++i)
+            if (c % primes[i] == 0) { prime = 0; break; }
+        if (prime) primes[count++] = c;
+    }
+}
+
+// 1 if 2^(n-1) = 1 mod n (cheap pre-filter before the full Miller-Rabin run)
+static int fermat2(const fixint *n) {
+    fixint_mont ctx;
+    fixint two, e, t;
+    if (fixint_mont_init(&ctx, n) != 0) return 0;
+    fixint_set_ui(&two, 2);
+    fixint_sub_ui(&e, n, 1);
+    fixint_powm(&t, &two, &e, &ctx);
+    return fixint_cmp_ui(&t, 1) == 0;
+}
+
+// fermat2 for n wider than a fixint
+static int fermat2_mpz(const mpz_t n) {
+    mpz_t two, t;
+    mpz_init_set_ui(two, 2);
+    mpz_init(t);
+    mpz_sub_ui(t, n, 1);
+    mpz_powm(t, two, t, n);
+    int ok = mpz_cmp_ui(t, 1) == 0;
+    mpz_clears(two, t, NULL);
+    return ok;
+}
+
+// the final test of a candidate that passed fermat2: Miller-Rabin on r and P, and P's size
+static int prp(const mpz_t r, const mpz_t P, unsigned digits) {
+    return mpz_probab_prime_p(r, PRP_REPS) && mpz_probab_prime_p(P, PRP_REPS)
+           && mpz_sizeinbase(P, 10) >= digits;
+}
+
+int safeprime_fixint(unsigned digits) {
+    unsigned bits = digits_to_bits(digits);
+    if (bits < 130) bits = 130; // as safeprime_init
+    return bits <= FIXINT_LIMBS * GMP_NUMB_BITS;
+}
+
+void safeprime_init(safeprime_search *s, unsigned digits, unsigned long seed) {
+    s->digits = digits;
+    s->bits = digits_to_bits(digits);
+    if (s->bits < 130) s->bits = 130; // keep it reasonably large
+    s->wide = !safeprime_fixint(digits);
+    mpz_init(s->rz);
+    init_sieve_primes(s->primes);
+    s->left = 0;
+    s->step = 2;
+    for (unsigned i = 0; i < SAFEPRIME_SIEVE_PRIMES; ++i) s->step_res[i] = 2;
+    drbg_seed_ui(&s->rng, seed);
+}
+
+void safeprime_init_friendly(safeprime_search *s, unsigned digits, unsigned long seed) {
+    safeprime_init(s, digits, seed);
+    s->step = (mp_limb_t)1 << (GMP_NUMB_BITS - 1);
+    for (unsigned i = 0; i < SAFEPRIME_SIEVE_PRIMES; ++i) s->step_res[i] = (unsigned)(s->step % s->primes[i]);
+}
+
+void safeprime_reseed(safeprime_search *s, drbg *from) {
+    drbg_fork(&s->rng, from);
+    s->left = 0;
+}
+
+void safeprime_clear(safeprime_search *s) {
+    drbg_wipe(&s->rng);
+    mpz_clear(s->rz);
+}
+
+// walk on from r = start
+static void set_start(safeprime_search *s, const mpz_t start) {
+    if (s->wide) mpz_set(s->rz, start);
+    else fixint_set_mpz(&s->r, start);
+    for (unsigned i = 0; i < SAFEPRIME_SIEVE_PRIMES; ++i)
+        s->res[i] = (unsigned)mpz_fdiv_ui(start, s->primes[i]);
+}
+
+// random odd start r with bits-1 bits, and its residues
+static void new_start(safeprime_search *s) {
+    mpz_t start;
+    mpz_init(start);
+    drbg_urandomb(start, &s->rng, s->bits - 1); // r has ~bits-1 bits
+    mpz_setbit(start, s->bits - 2);           // ensure high bit set for size
+    mpz_setbit(start, 0);                     // odd
+    if (s->step != 2) // friendly: r = -1 mod step, so the low limb of P = 2r+1 is all ones
+        for (mp_bitcnt_t b = 1; (mp_limb_t)1 << b < s->step; ++b) mpz_setbit(start, b);
+    set_start(s, start);
+    mpz_clear(start);
+    s->left = SEARCH_SPAN;
+}
+
+// r and P = 2r+1 both free of small factors
+static int sieved(const safeprime_search *s) {
+    for (unsigned i = 0; i < SAFEPRIME_SIEVE_PRIMES; ++i)
+        if (s->res[i] == 0 || (2 * s->res[i] + 1) % s->primes[i] == 0) return 0;
+    return 1;
+}
+
+// next candidate r
+static void advance(safeprime_search *s) {
+    if (s->wide) mpz_add_ui(s->rz, s->rz, s->step);
+    else fixint_add_ui(&s->r, &s->r, s->step);
+    for (unsigned i = 0; i < SAFEPRIME_SIEVE_PRIMES; ++i) {
+        s->res[i] += s->step_res[i];
+        if (s->res[i] >= s->primes[i]) s->res[i] -= s->primes[i];
+    }
+}
+
+int safeprime_step(safeprime_search *s, unsigned long window, mpz_t P, mpz_t r) {
+    for (unsigned long n = 0; n < window; ++n) {
+        if (s->left == 0) new_start(s);
+
+        int found = 0;
+        if (sieved(s)) {
+            if (s->wide) {
+                mpz_t cp;
+                mpz_init(cp);
+                mpz_mul_2exp(cp, s->rz, 1);
+                mpz_add_ui(cp, cp, 1);
+                found = fermat2_mpz(cp) && fermat2_mpz(s->rz) && prp(s->rz, cp, s->digits);
+                if (found) {
+                    mpz_swap(P, cp);
+                    mpz_set(r, s->rz);
+                }
+                mpz_clear(cp);
+            } else {
+                fixint cp;
+                fixint_mul_ui(&cp, &s->r, 2);
+                fixint_add_ui(&cp, &cp, 1);
+                mpz_t pv, rv;
+                found = fermat2(&cp) && fermat2(&s->r) && prp(fixint_mpz(rv, &s->r), fixint_mpz(pv, &cp), s->digits);
+                if (found) {
+                    fixint_get_mpz(P, &cp);
+                    fixint_get_mpz(r, &s->r);
+                }
+            }
+        }
+
+        // next candidate (also after a hit, so the search can be resumed for another prime)
+        advance(s);
+        s->left--;
+        if (found) return 1;
+    }
+    return 0;
+}
+
+// ---------------- special form ----------------
+
+int safeprime_special(mpz_t P, mpz_t r, unsigned digits, unsigned long *c_out) {
+    unsigned bits = digits_to_bits(digits);
+    if (bits < 130) bits = 130;
+    unsigned k = (bits + 1 + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS * GMP_NUMB_BITS;
+    unsigned primes[SAFEPRIME_SIEVE_PRIMES], pow2[SAFEPRIME_SIEVE_PRIMES];
+    init_sieve_primes(primes);
+    mpz_t top;
+    mpz_init(top);
+    mpz_setbit(top, k);
+    for (unsigned i = 0; i < SAFEPRIME_SIEVE_PRIMES; ++i) pow2[i] = (unsigned)mpz_fdiv_ui(top, primes[i]);
+
+    // c = 1 mod 4 keeps P = 3 mod 4, so r is odd; p | r exactly when P = 1 mod p
+    int found = 0;
+    for (unsigned long c = 1; c <= MONT_PM_MAX_C && !found; c += 4) {
+        int sieved = 1;
+        for (unsigned i = 0; i < SAFEPRIME_SIEVE_PRIMES && sieved; ++i) {
+            unsigned pm = (unsigned)((pow2[i] + primes[i] - c % primes[i]) % primes[i]);
+            sieved = pm > 1;
+        }
+        if (!sieved) continue;
+        mpz_sub_ui(P, top, c);
+        mpz_sub_ui(r, P, 1);
+        mpz_divexact_ui(r, r, 2);
+        found = mpz_probab_prime_p(r, 1) && mpz_probab_prime_p(P, PRP_REPS) && mpz_probab_prime_p(r, PRP_REPS);
+        if (found && c_out) *c_out = c;
+    }
+    mpz_clear(top);
+    return found ? 0 : -1;
+}
+
+// ---------------- pipelines ----------------
+
+// threads for the test stages: as asked, or one per online CPU
+static unsigned test_threads(unsigned threads) {
+    if (threads) return threads;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+}
+
+struct prime_pipe {
+    safeprime_search *s; // walked by the sieve stage only
+    fixint r0;           // start of the walk: item k stands for r = r0 + k * s->step
+    mpz_t r0z;           // the same start as an mpz (the only one when s->wide)
+    uint64_t next;       // k of s->r
+    atomic_ullong best;  // smallest k found to be a safe prime (ULLONG_MAX: none yet)
+};
+
+static void candidate(const struct prime_pipe *pp, uint64_t k, fixint *r, fixint *P) {
+    fixint off;
+    fixint_set_ui(&off, k);
+    fixint_mul_ui(&off, &off, pp->s->step);
+    fixint_add(r, &pp->r0, &off);
+    fixint_mul_ui(P, r, 2);
+    fixint_add_ui(P, P, 1);
+}
+
+// candidate for s->wide; r and P initialized
+static void candidate_mpz(const struct prime_pipe *pp, uint64_t k, mpz_t r, mpz_t P) {
+    mpz_set_ui(r, k);
+    mpz_mul_ui(r, r, pp->s->step);
+    mpz_add(r, r, pp->r0z);
+    mpz_mul_2exp(P, r, 1);
+    mpz_add_ui(P, P, 1);
+}
+
+// fermat2 on P and r of item k
+static int fermat_item(const struct prime_pipe *pp, uint64_t k) {
+    if (pp->s->wide) {
+        mpz_t r, P;
+        mpz_inits(r, P, NULL);
+        candidate_mpz(pp, k, r, P);
+        int ok = fermat2_mpz(P) && fermat2_mpz(r);
+        mpz_clears(r, P, NULL);
+        return ok;
+    }
+    fixint r, P;
+    candidate(pp, k, &r, &P);
+    return fermat2(&P) && fermat2(&r);
+}
+
+// prp on item k
+static int prp_item(const struct prime_pipe *pp, uint64_t k) {
+    if (pp->s->wide) {
+        mpz_t r, P;
+        mpz_inits(r, P, NULL);
+        candidate_mpz(pp, k, r, P);
+        int ok = prp(r, P, pp->s->digits);
+        mpz_clears(r, P, NULL);
+        return ok;
+    }
+    fixint r, P;
+    mpz_t rv, pv;
+    candidate(pp, k, &r, &P);
+    return prp(fixint_mpz(rv, &r), fixint_mpz(pv, &P), pp->s->digits);
+}
+
+static uint64_t best_so_far(struct prime_pipe *pp) {
+    return atomic_load_explicit(&pp->best, memory_order_relaxed);
+}
+
+// source: offsets of candidates that pass the small-prime sieve, up to the best hit so far
+static size_t sieve_stage(pipeline *p, void *arg, uint64_t *items, size_t n) {
+    (void)p;
+    struct prime_pipe *pp = arg;
+    while (n == 0 && pp->next < best_so_far(pp)) // at least one survivor per batch
+        for (unsigned i = 0; i < SAFEPRIME_WINDOW && n < PIPE_BATCH; ++i, ++pp->next) {
+            if (sieved(pp->s)) items[n++] = pp->next;
+            advance(pp->s);
+        }
+    return n;
+}
+
+// base-2 Fermat on P and r: almost every survivor is a safe prime
+static size_t fermat_stage(pipeline *p, void *arg, uint64_t *items, size_t n) {
+    (void)p;
+    struct prime_pipe *pp = arg;
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (items[i] < best_so_far(pp) && fermat_item(pp, items[i])) items[k++] = items[i];
+    return k;
+}
+
+// full Miller-Rabin on both; keeps the smallest hit
+static size_t prp_stage(pipeline *p, void *arg, uint64_t *items, size_t n) {
+    (void)p;
+    struct prime_pipe *pp = arg;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned long long best = best_so_far(pp);
+        if (items[i] >= best || !prp_item(pp, items[i])) continue;
+        while (items[i] < best && !atomic_compare_exchange_weak(&pp->best, &best, items[i])) {}
+    }
+    return 0;
+}
+
+// the pipelined walk of an initialised search, from a new start; clears s
+static void walk(safeprime_search *s, mpz_t P, mpz_t r, unsigned threads, FILE *report) {
+    new_start(s);
+    struct prime_pipe pp = { .s = s, .next = 0 };
+    mpz_init(pp.r0z);
+    if (s->wide) mpz_set(pp.r0z, s->rz);
+    else {
+        pp.r0 = s->r;
+        fixint_get_mpz(pp.r0z, &s->r);
+    }
+    atomic_init(&pp.best, ULLONG_MAX);
+
+    // The sieve is cheap; the Fermat stage sees every survivor and gets the threads;
+    // Miller-Rabin runs about once per safe prime. Every candidate below the first hit is
+    // still tested, so the result is the first safe prime of the walk whatever the timing.
+    pipeline p;
+    pipe_init(&p, SAFEPRIME_RING);
+    pipe_add(&p, "sieve", sieve_stage, &pp, 1);
+    pipe_add(&p, "fermat", fermat_stage, &pp, test_threads(threads));
+    pipe_add(&p, "prp", prp_stage, &pp, 1);
+    if (pipe_run(&p) == 0) {
+        uint64_t k = atomic_load(&pp.best);
+        if (s->wide) {
+            candidate_mpz(&pp, k, r, P);
+        } else {
+            fixint rf, Pf;
+            candidate(&pp, k, &rf, &Pf);
+            fixint_get_mpz(P, &Pf);
+            fixint_get_mpz(r, &rf);
+        }
+    } else { // no threads: the same walk, inline
+        set_start(s, pp.r0z);
+        s->left = (unsigned long)-1;
+        while (!safeprime_step(s, SAFEPRIME_WINDOW, P, r)) {}
+    }
+    if (report) pipe_report(&p, report);
+    mpz_clear(pp.r0z);
+    safeprime_clear(s);
+}
+
+void safeprime_pipeline(mpz_t P, mpz_t r, unsigned digits, unsigned long seed, int friendly,
+                        unsigned threads, FILE *report) {
+    safeprime_search s;
+    if (friendly) safeprime_init_friendly(&s, digits, seed);
+    else safeprime_init(&s, digits, seed);
+    walk(&s, P, r, threads, report);
+}
+
+void gen_safe_prime(mpz_t P, mpz_t r, unsigned digits) {
+    safeprime_search s;
+    safeprime_init(&s, digits, 0);
+    safeprime_reseed(&s, drbg_thread());
+    walk(&s, P, r, 0, NULL);
+}
+
+void gen_safe_prime_friendly(mpz_t P, mpz_t r, unsigned digits) {
+    safeprime_search s;
+    safeprime_init_friendly(&s, digits, 0);
+    safeprime_reseed(&s, drbg_thread());
+    walk(&s, P, r, 0, NULL);
+}
+
+struct gen_pipe {
+    const fixint_mont *P;
+    const fixint *r;
+    uint64_t next;     // next g the source hands out
+    atomic_ulong best; // smallest generator found so far (ULONG_MAX: none yet)
+};
+
+// source: consecutive g, until one at or past the best generator found
+static size_t count_stage(pipeline *p, void *arg, uint64_t *items, size_t n) {
+    (void)p;
+    struct gen_pipe *gp = arg;
+    unsigned long best = atomic_load_explicit(&gp->best, memory_order_relaxed);
+    for (; n < PIPE_BATCH && gp->next < best; ++gp->next) items[n++] = gp->next;
+    return n;
+}
+
+// perfect squares are quadratic residues, never generators
+static size_t square_stage(pipeline *p, void *arg, uint64_t *items, size_t n) {
+    (void)p; (void)arg;
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        mpz_t g;
+        mp_limb_t limb = items[i];
+        if (!mpz_perfect_square_p(mpz_roinit_n(g, &limb, 1))) items[k++] = items[i];
+    }
+    return k;
+}
+
+// the generator test proper, skipping anything already beaten
+static size_t test_stage(pipeline *p, void *arg, uint64_t *items, size_t n) {
+    (void)p;
+    struct gen_pipe *gp = arg;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned long best = atomic_load_explicit(&gp->best, memory_order_relaxed);
+        if (items[i] >= best || !is_generator_safe_prime(items[i], gp->P, gp->r)) continue;
+        while (items[i] < best && !atomic_compare_exchange_weak(&gp->best, &best, items[i])) {}
+    }
+    return 0;
+}
+
+unsigned long safeprime_generator(unsigned long start, const fixint_mont *P, const fixint *r,
+                                  unsigned threads, FILE *report) {
+    // half of all g are generators and each test is one Jacobi symbol, so the first batch is
+    // tried inline; the pipeline only pays for its threads on a long run of non-generators
+    for (unsigned long g = start; g < start + PIPE_BATCH; ++g)
+        if (is_generator_safe_prime(g, P, r)) return g;
+    start += PIPE_BATCH;
+
+    struct gen_pipe gp = { .P = P, .r = r, .next = start };
+    atomic_init(&gp.best, ULONG_MAX);
+
+    // every g below the answer is tested, so the smallest generator wins however the
+    // test threads interleave
+    pipeline p;
+    pipe_init(&p, SAFEPRIME_RING);
+    pipe_add(&p, "count", count_stage, &gp, 1);
+    pipe_add(&p, "square", square_stage, &gp, 1);
+    pipe_add(&p, "test", test_stage, &gp, test_threads(threads));
+    unsigned long g = ULONG_MAX;
+    if (pipe_run(&p) == 0) g = atomic_load(&gp.best);
+    if (g == ULONG_MAX) // no threads: one at a time
+        for (g = start; !is_generator_safe_prime(g, P, r); ++g) {}
+    if (report) pipe_report(&p, report);
+    return g;
+}
+
+int is_generator_safe_prime(mp_limb_t g, const fixint_mont *P, const fixint *r) {
+    // The order of g divides P-1 = 2r, so it is 1, 2, r or 2r. Orders 1 and 2 are g = 1 and
+    // g = -1; orders 1 and r are the squares. So g is a primitive root iff g is not 0 or
+    // +-1 mod P and is a quadratic non-residue: one Jacobi symbol, no exponentiation.
+    (void)r;
+    mpz_t Pv;
+    mpz_roinit_n(Pv, P->m, P->n);
+    if (P->n == 1) {
+        g %= P->m[0];
+        if (g == P->m[0] - 1) return 0;
+    } // else g < 2^64 < P - 1
+    if (g <= 1) return 0;
+    return mpz_ui_kronecker(g, Pv) == -1;
+}
+
+int is_generator_safe_prime_powm(mp_limb_t g, const fixint_mont *P, const fixint *r) {
+    // For a primitive root modulo safe prime P, we need:
+    // g^((P-1)/2) = g^r != 1 mod P   and   g^((P-1)/r) = g^2 != 1 mod P
+    fixint base, two, t;
+    fixint_set_ui(&base, g);
+    fixint_set_ui(&two, 2);
+    if (P->n == 1 ? g % P->m[0] == 0 : g == 0) return 0; // not a unit
+
+    // Check factor 2
+    fixint_powm(&t, &base, r, P);
+    if (fixint_cmp_ui(&t, 1) == 0) return 0;
+
+    // Check factor r
+    fixint_powm(&t, &base, &two, P);
+    if (fixint_cmp_ui(&t, 1) == 0) return 0;
+
+    return 1;
+}
@@ -0,0 +1,85 @@
+// safeprime.h
+// Safe-prime generation (P = 2r+1 with r prime) and the primitive-root test it allows.
+//
+// The search is resumable: a safeprime_search holds the sieve state between calls, and
+// safeprime_step examines at most one window of candidates before returning, so callers can
+// interleave it with other work or give up on it (see async.h). gen_safe_prime runs the same
+// walk as a staged pipeline over MPMC rings (pipeline.h) to use every core.
+
+#ifndef SAFEPRIME_H
+#define SAFEPRIME_H
+
+#include <stdio.h>
+#include <gmp.h>
+#include "drbg.h"
+#include "fixint.h"
+
+// Odd primes used to sieve r and P = 2r+1 before any exponentiation
+#define SAFEPRIME_SIEVE_PRIMES 256
+
+// candidates per sieve window (one safeprime_step at most)
+#define SAFEPRIME_WINDOW 4096
+
+typedef struct {
+    unsigned digits, bits;
+    unsigned primes[SAFEPRIME_SIEVE_PRIMES];
+    unsigned res[SAFEPRIME_SIEVE_PRIMES]; // r mod primes[i]
+    int wide;                              // P is wider than a fixint: candidates are mpz
+    fixint r;                              // current candidate (!wide)
+    mpz_t rz;                              // current candidate (wide)
+    mp_limb_t step;                        // r advances by this: 2, or 2^63 for friendly P
+    unsigned step_res[SAFEPRIME_SIEVE_PRIMES]; // step mod primes[i]
+    unsigned long left;                    // candidates left before drawing a new start
+    drbg rng;                              // draws the random starts
+} safeprime_search;
+
+// 1 if safe primes of 'digits' digits fit a fixint: the search then runs on stack fixints and
+// the fixint helpers below (is_generator_safe_prime, safeprime_generator) take the result.
+// Wider P are searched the same way on mpz candidates, at mpz speed.
+int safeprime_fixint(unsigned digits);
+
+// seed fixes the walk (for tests and benchmarks); safeprime_reseed makes it unpredictable
+void safeprime_init(safeprime_search *s, unsigned digits, unsigned long seed);
+// the same search restricted to Montgomery-friendly P = -1 mod 2^64 (r = -1 mod 2^63), whose
+// -P^-1 mod 2^64 is 1: every Montgomery reduction mod P then skips one multiply per limb
+void safeprime_init_friendly(safeprime_search *s, unsigned digits, unsigned long seed);
+// continue with starts drawn from a key taken from 'from' (drbg_thread() for real keys)
+void safeprime_reseed(safeprime_search *s, drbg *from);
+void safeprime_clear(safeprime_search *s);
+// look at up to window candidates; 1 with P and r set once a safe prime is found
+int safeprime_step(safeprime_search *s, unsigned long window, mpz_t P, mpz_t r);
+
+// capacity of the rings between pipeline stages (pipeline.h)
+#define SAFEPRIME_RING 1024
+
+// The same walk as a pipeline: sieve -> base-2 Fermat on P and r -> Miller-Rabin, the Fermat
+// stage on 'threads' threads (0: one per CPU). Per-stage counters go to report unless NULL.
+// The result is the first safe prime of the walk, so it depends only on the seed. With friendly
+// set the walk is that of safeprime_init_friendly.
+void safeprime_pipeline(mpz_t P, mpz_t r, unsigned digits, unsigned long seed, int friendly,
+                        unsigned threads, FILE *report);
+
+// Safe prime of the pseudo-Mersenne form P = 2^k - c, k a multiple of 64 and c the smallest
+// one that works (c < 2^32, so mont_init reduces mod P by folding instead of REDC). Same P
+// for the same digits, like the fixed RFC groups. 0 on success, -1 if no c qualifies.
+int safeprime_special(mpz_t P, mpz_t r, unsigned digits, unsigned long *c);
+
+// safe prime P = 2r+1 with at least 'digits' decimal digits (blocking, pipelined), from a
+// start drawn from the calling thread's getrandom-seeded ChaCha20 stream
+void gen_safe_prime(mpz_t P, mpz_t r, unsigned digits);
+// the same with P = -1 mod 2^64 (see safeprime_init_friendly)
+void gen_safe_prime_friendly(mpz_t P, mpz_t r, unsigned digits);
+
+// 1 if g is a primitive root modulo the safe prime P = 2r+1: g != 0, +-1 and (g/P) = -1
+// (a Jacobi symbol, microseconds at any size; r is not needed)
+int is_generator_safe_prime(mp_limb_t g, const fixint_mont *P, const fixint *r);
+// the same by definition: g^r != 1 and g^2 != 1 mod P (factors of P-1 are {2, r});
+// kept as the reference the Legendre test is checked against
+int is_generator_safe_prime_powm(mp_limb_t g, const fixint_mont *P, const fixint *r);
+
+// smallest g >= start that is a primitive root modulo the safe prime P = 2r+1, as a pipeline:
+// consecutive g -> drop perfect squares -> is_generator_safe_prime on 'threads' threads
+unsigned long safeprime_generator(unsigned long start, const fixint_mont *P, const fixint *r,
+                                  unsigned threads, FILE *report);
+
+#endif
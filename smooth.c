@@ -0,0 +1,158 @@
+// smooth.c
+//
+// Trees are stored level by level, leaves at level 0; an odd node at the end of a level is
+// carried up unchanged. The remainder tree overwrites the product tree in place: once a
+// node's remainder is known its product is only needed by its children, which read their own.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "hugepage.h"
+#include "smooth.h"
+#include "worksteal.h"
+
+#define TREE_LEVELS 64
+
+typedef struct {
+    size_t levels;
+    size_t len[TREE_LEVELS];
+    mpz_t *node[TREE_LEVELS];
+} tree;
+
+static void tree_free(tree *t) {
+    for (size_t k = 0; k < t->levels; ++k) {
+        for (size_t i = 0; i < t->len[k]; ++i) mpz_clear(t->node[k][i]);
+        hugepage_free(t->node[k]);
+    }
+}
+
+// every level of a tree on n leaves allocated and initialized; 0 or -1
+static int tree_alloc(tree *t, size_t n) {
+    t->levels = 0;
+    for (size_t len = n;; len = (len + 1) / 2) {
+        mpz_t *level = hugepage_alloc(len * sizeof(mpz_t), NULL);
+        if (!level) { tree_free(t); return -1; }
+        for (size_t i = 0; i < len; ++i) mpz_init(level[i]);
+        t->len[t->levels] = len;
+        t->node[t->levels++] = level;
+        if (len == 1) return 0;
+    }
+}
+
+struct level_job {
+    tree *t;
+    size_t k;                  // level being filled
+    const mpz_t *x;            // leaves (smooth_batch)
+    const mpz_t *base;         // factor-base product (remainder at the root)
+    mpz_t *part;
+    unsigned char *smooth;
+};
+
+// enough tasks per level to keep every worker busy, few enough to amortize the spawns
+static size_t level_grain(size_t len) {
+    ws_worker *w = ws_self();
+    size_t tasks = 8 * (w ? ws_nworkers(w->owner) : 1);
+    return len > tasks ? len / tasks : 1;
+}
+
+static void product_node(size_t i, void *p) {
+    struct level_job *j = p;
+    mpz_t *below = j->t->node[j->k - 1];
+    if (2 * i + 1 < j->t->len[j->k - 1]) mpz_mul(j->t->node[j->k][i], below[2 * i], below[2 * i + 1]);
+    else mpz_set(j->t->node[j->k][i], below[2 * i]);
+}
+
+// leaves already in level 0; every level above is the product of the one below
+static void product_tree(tree *t) {
+    for (size_t k = 1; k < t->levels; ++k) {
+        struct level_job j = { .t = t, .k = k };
+        ws_parallel_for(0, t->len[k], level_grain(t->len[k]), product_node, &j);
+    }
+}
+
+static void remainder_node(size_t i, void *p) {
+    struct level_job *j = p;
+    mpz_ptr r = j->t->node[j->k][i];
+    if (j->k + 1 == j->t->levels) mpz_mod(r, *j->base, r);
+    else mpz_mod(r, j->t->node[j->k + 1][i / 2], r);
+}
+
+// leaf: r = base mod x, squared until the exponent 2^e covers every prime power that fits
+// in x; the gcd with x is then the smooth part
+static void leaf_part(size_t i, void *p) {
+    struct level_job *j = p;
+    mpz_ptr r = j->t->node[0][i];
+    const mpz_srcptr x = j->x[i];
+    // the double-width square goes to the worker's scratch, so the leaf stays one x wide
+    ws_worker *w = ws_self();
+    mpz_t own;
+    mpz_ptr sq = w ? w->scratch[0] : own;
+    if (!w) mpz_init(own);
+    for (size_t e = 1; e < mpz_sizeinbase(x, 2); e <<= 1) {
+        mpz_mul(sq, r, r);
+        mpz_mod(r, sq, x);
+    }
+    if (!w) mpz_clear(own);
+    mpz_gcd(r, r, x);
+    if (j->part) mpz_set(j->part[i], r);
+    if (j->smooth) j->smooth[i] = mpz_cmp(r, x) == 0;
+}
+
+int smooth_base_init(smooth_base *fb, unsigned long bound) {
+    if (bound < 3) return -1;
+    unsigned char *composite = calloc(bound, 1);
+    if (!composite) return -1;
+    // leaves are words holding as many consecutive primes as fit, so the tree starts at
+    // one limb per node instead of one prime
+    size_t words = 0, count = 1;
+    uint64_t w = 2;
+    for (unsigned long i = 3; i < bound; i += 2) {
+        if (composite[i]) continue;
+        if (i <= bound / i)
+            for (unsigned long m = i * i; m < bound; m += 2 * i) composite[m] = 1;
+        ++count;
+        if (w > UINT64_MAX / i) { ++words; w = i; }
+        else w *= i;
+    }
+    ++words;
+
+    tree t;
+    if (tree_alloc(&t, words) != 0) { free(composite); return -1; }
+    // second pass over the finished sieve fills the leaves the same way
+    size_t leaf = 0;
+    w = 2;
+    for (unsigned long i = 3; i < bound; i += 2) {
+        if (composite[i]) continue;
+        if (w > UINT64_MAX / i) { mpz_set_ui(t.node[0][leaf++], w); w = i; }
+        else w *= i;
+    }
+    mpz_set_ui(t.node[0][leaf], w);
+    free(composite);
+
+    product_tree(&t);
+    fb->bound = bound;
+    fb->count = count;
+    mpz_init_set(fb->product, t.node[t.levels - 1][0]);
+    tree_free(&t);
+    return 0;
+}
+
+void smooth_base_clear(smooth_base *fb) {
+    mpz_clear(fb->product);
+}
+
+int smooth_batch(const smooth_base *fb, const mpz_t x[], size_t n, mpz_t part[], unsigned char *smooth) {
+    if (n == 0) return 0;
+    tree t;
+    if (tree_alloc(&t, n) != 0) return -1;
+    for (size_t i = 0; i < n; ++i) mpz_set(t.node[0][i], x[i]);
+    product_tree(&t);
+
+    struct level_job j = { .t = &t, .x = x, .base = &fb->product, .part = part, .smooth = smooth };
+    for (size_t k = t.levels; k-- > 0;) {
+        j.k = k;
+        ws_parallel_for(0, t.len[k], level_grain(t.len[k]), remainder_node, &j);
+    }
+    ws_parallel_for(0, n, level_grain(n), leaf_part, &j);
+    tree_free(&t);
+    return 0;
+}
@@ -0,0 +1,37 @@
+// smooth.h
+// Batch smoothness detection (Bernstein, "How to find smooth parts of integers").
+//
+// Whether x is smooth over the primes below a bound, for many x at once, without dividing
+// any x by any prime: the product of all the x is built as a tree, the product of the factor
+// base is reduced down it (a remainder tree) to r = base mod x at every leaf, and then
+// gcd(x, r^(2^e) mod x) with 2^e >= log2 x is exactly the smooth part of x. The cost per
+// number grows with the logarithm of the batch and of the base rather than with the number
+// of primes, so it replaces trial division against the prime table wherever numbers come
+// in batches: p-1 of a file of primes, relations in an index calculus, group audits.
+//
+// Both trees are built level by level, the nodes of one level spread over the calling
+// thread's scheduler (worksteal.h); outside a scheduler everything runs on the caller.
+
+#ifndef SMOOTH_H
+#define SMOOTH_H
+
+#include <stddef.h>
+#include <gmp.h>
+
+// the factor base: every prime below bound, kept only as their product
+typedef struct {
+    unsigned long bound;
+    size_t count;  // primes below bound
+    mpz_t product;
+} smooth_base;
+
+// 0 on success, -1 on allocation failure or bound < 3
+int smooth_base_init(smooth_base *fb, unsigned long bound);
+void smooth_base_clear(smooth_base *fb);
+
+// For the n numbers x[i] >= 1: part[i] (initialized, may be NULL) = the largest divisor of
+// x[i] with no prime factor >= fb->bound, and smooth[i] (may be NULL) = 1 if that is all of
+// x[i]. 0 on success, -1 on allocation failure.
+int smooth_batch(const smooth_base *fb, const mpz_t x[], size_t n, mpz_t part[], unsigned char *smooth);
+
+#endif
@@ -0,0 +1,49 @@
+// soa_batch.c
+//
+// Allocation of structure-of-arrays batches and the transposes to and from mpz arrays.
+
+#include "soa_batch.h"
+#include "hugepage.h"
+
+int soa_init(soa_batch *b, size_t limbs, size_t count) {
+    b->limbs = limbs;
+    b->count = count;
+    b->lanes = (count + SOA_LANES - 1) / SOA_LANES * SOA_LANES;
+    if (b->lanes == 0) b->lanes = SOA_LANES;
+    size_t bytes = limbs * b->lanes * sizeof(mp_limb_t);
+    bytes = (bytes + SOA_ALIGN - 1) / SOA_ALIGN * SOA_ALIGN;
+    b->data = hugepage_alloc(bytes, NULL); // zeroed, 2 MB pages for large batches
+    return b->data ? 0 : -1;
+}
+
+void soa_clear(soa_batch *b) {
+    hugepage_free(b->data);
+    b->data = NULL;
+}
+
+int soa_from_mpz(soa_batch *b, const mpz_t *src, size_t count) {
+    if (count > b->lanes) return -1;
+    for (size_t j = 0; j < count; ++j) {
+        size_t n = mpz_size(src[j]);
+        if (mpz_sgn(src[j]) < 0 || n > b->limbs) return -1;
+        const mp_limb_t *p = mpz_limbs_read(src[j]);
+        for (size_t i = 0; i < b->limbs; ++i) b->data[i * b->lanes + j] = i < n ? p[i] : 0;
+    }
+    for (size_t j = count; j < b->lanes; ++j)
+        for (size_t i = 0; i < b->limbs; ++i) b->data[i * b->lanes + j] = 0;
+    b->count = count;
+    return 0;
+}
+
+void soa_to_mpz(mpz_t *dst, const soa_batch *b) {
+    for (size_t j = 0; j < b->count; ++j) {
+        mp_limb_t *p = mpz_limbs_write(dst[j], b->limbs);
+        for (size_t i = 0; i < b->limbs; ++i) p[i] = b->data[i * b->lanes + j];
+        mpz_limbs_finish(dst[j], b->limbs);
+    }
+}
+
+void soa_set_ui(soa_batch *b, size_t j, mp_limb_t v) {
+    b->data[j] = v;
+    for (size_t i = 1; i < b->limbs; ++i) b->data[i * b->lanes + j] = 0;
+}
@@ -0,0 +1,39 @@
+// soa_batch.h
+// Structure-of-arrays layout for batches of equally sized big integers.
+//
+// Limb i of element j lives at data[i * lanes + j]: each limb position is one contiguous,
+// 64-byte aligned row, so a kernel walking all elements in lockstep reads consecutive words
+// instead of striding across separately allocated mpz limbs. lanes is count rounded up to
+// SOA_LANES; the padding elements are zero and kernels may compute on them freely.
+
+#ifndef SOA_BATCH_H
+#define SOA_BATCH_H
+
+#include <stddef.h>
+#include <gmp.h>
+
+#define SOA_LANES 8   // lane padding: one 512-bit vector of 64-bit limbs
+#define SOA_ALIGN 64  // storage comes from hugepage_alloc (64-byte aligned)
+
+typedef struct {
+    size_t limbs;     // limbs per element
+    size_t count;     // elements in use
+    size_t lanes;     // row length: count rounded up to SOA_LANES
+    mp_limb_t *data;  // limbs * lanes words, SOA_ALIGN-aligned
+} soa_batch;
+
+// 0 on success, -1 on allocation failure; the batch starts zeroed
+int soa_init(soa_batch *b, size_t limbs, size_t count);
+void soa_clear(soa_batch *b);
+
+// row of limb i (lanes words)
+static inline mp_limb_t *soa_row(const soa_batch *b, size_t i) { return b->data + i * b->lanes; }
+
+// transpose count mpz values in (each must be >= 0 and fit in b->limbs limbs; -1 otherwise)
+int soa_from_mpz(soa_batch *b, const mpz_t *src, size_t count);
+// transpose b->count elements out
+void soa_to_mpz(mpz_t *dst, const soa_batch *b);
+// element j <- v / element j -> v (single limb batches, e.g. word-sized candidates)
+void soa_set_ui(soa_batch *b, size_t j, mp_limb_t v);
+
+#endif
@@ -0,0 +1,288 @@
+// tgdh.c
+// Build: make tgdh   (see Makefile)
+// Run  : ./tgdh [max_members]
+//
+// Tree-based group Diffie-Hellman (TGDH) for N parties over the P/alpha of diffie-hellman.c.
+// - Every member is a leaf holding a secret key k; every node also publishes its blinded key
+//   bk = alpha^k mod P.
+// - An internal node's key is k = bk_right^k_left = alpha^(k_left * k_right) mod P; the root
+//   key is the group key.
+// - A join or leave only changes one leaf, so rekeying recomputes the O(log N) keys on the
+//   path from that leaf to the root (two exponentiations per level).
+// - The initial key computation runs independent subtrees as tasks on the work-stealing
+//   scheduler.
+// - Benchmarks rekey latency for groups of 2 .. max_members (default 10^4).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <gmp.h>
+#include "drbg.h"
+#include "worksteal.h"
+
+// -------------------- Config --------------------
+// Same group as diffie-hellman.c (alpha = minimal generator > 15 found there)
+#define GROUP_P     "982451653173961852241334935997"
+#define GROUP_ALPHA 16
+
+// Rekeys timed per group size
+static const int REKEY_ROUNDS = 32;
+
+// Members whose view of the group key is checked against the root key
+static const size_t VERIFY_MEMBERS = 64;
+
+// Subtrees with fewer leaves are keyed sequentially rather than spawned as a task
+static const size_t TASK_MIN_LEAVES = 32;
+// ------------------------------------------------
+
+struct tnode {
+    mpz_t key, bkey;          // secret key and blinded key alpha^key mod P
+    struct tnode *parent, *left, *right;
+    size_t nleaves;           // leaves below (1 for a member)
+    long member;              // member id for leaves, -1 for internal nodes
+};
+
+struct tgdh {
+    mpz_t P, alpha;
+    struct tnode *root;
+    struct tnode **leaf;      // leaf of member id, NULL once it has left
+    size_t cap;
+    long next_id;
+};
+
+static atomic_ulong exps;     // exponentiations done, for the benchmark
+
+static void tgdh_powm(mpz_t r, const mpz_t b, const mpz_t e, const struct tgdh *g) {
+    mpz_powm(r, b, e, g->P);
+    atomic_fetch_add_explicit(&exps, 1, memory_order_relaxed);
+}
+
+static struct tnode *node_new(long member) {
+    struct tnode *n = calloc(1, sizeof(*n));
+    mpz_inits(n->key, n->bkey, NULL);
+    n->member = member;
+    n->nleaves = 1;
+    return n;
+}
+
+static void node_free(struct tnode *n) {
+    mpz_clears(n->key, n->bkey, NULL);
+    free(n);
+}
+
+static void subtree_free(struct tnode *n) {
+    if (!n) return;
+    subtree_free(n->left);
+    subtree_free(n->right);
+    node_free(n);
+}
+
+// fresh secret key for a member leaf, and its blinded key
+static void leaf_refresh(struct tgdh *g, struct tnode *leaf) {
+    drbg_urandomm(leaf->key, drbg_thread(), g->P);
+    tgdh_powm(leaf->bkey, g->alpha, leaf->key, g);
+}
+
+// k = bk_right^k_left, bk = alpha^k
+static void node_combine(const struct tgdh *g, struct tnode *n) {
+    tgdh_powm(n->key, n->right->bkey, n->left->key, g);
+    tgdh_powm(n->bkey, g->alpha, n->key, g);
+}
+
+// recompute the keys on the path from n up to the root: O(log N) exponentiations
+static void path_rekey(struct tgdh *g, struct tnode *n) {
+    for (n = n->parent; n; n = n->parent) node_combine(g, n);
+}
+
+struct subtree_arg {
+    const struct tgdh *g;
+    struct tnode *n;
+};
+
+static void subtree_keys(void *p);
+
+// compute every internal key below n bottom-up; the left half of a large subtree is spawned
+// as a task (idle workers steal it) while this worker goes down the right half
+static void subtree_keys_at(const struct tgdh *g, struct tnode *n) {
+    if (n->member >= 0) return;
+    if (n->nleaves >= TASK_MIN_LEAVES && ws_self()) {
+        struct subtree_arg left = { g, n->left };
+        ws_group done;
+        ws_group_init(&done);
+        ws_spawn(&done, subtree_keys, &left);
+        subtree_keys_at(g, n->right);
+        ws_wait(&done);
+    } else {
+        subtree_keys_at(g, n->left);
+        subtree_keys_at(g, n->right);
+    }
+    node_combine(g, n);
+}
+
+static void subtree_keys(void *p) {
+    struct subtree_arg *a = p;
+    subtree_keys_at(a->g, a->n);
+}
+
+// attach leaf next to the shallow side of the tree: descend into the lighter child, so the
+// depth stays within a couple of levels of log2 N
+static struct tnode *tree_insert(struct tgdh *g, struct tnode *leaf) {
+    if (!g->root) { g->root = leaf; return NULL; }
+
+    struct tnode *sib = g->root;
+    while (sib->member < 0)
+        sib = sib->left->nleaves <= sib->right->nleaves ? sib->left : sib->right;
+
+    struct tnode *parent = node_new(-1);
+    parent->parent = sib->parent;
+    if (!sib->parent) g->root = parent;
+    else if (sib->parent->left == sib) sib->parent->left = parent;
+    else sib->parent->right = parent;
+    parent->left = sib; parent->right = leaf;
+    sib->parent = leaf->parent = parent;
+    for (struct tnode *a = parent; a; a = a->parent) a->nleaves = a->left->nleaves + a->right->nleaves;
+    return sib; // sponsor
+}
+
+// detach leaf; its sibling takes the parent's place. Returns the sponsor (a leaf in that subtree).
+static struct tnode *tree_remove(struct tgdh *g, struct tnode *leaf) {
+    struct tnode *parent = leaf->parent;
+    if (!parent) { g->root = NULL; return NULL; }
+
+    struct tnode *sib = parent->left == leaf ? parent->right : parent->left;
+    sib->parent = parent->parent;
+    if (!parent->parent) g->root = sib;
+    else if (parent->parent->left == parent) parent->parent->left = sib;
+    else parent->parent->right = sib;
+    node_free(parent);
+    for (struct tnode *a = sib->parent; a; a = a->parent) a->nleaves = a->left->nleaves + a->right->nleaves;
+
+    while (sib->member < 0) sib = sib->right; // rightmost leaf of the sibling subtree sponsors
+    return sib;
+}
+
+static void tgdh_init(struct tgdh *g, size_t cap) {
+    mpz_init_set_str(g->P, GROUP_P, 10);
+    mpz_init_set_ui(g->alpha, GROUP_ALPHA);
+    g->root = NULL;
+    g->leaf = calloc(cap, sizeof(*g->leaf));
+    g->cap = cap;
+    g->next_id = 0;
+}
+
+static void tgdh_clear(struct tgdh *g) {
+    subtree_free(g->root);
+    free(g->leaf);
+    mpz_clears(g->P, g->alpha, NULL);
+}
+
+// initial group of n members: insert all leaves, then key the whole tree once
+static void tgdh_build(struct tgdh *g, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        struct tnode *leaf = node_new(g->next_id);
+        g->leaf[g->next_id++] = leaf;
+        leaf_refresh(g, leaf);
+        tree_insert(g, leaf);
+    }
+    subtree_keys_at(g, g->root);
+}
+
+// new member joins; the sponsor refreshes its key and both paths meet at the new parent
+static long tgdh_join(struct tgdh *g) {
+    if ((size_t)g->next_id == g->cap) {
+        g->cap *= 2;
+        g->leaf = realloc(g->leaf, g->cap * sizeof(*g->leaf));
+    }
+    struct tnode *leaf = node_new(g->next_id);
+    g->leaf[g->next_id] = leaf;
+    leaf_refresh(g, leaf);
+    struct tnode *sponsor = tree_insert(g, leaf);
+    if (sponsor) leaf_refresh(g, sponsor);
+    path_rekey(g, leaf);
+    return g->next_id++;
+}
+
+// member leaves; the sponsor refreshes its key so the leaver cannot compute the new group key
+static void tgdh_leave(struct tgdh *g, long member) {
+    struct tnode *leaf = g->leaf[member];
+    g->leaf[member] = NULL;
+    struct tnode *sponsor = tree_remove(g, leaf);
+    node_free(leaf);
+    if (sponsor) {
+        leaf_refresh(g, sponsor);
+        path_rekey(g, sponsor);
+    }
+}
+
+// group key as member computes it: own secret plus the blinded keys on its co-path
+static void member_view(mpz_t k, const struct tgdh *g, long member) {
+    const struct tnode *n = g->leaf[member];
+    mpz_set(k, n->key);
+    for (; n->parent; n = n->parent) {
+        const struct tnode *sib = n->parent->left == n ? n->parent->right : n->parent->left;
+        mpz_powm(k, sib->bkey, k, g->P);
+    }
+}
+
+static long random_member(struct tgdh *g) {
+    for (;;) {
+        long id = (long)(drbg_u64(drbg_thread()) % (uint64_t)g->next_id);
+        if (g->leaf[id]) return id;
+    }
+}
+
+static size_t tree_depth(const struct tnode *n) {
+    if (!n || n->member >= 0) return 0;
+    size_t l = tree_depth(n->left), r = tree_depth(n->right);
+    return 1 + (l > r ? l : r);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    size_t max_members = argc >= 2 ? strtoul(argv[1], NULL, 10) : 10000;
+    if (max_members < 2) max_members = 2;
+    ws_sched *sched = ws_create(0); // NULL: key the tree on this thread alone
+
+    printf("%8s %6s %12s %14s %14s %10s %8s\n",
+           "members", "depth", "build (s)", "join (ms)", "leave (ms)", "exps/op", "views");
+    for (size_t n = 2;; n = n * 10 > max_members && n < max_members ? max_members : n * 10) {
+        struct tgdh g;
+        tgdh_init(&g, n + REKEY_ROUNDS + 1);
+
+        double t0 = now_seconds();
+        tgdh_build(&g, n);
+        double build = now_seconds() - t0;
+
+        atomic_store(&exps, 0);
+        t0 = now_seconds();
+        for (int i = 0; i < REKEY_ROUNDS; ++i) tgdh_join(&g);
+        double join = (now_seconds() - t0) / REKEY_ROUNDS;
+
+        t0 = now_seconds();
+        for (int i = 0; i < REKEY_ROUNDS; ++i) tgdh_leave(&g, random_member(&g));
+        double leave = (now_seconds() - t0) / REKEY_ROUNDS;
+        double per_op = (double)atomic_load(&exps) / (2.0 * REKEY_ROUNDS);
+
+        // every checked member must derive the root key from its own path
+        mpz_t view; mpz_init(view);
+        size_t ok = 0, checked = 0;
+        for (size_t i = 0; i < VERIFY_MEMBERS && i < n; ++i, ++checked) {
+            member_view(view, &g, random_member(&g));
+            ok += mpz_cmp(view, g.root->key) == 0;
+        }
+        mpz_clear(view);
+
+        printf("%8zu %6zu %12.4f %14.4f %14.4f %10.1f %4zu/%-3zu\n",
+               n, tree_depth(g.root), build, join * 1e3, leave * 1e3, per_op, ok, checked);
+        tgdh_clear(&g);
+        if (n >= max_members) break;
+    }
+    if (sched) ws_destroy(sched);
+    return 0;
+}
@@ -0,0 +1,359 @@
+// worksteal.c
+//
+// Chase-Lev deques as in Le, Pop, Cohen and Zappa Nardelli, "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (PPoPP 2013), including their growable ring: a push
+// into a full ring copies it into one twice the size. Stealers may still be reading the old
+// ring, so it is only freed with the scheduler; a spawn that cannot grow its ring (no
+// memory) runs the task inline instead. Idle workers sleep on a condition variable once no
+// task is queued anywhere.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "worksteal.h"
+#include "numa_topo.h"
+
+#define DEQUE_CAP 1024 // initial ring size, a power of two
+#define STEAL_ROUNDS 4 // full passes over the victims before going to sleep
+
+struct task {
+    ws_fn fn;
+    void *arg;
+    ws_group *group;
+    struct task *next; // injection queue link
+};
+
+struct ring {
+    long cap;          // power of two
+    struct ring *old;  // the ring this one replaced
+    struct task *_Atomic slot[];
+};
+
+struct deque {
+    _Alignas(64) atomic_long top;    // stealers take here
+    _Alignas(64) atomic_long bottom; // the owner pushes and pops here
+    _Alignas(64) struct ring *_Atomic ring;
+};
+
+struct ws_sched {
+    size_t n;             // workers running
+    size_t cap;           // workers set up
+    ws_worker *workers;
+    struct deque *deques;
+    pthread_t *threads;
+    atomic_long queued;   // tasks sitting in deques or the injection queue
+    struct task *inject_head, *inject_tail; // FIFO of ws_submit tasks
+    pthread_mutex_t inject_lock;
+    atomic_int sleepers;
+    atomic_int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    ws_worker *outer;     // the creating thread's worker before ws_create, back after ws_destroy
+};
+
+static _Thread_local ws_worker *self;
+
+ws_worker *ws_self(void) { return self; }
+size_t ws_nworkers(const ws_sched *s) { return s->n; }
+
+// ---------------- deque ----------------
+
+static struct ring *ring_new(long cap, struct ring *old) {
+    struct ring *r = malloc(sizeof(*r) + cap * sizeof(r->slot[0]));
+    if (r) { r->cap = cap; r->old = old; }
+    return r;
+}
+
+static void deque_free(struct deque *d) {
+    for (struct ring *r = atomic_load(&d->ring), *old; r; r = old) {
+        old = r->old;
+        free(r);
+    }
+}
+
+// owner only: the live tasks [top, bottom) moved to a ring twice the size; NULL without memory
+static struct ring *deque_grow(struct deque *d, struct ring *r, long top, long b) {
+    struct ring *g = ring_new(2 * r->cap, r);
+    if (!g) return NULL;
+    for (long i = top; i < b; ++i)
+        atomic_store_explicit(&g->slot[i & (g->cap - 1)],
+                              atomic_load_explicit(&r->slot[i & (r->cap - 1)], memory_order_relaxed),
+                              memory_order_relaxed);
+    atomic_store_explicit(&d->ring, g, memory_order_release);
+    return g;
+}
+
+static int deque_push(struct deque *d, struct task *t) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&d->top, memory_order_acquire);
+    struct ring *r = atomic_load_explicit(&d->ring, memory_order_relaxed);
+    if (b - top >= r->cap && !(r = deque_grow(d, r, top, b))) return -1;
+    atomic_store_explicit(&r->slot[b & (r->cap - 1)], t, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+static struct task *deque_take(struct deque *d) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    struct ring *r = atomic_load_explicit(&d->ring, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    struct task *x = NULL;
+    if (t <= b) {
+        x = atomic_load_explicit(&r->slot[b & (r->cap - 1)], memory_order_relaxed);
+        if (t == b) { // last one: race the stealers for it
+            if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                         memory_order_relaxed))
+                x = NULL;
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return x;
+}
+
+static struct task *deque_steal(struct deque *d) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+    struct ring *r = atomic_load_explicit(&d->ring, memory_order_acquire);
+    struct task *x = atomic_load_explicit(&r->slot[t & (r->cap - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return NULL; // lost the race; the caller just moves on
+    return x;
+}
+
+// ---------------- tasks ----------------
+
+static void run_task(struct task *t) {
+    t->fn(t->arg);
+    atomic_fetch_sub_explicit(&t->group->pending, 1, memory_order_release);
+    free(t);
+}
+
+static struct task *inject_pop(ws_sched *s) {
+    pthread_mutex_lock(&s->inject_lock);
+    struct task *t = s->inject_head;
+    if (t) {
+        s->inject_head = t->next;
+        if (!s->inject_head) s->inject_tail = NULL;
+    }
+    pthread_mutex_unlock(&s->inject_lock);
+    return t;
+}
+
+// one task from the own deque, the injection queue or a victim's deque, NULL if none was found
+static struct task *find_task(ws_worker *w) {
+    ws_sched *s = w->owner;
+    struct task *t = deque_take(w->internal);
+    if (!t) t = inject_pop(s);
+    for (size_t v = 1; !t && v < s->n; ++v)
+        t = deque_steal(&s->deques[(w->id + v) % s->n]);
+    if (t) atomic_fetch_sub_explicit(&s->queued, 1, memory_order_relaxed);
+    return t;
+}
+
+void ws_group_init(ws_group *g) {
+    atomic_init(&g->pending, 0);
+}
+
+// a task was queued: count it and wake a sleeping worker if there is one
+static void wake_one(ws_sched *s) {
+    atomic_fetch_add(&s->queued, 1);
+    if (atomic_load(&s->sleepers) > 0) {
+        pthread_mutex_lock(&s->lock);
+        pthread_cond_signal(&s->wake);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+void ws_spawn(ws_group *g, ws_fn fn, void *arg) {
+    ws_worker *w = self;
+    struct task *t = w ? malloc(sizeof(*t)) : NULL;
+    if (!t) { fn(arg); return; } // outside the scheduler or out of memory: run it here
+    t->fn = fn; t->arg = arg; t->group = g;
+    atomic_fetch_add_explicit(&g->pending, 1, memory_order_relaxed);
+    if (deque_push(w->internal, t) != 0) { run_task(t); return; } // the ring could not grow
+
+    wake_one(w->owner);
+}
+
+void ws_submit(ws_sched *s, ws_group *g, ws_fn fn, void *arg) {
+    struct task *t = malloc(sizeof(*t));
+    if (!t) { fn(arg); return; }
+    t->fn = fn; t->arg = arg; t->group = g; t->next = NULL;
+    atomic_fetch_add_explicit(&g->pending, 1, memory_order_relaxed);
+    pthread_mutex_lock(&s->inject_lock);
+    if (s->inject_tail) s->inject_tail->next = t;
+    else s->inject_head = t;
+    s->inject_tail = t;
+    pthread_mutex_unlock(&s->inject_lock);
+    wake_one(s);
+}
+
+void ws_wait(ws_group *g) {
+    ws_worker *w = self;
+    while (atomic_load_explicit(&g->pending, memory_order_acquire) > 0) {
+        struct task *t = w ? find_task(w) : NULL;
+        if (t) run_task(t);
+        else sched_yield(); // the remaining tasks are running elsewhere
+    }
+}
+
+// ---------------- workers ----------------
+
+static void *worker_main(void *p) {
+    ws_worker *w = p;
+    ws_sched *s = w->owner;
+    self = w;
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) w->cpu = -1;
+    }
+    topo_bind_node(w->node); // node-local replicas for everything this worker runs
+
+    while (!atomic_load(&s->stop)) {
+        struct task *t = NULL;
+        for (int r = 0; r < STEAL_ROUNDS && !t; ++r) t = find_task(w);
+        if (t) { run_task(t); continue; }
+
+        pthread_mutex_lock(&s->lock);
+        atomic_fetch_add(&s->sleepers, 1);
+        while (atomic_load(&s->queued) == 0 && !atomic_load(&s->stop))
+            pthread_cond_wait(&s->wake, &s->lock);
+        atomic_fetch_sub(&s->sleepers, 1);
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+ws_sched *ws_create(size_t nworkers) {
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE], ncpu = 0;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        for (int c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &allowed)) cpus[ncpu++] = c;
+    // group the CPUs by node (stable, so each node keeps its ascending order)
+    for (int i = 1; i < ncpu; ++i)
+        for (int j = i; j > 0 && topo_cpu_node(cpus[j - 1]) > topo_cpu_node(cpus[j]); --j) {
+            int x = cpus[j]; cpus[j] = cpus[j - 1]; cpus[j - 1] = x;
+        }
+    if (nworkers == 0) nworkers = ncpu > 0 ? (size_t)ncpu : 1;
+
+    ws_sched *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->n = s->cap = nworkers;
+    s->workers = calloc(nworkers, sizeof(*s->workers));
+    s->deques = aligned_alloc(64, nworkers * sizeof(*s->deques));
+    s->threads = calloc(nworkers, sizeof(*s->threads));
+    if (!s->workers || !s->deques || !s->threads) {
+        free(s->workers); free(s->deques); free(s->threads); free(s);
+        return NULL;
+    }
+    memset(s->deques, 0, nworkers * sizeof(*s->deques));
+    for (size_t i = 0; i < nworkers; ++i) {
+        struct ring *r = ring_new(DEQUE_CAP, NULL);
+        if (!r) {
+            for (size_t j = 0; j < i; ++j) deque_free(&s->deques[j]);
+            free(s->workers); free(s->deques); free(s->threads); free(s);
+            return NULL;
+        }
+        atomic_init(&s->deques[i].ring, r);
+    }
+    atomic_init(&s->queued, 0);
+    atomic_init(&s->sleepers, 0);
+    atomic_init(&s->stop, 0);
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    pthread_mutex_init(&s->inject_lock, NULL);
+
+    for (size_t i = 0; i < nworkers; ++i) {
+        ws_worker *w = &s->workers[i];
+        w->id = i;
+        w->cpu = ncpu > 0 ? cpus[i % ncpu] : -1;
+        w->node = topo_cpu_node(w->cpu);
+        w->owner = s;
+        w->internal = &s->deques[i];
+        for (int j = 0; j < WS_SCRATCH; ++j) mpz_init(w->scratch[j]);
+    }
+
+    // the creating thread is worker 0 (left unpinned: it is the program's main thread)
+    s->workers[0].cpu = -1;
+    s->workers[0].node = topo_current_node();
+    s->outer = self; // a scheduler made from inside another one's task
+    self = &s->workers[0];
+    for (size_t i = 1; i < nworkers; ++i)
+        if (pthread_create(&s->threads[i], NULL, worker_main, &s->workers[i]) != 0) {
+            s->n = i; // run with the workers we got
+            break;
+        }
+    return s;
+}
+
+void ws_destroy(ws_sched *s) {
+    pthread_mutex_lock(&s->lock);
+    atomic_store(&s->stop, 1);
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    for (size_t i = 1; i < s->n; ++i) pthread_join(s->threads[i], NULL);
+
+    for (size_t i = 0; i < s->cap; ++i) {
+        for (int j = 0; j < WS_SCRATCH; ++j) mpz_clear(s->workers[i].scratch[j]);
+        deque_free(&s->deques[i]);
+    }
+    if (self == &s->workers[0]) self = s->outer;
+    pthread_mutex_destroy(&s->lock);
+    pthread_mutex_destroy(&s->inject_lock);
+    pthread_cond_destroy(&s->wake);
+    free(s->workers); free(s->deques); free(s->threads); free(s);
+}
+
+// ---------------- parallel for ----------------
+
+struct pfor {
+    void (*body)(size_t i, void *arg);
+    void *arg;
+    size_t lo, hi, grain;
+    ws_group *group;
+};
+
+// keep halving the range, spawning the upper half, then run what is left here
+static void pfor_run(void *p) {
+    struct pfor *f = p;
+    while (f->hi - f->lo > f->grain) {
+        struct pfor *right = malloc(sizeof(*right));
+        if (!right) break;
+        size_t mid = f->lo + (f->hi - f->lo) / 2;
+        *right = *f;
+        right->lo = mid;
+        f->hi = mid;
+        ws_spawn(f->group, pfor_run, right);
+    }
+    for (size_t i = f->lo; i < f->hi; ++i) f->body(i, f->arg);
+    free(f);
+}
+
+void ws_parallel_for(size_t lo, size_t hi, size_t grain,
+                        void (*body)(size_t i, void *arg), void *arg) {
+    if (lo >= hi) return;
+    if (!self || self->owner->n == 1) {
+        for (size_t i = lo; i < hi; ++i) body(i, arg);
+        return;
+    }
+    ws_group g;
+    ws_group_init(&g);
+    struct pfor *root = malloc(sizeof(*root));
+    if (!root) { for (size_t i = lo; i < hi; ++i) body(i, arg); return; }
+    *root = (struct pfor){ body, arg, lo, hi, grain ? grain : 1, &g };
+    pfor_run(root);
+    ws_wait(&g);
+}
@@ -0,0 +1,69 @@
+// worksteal.h
+// Work-stealing task scheduler shared by the parallel parts of the programs.
+//
+// One scheduler owns one pinned worker per CPU (by default), numbered node by node so that
+// neighbouring ids share a NUMA node and steal from each other first. Every worker has a Chase-Lev
+// deque: it pushes and pops its own tasks at the bottom, idle workers steal from the top of
+// somebody else's. Tasks spawned from inside a task land on the same deques, so nested
+// parallelism (a parallel search inside a parallel batch) never starts more threads than
+// the scheduler was created with.
+//
+// The thread that calls ws_create becomes worker 0 and takes part in the work whenever it
+// waits; code running on any worker finds its scheduler through ws_self, and may fall
+// back to running sequentially when that is NULL. A scheduler created from inside another
+// one's task hands that thread back to the outer scheduler when it is destroyed. Random
+// numbers come from drbg_thread (drbg.h), which is per thread and needs no worker.
+
+#ifndef WORKSTEAL_H
+#define WORKSTEAL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <gmp.h>
+
+#define WS_SCRATCH 1 // mpz temporaries per worker (smooth.c leaf_part, allpairs.c run_tile)
+
+typedef void (*ws_fn)(void *arg);
+
+typedef struct ws_sched ws_sched;
+
+// per-worker state handed to task code through ws_self
+typedef struct {
+    size_t id;                     // 0 .. nworkers-1
+    int cpu;                       // CPU the thread is pinned to, -1 if pinning failed
+    int node;                      // NUMA node of that CPU (numa_topo.h)
+    ws_sched *owner;
+    mpz_t scratch[WS_SCRATCH];     // private GMP temporaries, keep their allocation
+    void *internal;                // deque, owned by worksteal.c
+} ws_worker;
+
+// a set of spawned tasks that can be waited for together
+typedef struct {
+    atomic_long pending;
+} ws_group;
+
+// nworkers = 0: one per CPU the process may run on. NULL on failure.
+ws_sched *ws_create(size_t nworkers);
+// from the creating thread, once all groups have been waited for
+void ws_destroy(ws_sched *s);
+size_t ws_nworkers(const ws_sched *s);
+
+// the calling thread's worker, NULL outside the scheduler's threads
+ws_worker *ws_self(void);
+
+void ws_group_init(ws_group *g);
+// run fn(arg) at some point on some worker; must be called from a worker thread
+void ws_spawn(ws_group *g, ws_fn fn, void *arg);
+// queue fn(arg) at the back of the scheduler-wide FIFO; callable from any thread. Workers
+// take from it when their own deque is empty, so a task that resubmits itself goes behind
+// everything already waiting (round-robin between long-running requests).
+void ws_submit(ws_sched *s, ws_group *g, ws_fn fn, void *arg);
+// run tasks (own first, then queued, then stolen) until every task of g has finished
+void ws_wait(ws_group *g);
+
+// body(i, arg) for every i in [lo, hi), split recursively down to grain indices per task.
+// Runs sequentially when called outside the scheduler.
+void ws_parallel_for(size_t lo, size_t hi, size_t grain,
+                        void (*body)(size_t i, void *arg), void *arg);
+
+#endif